@@ -11,6 +11,7 @@
 #include <map>
 #include <functional>
 #include <memory>
+#include <cstdint>
 
 extern "C" {
 #include <libavutil/frame.h>
@@ -34,6 +35,29 @@ namespace ffmpeg_stream {
         PUSH   // 推流
     };
 
+// 队列满时的处理策略
+    enum class QueueOverflowPolicy {
+        BLOCK,        // 阻塞生产者直到有空间
+        DROP_NEWEST,  // 丢弃新数据(包队列会丢到下一个关键帧)
+        DROP_OLDEST   // 丢弃最早的数据(包队列会丢到下一个关键帧)
+    };
+
+// 拉流解码模式，用于只需要低帧率画面的分析任务
+    enum class DecodeMode {
+        FULL,       // 解码全部帧
+        EVERY_NTH,  // 跳过非参考帧，剩余的帧每N帧输出一帧
+        KEYFRAMES   // 只解码关键帧
+    };
+
+// 流运行统计
+    struct StreamStats {
+        int64_t latencyMs = 0;       // 估算的处理延迟(毫秒)
+        uint64_t nonRefDropped = 0;  // 超过延迟预算时丢弃的非参考帧
+        uint64_t gopDropped = 0;     // 超过硬上限时丢弃到关键帧的包/帧
+        uint64_t queueDropped = 0;   // 当前连接中因队列满而丢弃的包/帧
+        uint64_t subscriberDropped = 0;  // 帧订阅者因回调跟不上而丢弃的帧
+    };
+
 // 日志级别
     enum class LogLevel {
         DEBUG,
@@ -51,11 +75,15 @@ namespace ffmpeg_stream {
     std::string streamStatusToString(StreamStatus status);
     std::string streamTypeToString(StreamType type);
     std::string logLevelToString(LogLevel level);
+    std::string queueOverflowPolicyToString(QueueOverflowPolicy policy);
+    std::string decodeModeToString(DecodeMode mode);
 
 // 将字符串转换为枚举
     StreamStatus stringToStreamStatus(const std::string& str);
     StreamType stringToStreamType(const std::string& str);
     LogLevel stringToLogLevel(const std::string& str);
+    QueueOverflowPolicy stringToQueueOverflowPolicy(const std::string& str);
+    DecodeMode stringToDecodeMode(const std::string& str);
 
 } // namespace ffmpeg_stream
 
@@ -0,0 +1,184 @@
+/**
+ * @file scheduler.h
+ * @brief 多路复用调度器，用少量工作线程驱动大量可恢复的流水线任务
+ */
+
+#ifndef FFMPEG_STREAM_SCHEDULER_H
+#define FFMPEG_STREAM_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ffmpeg_stream {
+
+/**
+ * @class Scheduler
+ * @brief 固定数量的工作线程轮流执行任务的单步函数
+ *
+ * 任务是一个返回是否有进展的单步函数，每次只处理少量数据后返回，不在内部等待。
+ * 有进展的任务排到就绪队列末尾继续执行；无进展的任务挂起，
+ * 直到被wakeTask()唤醒或空闲超时后再次轮询。
+ * 同一任务同一时刻只在一个工作线程上执行。
+ */
+    class Scheduler {
+    public:
+        using TaskId = uint64_t;
+        using StepFunction = std::function<bool()>;
+        using Clock = std::chrono::steady_clock;
+
+        /**
+         * @brief 构造函数
+         * @param numWorkers 工作线程数，0表示使用硬件并发线程数
+         */
+        explicit Scheduler(size_t numWorkers = 0);
+
+        /**
+         * @brief 析构函数，停止所有工作线程
+         */
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        /**
+         * @brief 获取全局调度器实例
+         */
+        static Scheduler& getInstance();
+
+        /**
+         * @brief 获取阻塞I/O调度器实例
+         *
+         * 输入读取、网络输出写入和输出重新打开可能阻塞到网络超时(如RTSP/TCP不支持非阻塞读取)，
+         * 这些阶段运行在独立的、有上限的工作线程上，卡住的输入不会占满编码、封装和分发阶段的工作线程。
+         * RTSP解复用器忽略AVFMT_FLAG_NONBLOCK，每个等待下一个包的输入都占用一个I/O工作线程，
+         * 线程数需要覆盖同时读取的输入数(见GlobalConfig::ioThreadPoolSize)。
+         */
+        static Scheduler& getIOInstance();
+
+        /**
+         * @brief 添加任务，任务立即进入就绪队列
+         * @param name 任务名称，用于日志
+         * @param step 单步函数
+         * @param idleWait 无进展时挂起的最长时间，到期后再次轮询
+         * @return 任务ID
+         */
+        TaskId addTask(const std::string& name, StepFunction step, std::chrono::microseconds idleWait);
+
+        /**
+         * @brief 移除任务，任务正在其他工作线程上执行时等待本次单步返回
+         * @param id 任务ID
+         */
+        void removeTask(TaskId id);
+
+        /**
+         * @brief 唤醒挂起的任务；任务正在执行时，本次单步返回后会立即再执行一次
+         * @param id 任务ID
+         */
+        void wakeTask(TaskId id);
+
+        /**
+         * @brief 延迟执行一个一次性函数，等待期间不占用工作线程
+         * @param delay 延迟时间
+         * @param fn 函数，在工作线程上执行，不应长时间阻塞
+         */
+        void runAfter(std::chrono::milliseconds delay, std::function<void()> fn);
+
+        /**
+         * @brief 设置工作线程数，运行中可随时调用
+         *
+         * 扩容立即启动新线程；缩容时多出的线程在当前单步返回后退出，调用方不等待阻塞中的单步。
+         * @param numWorkers 新的工作线程数，0表示使用硬件并发线程数
+         */
+        void resize(size_t numWorkers);
+
+        /**
+         * @brief 获取工作线程数
+         */
+        size_t size() const;
+
+        /**
+         * @brief 获取当前任务数
+         */
+        size_t getTaskCount() const;
+
+        /**
+         * @brief 获取正在执行任务的工作线程数
+         */
+        size_t activeWorkers() const;
+
+        /**
+         * @brief 当前线程是否为调度器工作线程
+         */
+        static bool isWorkerThread();
+
+    private:
+        struct Task;
+
+        // 工作线程函数
+        void workerThread();
+
+        // 回收缩容后已退出的工作线程，需持有workersMutex_
+        void reapRetiredWorkers();
+
+        // 停止并回收所有工作线程，需持有workersMutex_
+        void stopWorkers();
+
+        // 将任务放入就绪队列，需持有mutex_
+        void enqueueLocked(const std::shared_ptr<Task>& task);
+
+        // 挂起任务直到deadline，需持有mutex_
+        void parkLocked(const std::shared_ptr<Task>& task, Clock::time_point deadline);
+
+    private:
+        // 任务状态
+        enum class TaskState {
+            PARKED,   // 挂起，等待唤醒或超时
+            QUEUED,   // 在就绪队列中
+            RUNNING   // 正在执行
+        };
+
+        struct Task {
+            TaskId id;
+            std::string name;
+            StepFunction step;
+            std::chrono::microseconds idleWait;
+
+            TaskState state;
+            bool wakePending;  // 执行期间被唤醒
+            bool removed;
+            std::multimap<Clock::time_point, std::shared_ptr<Task>>::iterator parkedIt;
+        };
+
+        mutable std::mutex mutex_;
+        std::condition_variable workCondition_;
+        std::condition_variable doneCondition_;
+
+        std::map<TaskId, std::shared_ptr<Task>> tasks_;
+        std::deque<std::shared_ptr<Task>> ready_;
+        std::multimap<Clock::time_point, std::shared_ptr<Task>> parked_;
+        std::multimap<Clock::time_point, std::function<void()>> timers_;
+        TaskId nextTaskId_;
+
+        std::mutex workersMutex_;  // 保护workers_，resize与析构互斥
+        std::vector<std::thread> workers_;
+        bool stop_;
+        size_t targetWorkers_;   // 目标工作线程数，需持有mutex_
+        size_t runningWorkers_;  // 尚未退出工作循环的线程数，需持有mutex_
+        std::vector<std::thread::id> retired_;  // 已退出工作循环、待回收的线程，需持有mutex_
+        std::atomic<size_t> workerCount_;
+        std::atomic<size_t> activeWorkers_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_SCHEDULER_H
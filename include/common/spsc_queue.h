@@ -0,0 +1,177 @@
+/**
+ * @file spsc_queue.h
+ * @brief 无锁单生产者单消费者环形队列
+ */
+
+#ifndef FFMPEG_STREAM_SPSC_QUEUE_H
+#define FFMPEG_STREAM_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+namespace ffmpeg_stream {
+
+/**
+ * @class SPSCQueue
+ * @brief 固定容量的无锁环形队列，只允许一个生产者线程和一个消费者线程
+ *
+ * 读写位置分别放在独立的缓存行上，避免生产者和消费者之间的伪共享。
+ * 槽位对象在队列生命周期内复用，tryPush/tryPop直接在槽位上原地读写，
+ * 适合承载预分配的AVPacket/AVFrame等对象。
+ */
+    template<typename T>
+    class SPSCQueue {
+    public:
+        /**
+         * @brief 构造函数
+         * @param capacity 队列容量，向上取整为2的幂
+         */
+        explicit SPSCQueue(size_t capacity)
+                : head_(0), tail_(0), cachedTail_(0), cachedHead_(0) {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            slots_.resize(size);
+            mask_ = size - 1;
+        }
+
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+        /**
+         * @brief 生产者在下一个空槽位上原地写入
+         * @param fill 写入函数，参数为槽位引用，返回false表示放弃写入
+         * @return 是否成功入队，队列满时返回false
+         */
+        template<typename F>
+        bool tryPush(F&& fill) {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - cachedHead_ > mask_) {
+                cachedHead_ = head_.load(std::memory_order_acquire);
+                if (tail - cachedHead_ > mask_) {
+                    return false;
+                }
+            }
+
+            if (!fill(slots_[tail & mask_])) {
+                return false;
+            }
+
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief 消费者在队首槽位上原地读取
+         * @param drain 读取函数，参数为槽位引用
+         * @return 是否成功出队，队列空时返回false
+         */
+        template<typename F>
+        bool tryPop(F&& drain) {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if (head == cachedTail_) {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+                if (head == cachedTail_) {
+                    return false;
+                }
+            }
+
+            drain(slots_[head & mask_]);
+
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief 消费者查看队首槽位但不出队
+         * @param inspect 查看函数，参数为槽位引用
+         * @return 队列为空时返回false
+         */
+        template<typename F>
+        bool tryPeek(F&& inspect) {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if (head == cachedTail_) {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+                if (head == cachedTail_) {
+                    return false;
+                }
+            }
+
+            inspect(slots_[head & mask_]);
+            return true;
+        }
+
+        /**
+         * @brief 按值入队
+         */
+        bool push(T item) {
+            return tryPush([&item](T& slot) {
+                slot = std::move(item);
+                return true;
+            });
+        }
+
+        /**
+         * @brief 按值出队
+         */
+        bool pop(T& item) {
+            return tryPop([&item](T& slot) {
+                item = std::move(slot);
+            });
+        }
+
+        /**
+         * @brief 获取当前元素数量(近似值)
+         */
+        size_t size() const {
+            const size_t tail = tail_.load(std::memory_order_acquire);
+            const size_t head = head_.load(std::memory_order_acquire);
+            return tail - head;
+        }
+
+        /**
+         * @brief 队列是否为空(近似值)
+         */
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /**
+         * @brief 获取队列容量
+         */
+        size_t capacity() const {
+            return mask_ + 1;
+        }
+
+        /**
+         * @brief 遍历全部槽位，仅在没有生产者和消费者并发访问时使用(如析构)
+         */
+        template<typename F>
+        void forEachSlot(F&& f) {
+            for (auto& slot : slots_) {
+                f(slot);
+            }
+        }
+
+    private:
+        static constexpr size_t kCacheLineSize = 64;
+
+        std::vector<T> slots_;
+        size_t mask_;
+
+        // 消费者写、生产者读
+        alignas(kCacheLineSize) std::atomic<size_t> head_;
+        // 生产者写、消费者读
+        alignas(kCacheLineSize) std::atomic<size_t> tail_;
+        // 消费者本地缓存的tail，减少跨核读取
+        alignas(kCacheLineSize) size_t cachedTail_;
+        // 生产者本地缓存的head
+        alignas(kCacheLineSize) size_t cachedHead_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_SPSC_QUEUE_H
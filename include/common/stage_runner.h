@@ -0,0 +1,79 @@
+/**
+ * @file stage_runner.h
+ * @brief 流水线阶段执行器
+ */
+
+#ifndef FFMPEG_STREAM_STAGE_RUNNER_H
+#define FFMPEG_STREAM_STAGE_RUNNER_H
+
+#include "common/scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace ffmpeg_stream {
+
+/**
+ * @class StageRunner
+ * @brief 反复执行一个流水线阶段的单步函数
+ *
+ * 单步函数返回true表示本次有进展，会立即再次执行；
+ * 返回false表示暂时无事可做，执行器会挂起到超时或被wake()唤醒。
+ * 阶段作为任务运行在调度器的工作线程上，不独占线程，单步函数不应在内部等待。
+ */
+    class StageRunner {
+    public:
+        using StepFunction = std::function<bool()>;
+
+        /**
+         * @brief 构造函数
+         * @param name 阶段名称，用于日志
+         * @param idleWait 无进展时的最长挂起时间，上游入队后会主动唤醒，这里只是兜底轮询
+         * @param scheduler 调度器，为空时使用全局调度器
+         */
+        explicit StageRunner(const std::string& name,
+                             std::chrono::microseconds idleWait = std::chrono::microseconds(10000),
+                             Scheduler* scheduler = nullptr);
+
+        /**
+         * @brief 析构函数，停止执行
+         */
+        ~StageRunner();
+
+        StageRunner(const StageRunner&) = delete;
+        StageRunner& operator=(const StageRunner&) = delete;
+
+        /**
+         * @brief 开始执行
+         * @param step 单步函数
+         */
+        void start(StepFunction step);
+
+        /**
+         * @brief 停止执行并等待当前单步返回(在自己的单步中调用时不等待)
+         */
+        void stop();
+
+        /**
+         * @brief 唤醒休眠中的执行器，通常由上游阶段在入队后调用
+         */
+        void wake();
+
+        /**
+         * @brief 是否正在执行
+         */
+        bool isRunning() const;
+
+    private:
+        std::string name_;
+        std::chrono::microseconds idleWait_;
+        Scheduler& scheduler_;
+
+        // 调度器中的任务ID，0表示未运行
+        std::atomic<Scheduler::TaskId> taskId_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_STAGE_RUNNER_H
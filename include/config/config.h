@@ -18,6 +18,47 @@ using json = nlohmann::json;
 
 namespace ffmpeg_stream {
 
+    struct StreamConfig;
+
+// 额外的输出目标，与所属档位的主输出收到同一份编码后的包
+    struct OutputTarget {
+        std::string url;
+        std::string format;  // 为空时按地址推断，"llhls"/"cmaf"表示本地HLS目录
+
+        // 从JSON加载配置，可以是{"url": ..., "format": ...}或仅地址字符串
+        static OutputTarget fromJson(const json& j);
+
+        // 转换为JSON
+        json toJson() const;
+    };
+
+// 推流输出档位配置(多码率阶梯中的一档)
+    struct RenditionConfig {
+        std::string name;
+        std::string outputUrl;
+        std::string outputFormat;
+        int width;
+        int height;
+        int bitrate;
+        int fps;
+        std::string videoCodec;
+
+        // 额外的输出，只编码一次，各输出有独立的封装器、封装队列和重连状态
+        std::vector<OutputTarget> extraOutputs;
+
+        // 默认构造函数
+        RenditionConfig();
+
+        // 以流配置的主输出参数构造
+        static RenditionConfig fromStreamConfig(const StreamConfig& config);
+
+        // 从JSON加载配置，未指定的字段继承流配置
+        static RenditionConfig fromJson(const json& j, const StreamConfig& parent);
+
+        // 转换为JSON
+        json toJson() const;
+    };
+
 // 流配置结构体
     struct StreamConfig {
         // 基本信息
@@ -27,11 +68,13 @@ namespace ffmpeg_stream {
         std::string inputUrl;
         std::string outputUrl;
         std::string outputFormat;
+        std::vector<OutputTarget> extraOutputs;  // 主档位的额外输出(如录像文件、HLS目录)
         bool autoStart;
 
         // 重连设置
-        int maxReconnects;
-        int reconnectDelay;  // 毫秒
+        int maxReconnects;  // 连续重连的最大次数，小于0表示不限
+        int reconnectDelay;  // 毫秒，第一次重连的基础等待时间，之后指数增长
+        int reconnectMaxDelay;  // 毫秒，重连等待时间上限
 
         // 视频参数
         int width;
@@ -40,14 +83,63 @@ namespace ffmpeg_stream {
         int fps;
         std::string videoCodec;  // "h264", "h265", "vp9", etc.
 
+        // 额外的输出档位，共用一次解码，各自缩放、编码和封装
+        std::vector<RenditionConfig> renditions;
+
+        // 编码前缩放设置
+        std::string scaleAlgorithm;  // "fast_bilinear", "bilinear", "bicubic", "area"
+        int scaleThreads;  // 缩放切片线程数，0表示自动(FFmpeg 4下不切分)，FFmpeg 4下大于1时按行分条带并行缩放
+
         // 硬件加速
         HWAccelType decoderHWAccel;
         HWAccelType encoderHWAccel;
 
+        // 输入探测设置，可被extraOptions中的同名选项覆盖
+        int64_t probeSize;      // 字节，0表示使用FFmpeg默认值
+        int analyzeDurationMs;  // 毫秒，0表示使用FFmpeg默认值
+        int fpsProbeSize;       // 用于估计帧率的帧数，-1表示使用FFmpeg默认值
+        bool fastStart;         // 只探测到第一个关键帧，帧率等未探测到的参数取自下面的提示
+        std::string inputCodec;  // 输入编码提示，如"h264"，为空表示未知
+        int inputWidth;          // 输入宽度提示，0表示未知
+        int inputHeight;         // 输入高度提示，0表示未知
+        int inputFps;            // 输入帧率提示，0表示未知
+
+        // 音频设置(仅推流)：默认直通，输出容器不支持输入的音频编码时转码为AAC
+        bool audioEnabled;
+        int audioBitrate;  // 转码时的AAC码率
+
         // 网络设置
         int networkTimeout;  // 毫秒
         std::string rtspTransport;  // "tcp", "udp", "http", etc.
         bool lowLatency;
+        int maxLatencyMs;      // 低延迟模式下的延迟预算，超过后丢弃非参考帧
+        int maxLatencyHardMs;  // 超过后丢弃到下一个关键帧
+        double readRate;  // 按时间戳限速读取(类似ffmpeg -re)的倍速，0表示不限速，1.0为实时
+
+        // 流水线设置
+        int queueDepth;  // 各阶段之间队列的深度
+        QueueOverflowPolicy queueOverflowPolicy;  // 队列满时的处理策略
+        int gopCacheMs;            // 输入源缓存最近若干毫秒的包(从关键帧开始)，用于秒开和预录，0表示不缓存
+        int64_t gopCacheMaxBytes;  // 单个输入源缓存的内存上限，0表示不限
+
+        // 解码设置(仅拉流)，运行中可通过StreamManager::setDecodeMode修改
+        DecodeMode decodeMode;
+        int decodeFrameInterval;  // EVERY_NTH模式下每N帧输出一帧
+        bool fastDecode;          // 跳过环路滤波，编码支持时以低分辨率解码
+        int snapshotCacheMs;      // 快照JPEG的缓存时间(毫秒)，期间同一尺寸的请求直接复用
+
+        // 本地HLS/CMAF输出设置(档位outputFormat为"llhls"或"cmaf"时生效，需要FFmpeg 4.3及以上)
+        int hlsSegmentMs;  // 分段时长(毫秒)，在编码器关键帧处切分
+        int hlsPartMs;     // 部分分段(CMAF分片)时长(毫秒)
+        int hlsListSize;   // 播放列表保留的分段数
+
+        // 录像设置：输入的包不解码直接写入分段文件
+        bool recordEnabled;
+        std::string recordPath;     // 录像根目录，每个流写入以流ID命名的子目录
+        std::string recordFormat;   // "mpegts"或"mp4"(分片MP4)
+        int recordSegmentSeconds;   // 分段时长(60-600秒)，在关键帧处切分
+        int recordRetentionHours;   // 保留时长(小时)，0表示不按时间删除
+        int64_t recordMaxBytes;     // 本流录像的空间上限，0表示不限
 
         // 其他选项
         std::map<std::string, std::string> extraOptions;
@@ -74,7 +166,22 @@ namespace ffmpeg_stream {
 
         // 性能设置
         int threadPoolSize;
+        // 输入读取和输出写入等可能阻塞的阶段的工作线程数，0表示随流的增加按输入源数加推流输出数伸缩。
+        // RTSP等输入不支持非阻塞读取，每个正在读取的输入占用一个I/O线程，线程数少于输入源数时超出的输入排队读取
+        int ioThreadPoolSize;
+        int maxConcurrentReconnects;  // 同时进行的重连打开数，打开输入可能阻塞到网络超时，不占用通用线程池
         bool preloadLibraries;
+        std::string streamInfoCacheFile;  // 流参数缓存文件，相对路径相对于配置文件所在目录，为空时不保存
+        int64_t gopCacheTotalBytes;  // 所有输入源包缓存合计的内存上限，0表示不限
+        int64_t recordDiskQuotaBytes;  // 所有流录像合计的磁盘配额，超过时删除最早的分段，0表示不限
+
+        // 内置HTTP-FLV/MPEG-TS分发服务器
+        bool httpServerEnabled;
+        std::string httpServerBindAddress;
+        int httpServerPort;
+        int httpMaxClients;
+        int httpClientQueueDepth;  // 每个观看者的包队列深度，满时丢弃到下一个关键帧
+        int httpClientTimeoutMs;   // 观看者持续这么久收不下数据时断开
 
         // 默认硬件加速
         HWAccelType defaultDecoderHWAccel;
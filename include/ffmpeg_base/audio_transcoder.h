@@ -0,0 +1,75 @@
+/**
+ * @file audio_transcoder.h
+ * @brief 音频转码器，输出容器无法直接承载输入音频时使用
+ */
+
+#ifndef FFMPEG_STREAM_AUDIO_TRANSCODER_H
+#define FFMPEG_STREAM_AUDIO_TRANSCODER_H
+
+#include "encoder.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/audio_fifo.h>
+#include <libswresample/swresample.h>
+}
+
+namespace ffmpeg_stream {
+
+// 音频转码器类：解码 -> 重采样 -> 按编码器帧长切分 -> 编码
+    class AudioTranscoder {
+    public:
+        AudioTranscoder();
+        ~AudioTranscoder();
+
+        // 初始化，采样率和声道数沿用输入，采样格式使用编码器支持的第一种
+        // globalHeader为true时编码器参数集放在extradata中(FLV/MP4等需要)
+        bool init(const AVCodecParameters* inputParams, AVRational inputTimeBase,
+                  AVCodecID codecId = AV_CODEC_ID_AAC, int bitrate = 64000, bool globalHeader = false);
+
+        // 转码一个输入包，编码得到的包交给sink，时间基为编码器的time_base
+        // 返回输出的包数，出错时返回负的错误码
+        int transcode(const AVPacket* packet, const PacketSink& sink);
+
+        // 编码FIFO中剩余的样本并冲刷编码器
+        int flush(const PacketSink& sink);
+
+        // 清理资源
+        void cleanup();
+
+        // 获取编码器上下文
+        AVCodecContext* getCodecContext();
+
+    private:
+        // 把解码出的所有帧重采样后放入FIFO，返回FFmpeg错误码
+        int receiveDecodedFrames();
+
+        // 输入时间戳与累计样本数偏差过大时补静音或重新对齐，返回FFmpeg错误码
+        int alignToInput(int64_t framePts);
+
+        // FIFO中每凑够一帧就编码一次，final为true时编码剩余的不足一帧的样本
+        int encodeFromFifo(const PacketSink& sink, bool final);
+
+        // 编码一帧(nullptr表示冲刷)并输出所有包
+        int encodeFrame(AVFrame* frame, const PacketSink& sink);
+
+    private:
+        AVCodecContext* decoderContext;
+        AVCodecContext* encoderContext;
+        SwrContext* resampler;
+        AVAudioFifo* fifo;
+
+        AVFrame* decodedFrame;
+        AVFrame* convertedFrame;
+        AVFrame* encodeFrameBuffer;
+        AVPacket* encodedPacket;
+
+        AVRational inputTimeBase;
+
+        // 下一帧的时间戳(以1/采样率为单位)，从第一帧的时间戳开始按样本数累加，输入有空洞时重新对齐
+        int64_t nextPts;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_AUDIO_TRANSCODER_H
@@ -7,6 +7,7 @@
 #define FFMPEG_STREAM_DECODER_H
 
 #include "hw_accel.h"
+#include <functional>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -17,6 +18,9 @@ extern "C" {
 
 namespace ffmpeg_stream {
 
+// 解码输出回调，frame由解码器持有，仅在回调期间有效，需要保留时请使用av_frame_ref
+    using FrameSink = std::function<void(AVFrame* frame)>;
+
 // 硬件解码器类
     class HWDecoder {
     public:
@@ -29,8 +33,24 @@ namespace ffmpeg_stream {
         // 初始化软件解码器
         bool initSoftwareDecoder(AVCodecParameters* codecParams);
 
-        // 解码一个包
-        AVFrame* decode(AVPacket* packet);
+        // 设置低分辨率解码级别(每级宽高减半)，在init之前调用，超过编码支持的级别时取最大值
+        // 只有软件解码支持，硬件解码时忽略
+        void setLowres(int level);
+
+        // 获取编码支持的最大低分辨率解码级别，不支持时返回0
+        static int getMaxLowres(AVCodecID codecId);
+
+        // 发送一个包到解码器，packet为nullptr表示流结束，返回FFmpeg错误码
+        int sendPacket(const AVPacket* packet);
+
+        // 取出一帧到调用方持有的frame中(硬件帧会下载到内存)
+        // 返回0表示成功，AVERROR(EAGAIN)/AVERROR_EOF表示暂无可输出的帧
+        int receiveFrame(AVFrame* frame);
+
+        // 发送一个包，并将解码器当前可输出的所有帧交给sink
+        // packet为nullptr时冲刷解码器(流结束)，冲刷完成后解码器可继续使用
+        // 返回输出的帧数，出错时返回FFmpeg错误码
+        int decode(AVPacket* packet, const FrameSink& sink);
 
         // 刷新解码器缓冲
         void flush();
@@ -41,10 +61,19 @@ namespace ffmpeg_stream {
         // 获取解码器上下文
         AVCodecContext* getCodecContext() const;
 
+    private:
+        // 取出所有已解码的帧交给sink，返回帧数或错误码
+        int receiveFrames(const FrameSink& sink);
+
     private:
         AVCodecContext* codecContext;
         AVBufferRef* hwDeviceContext;
         AVPixelFormat hwPixFmt;
+        int lowres;
+
+        // 复用的输出帧，避免每帧分配
+        AVFrame* decodedFrame;
+        AVFrame* transferFrame;  // 硬件帧下载到内存的目标帧
     };
 
 } // namespace ffmpeg_stream
@@ -8,6 +8,7 @@
 
 #include "hw_accel.h"
 #include "config/config.h"
+#include <functional>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -18,6 +19,12 @@ extern "C" {
 
 namespace ffmpeg_stream {
 
+// 将配置中的编码名称("h264", "h265"等)转换为AVCodecID，未知名称返回AV_CODEC_ID_NONE
+    AVCodecID codecNameToAVCodecID(const std::string& name);
+
+// 编码输出回调，packet由编码器持有，仅在回调期间有效；返回false时停止输出
+    using PacketSink = std::function<bool(AVPacket* packet)>;
+
 // 硬件编码器类
     class HWEncoder {
     public:
@@ -35,11 +42,22 @@ namespace ffmpeg_stream {
         bool initSoftwareEncoder(int width, int height, AVPixelFormat pixFmt, int bitrate,
                                  int fps, AVCodecID codecId = AV_CODEC_ID_H264);
 
-        // 编码一帧
-        AVPacket* encode(AVFrame* frame);
+        // 将参数集写入extradata而不是每个关键帧(输出格式要求全局头时，如fMP4)，在init之前调用
+        void setGlobalHeader(bool enabled);
+
+        // 发送一帧到编码器，frame为nullptr表示开始冲刷，返回FFmpeg错误码
+        int sendFrame(const AVFrame* frame);
+
+        // 取出一个包到调用方持有的packet中
+        // 返回0表示成功，AVERROR(EAGAIN)/AVERROR_EOF表示暂无可输出的包
+        int receivePacket(AVPacket* packet);
 
-        // 刷新编码器缓冲
-        void flush();
+        // 编码一帧，并将编码器当前可输出的所有包交给sink
+        // 返回输出的包数，出错或sink返回false时返回负的错误码
+        int encode(AVFrame* frame, const PacketSink& sink);
+
+        // 刷新编码器缓冲，将B帧/lookahead中剩余的包全部交给sink
+        int flush(const PacketSink& sink);
 
         // 清理资源
         void cleanup();
@@ -47,10 +65,18 @@ namespace ffmpeg_stream {
         // 获取编码器上下文
         AVCodecContext* getCodecContext();
 
+    private:
+        // 取出所有已编码的包交给sink，返回包数或错误码
+        int receivePackets(const PacketSink& sink);
+
     private:
         AVCodecContext* codecContext;
         AVBufferRef* hwDeviceContext;
         AVPixelFormat hwPixFmt;
+        bool globalHeader;
+
+        // 复用的输出包，避免每帧分配
+        AVPacket* encodedPacket;
     };
 
 } // namespace ffmpeg_stream
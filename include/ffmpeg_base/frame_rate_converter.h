@@ -0,0 +1,62 @@
+/**
+ * @file frame_rate_converter.h
+ * @brief 编码前的帧率转换
+ */
+
+#ifndef FFMPEG_STREAM_FRAME_RATE_CONVERTER_H
+#define FFMPEG_STREAM_FRAME_RATE_CONVERTER_H
+
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class FrameRateConverter
+ * @brief 按时间戳将输入帧对应到目标帧率的输出时隙，时隙已有帧时丢弃，缺少的时隙重复上一帧
+ *
+ * 输出时间基为编码器的1/fps，每个时隙一帧，输出时间戳即时隙序号。
+ * 是否丢弃在缩放和编码之前判断，降帧率时被丢弃的帧不产生任何开销。
+ * 时间戳回退超过一秒视为不连续，从下一个时隙继续；超过一秒的间隙(输入中断)不填补。
+ */
+    class FrameRateConverter {
+    public:
+        FrameRateConverter();
+        ~FrameRateConverter();
+
+        FrameRateConverter(const FrameRateConverter&) = delete;
+        FrameRateConverter& operator=(const FrameRateConverter&) = delete;
+
+        // 设置输入时间基和输出时间基(1/fps)，并清除状态
+        void setRate(AVRational inputTimeBase, AVRational outputTimeBase);
+
+        // 判断一帧是否输出，pts为相对起点的输入时间戳，AV_NOPTS_VALUE表示顺延到下一个时隙
+        // 返回false表示该帧丢弃；返回true时outputPts为输出时间戳，repeat为之前需要重复上一帧的次数
+        bool next(int64_t pts, int64_t& outputPts, int& repeat);
+
+        // 保存已送入编码器的帧，用于填补之后缺少的时隙
+        void keep(const AVFrame* frame);
+
+        // 以上一帧的引用填充dst并设置时间戳，没有上一帧时返回false
+        bool repeatLast(AVFrame* dst, int64_t outputPts) const;
+
+        // 丢弃保存的帧并清除状态
+        void reset();
+
+    private:
+        AVRational inputTimeBase;
+        AVRational outputTimeBase;
+        int64_t slotsPerSecond;
+
+        int64_t nextSlot;    // 下一个待填充的时隙，AV_NOPTS_VALUE表示还没有输出
+        int64_t slotOffset;  // 时间戳回退后累计的时隙偏移
+        AVFrame* lastFrame;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_FRAME_RATE_CONVERTER_H
@@ -0,0 +1,142 @@
+/**
+ * @file frame_subscriber.h
+ * @brief 解码帧订阅者：引用计数的帧句柄、独立队列和异步回调分发
+ */
+
+#ifndef FFMPEG_STREAM_FRAME_SUBSCRIBER_H
+#define FFMPEG_STREAM_FRAME_SUBSCRIBER_H
+
+#include "common/common.h"
+#include "common/scheduler.h"
+#include "common/stage_runner.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+namespace ffmpeg_stream {
+
+// 解码帧句柄：持有帧的一个引用，所有订阅者共享同一个句柄，像素数据不拷贝。
+// 句柄释放前帧一直有效；需要修改帧的订阅者应先av_frame_ref到自己的AVFrame
+    using FrameHandle = std::shared_ptr<const AVFrame>;
+
+// 帧订阅回调，在订阅者的分发任务上执行
+    using FrameHandler = std::function<void(int streamId, const FrameHandle& frame)>;
+
+/**
+ * @brief 把帧的引用转移到新的句柄中，frame随后为空
+ * @param frame 解码帧
+ * @return 帧句柄，分配失败时返回nullptr
+ */
+    FrameHandle makeFrameHandle(AVFrame* frame);
+
+/**
+ * @struct FrameSubscriberOptions
+ * @brief 帧订阅参数
+ */
+    struct FrameSubscriberOptions {
+        size_t queueDepth = 8;  // 等待回调的最大帧数
+        QueueOverflowPolicy policy = QueueOverflowPolicy::DROP_OLDEST;
+        Scheduler* executor = nullptr;  // 执行回调的调度器，为空时使用共享的回调调度器
+    };
+
+/**
+ * @class FrameSubscriber
+ * @brief 一个帧订阅者
+ *
+ * 处理任务把帧句柄放入订阅者自己的有界队列后立即返回，回调在分发任务上异步执行，
+ * 慢回调只会让自己的队列积压，不会拖慢拉流、解码和其他订阅者。
+ * 回调默认运行在独立于流水线的回调调度器上，即使回调阻塞(如模型推理)也不占用流水线的工作线程。
+ * 同一订阅者的回调按帧顺序串行执行。
+ */
+    class FrameSubscriber : public std::enable_shared_from_this<FrameSubscriber> {
+    public:
+        /**
+         * @brief 构造函数，创建后需调用start()
+         * @param name 订阅者名称，用于日志
+         * @param streamId 流ID，传给回调
+         * @param handler 帧回调
+         * @param options 订阅参数
+         */
+        FrameSubscriber(const std::string& name, int streamId, FrameHandler handler,
+                        const FrameSubscriberOptions& options);
+
+        /**
+         * @brief 析构函数，停止分发
+         */
+        ~FrameSubscriber();
+
+        FrameSubscriber(const FrameSubscriber&) = delete;
+        FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+        /**
+         * @brief 启动分发任务
+         */
+        void start();
+
+        /**
+         * @brief 停止分发任务，丢弃未分发的帧；可以在回调中调用
+         */
+        void stop();
+
+        /**
+         * @brief 放入一帧(生产者调用)
+         *
+         * 队列满时按策略处理：DROP_OLDEST丢弃最早的帧，DROP_NEWEST丢弃本帧，
+         * BLOCK等待回调腾出空间(在调度器工作线程上最多等待一小段时间后丢弃本帧)。
+         * @param frame 帧句柄
+         * @return 是否放入
+         */
+        bool push(const FrameHandle& frame);
+
+        /**
+         * @brief 获取等待回调的帧数
+         */
+        size_t getBacklog() const;
+
+        /**
+         * @brief 获取因队列满而丢弃的帧数
+         */
+        uint64_t getDroppedCount() const;
+
+        /**
+         * @brief 获取已交给回调的帧数
+         */
+        uint64_t getDeliveredCount() const;
+
+        /**
+         * @brief 获取共享的回调调度器
+         */
+        static Scheduler& getDispatchScheduler();
+
+    private:
+        // 分发任务的单步函数，每次回调一帧
+        bool dispatchStep();
+
+    private:
+        std::string name_;
+        int streamId_;
+        FrameHandler handler_;
+        size_t capacity_;
+        QueueOverflowPolicy policy_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable spaceCondition_;
+        std::deque<FrameHandle> queue_;
+        bool stopped_;
+
+        std::atomic<uint64_t> droppedCount_;
+        std::atomic<uint64_t> deliveredCount_;
+
+        std::unique_ptr<StageRunner> dispatchStage_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_FRAME_SUBSCRIBER_H
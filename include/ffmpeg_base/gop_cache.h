@@ -0,0 +1,119 @@
+/**
+ * @file gop_cache.h
+ * @brief 以关键帧对齐的包缓存，新的使用者可以立即起播，录像可以预录
+ */
+
+#ifndef FFMPEG_STREAM_GOP_CACHE_H
+#define FFMPEG_STREAM_GOP_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class GopCache
+ * @brief 一个输入最近若干秒的音视频包，总是从视频关键帧开始
+ *
+ * 包以引用方式保存，不拷贝数据。超过时长时按整个GOP从头部淘汰；
+ * 超过本缓存或全局的内存上限时同样淘汰最早的GOP，只剩一个GOP仍超限时清空并等待下一个关键帧。
+ * 只由输入源的读取阶段访问，不加锁；统计值可在任意线程读取。
+ */
+    class GopCache {
+    public:
+        // 回放缓存包的回调，packet仅在回调期间有效
+        using PacketVisitor = std::function<void(const AVPacket* packet, bool video)>;
+
+        GopCache();
+        ~GopCache();
+
+        GopCache(const GopCache&) = delete;
+        GopCache& operator=(const GopCache&) = delete;
+
+        /**
+         * @brief 设置缓存参数
+         * @param durationMs 保留的时长(毫秒)，0表示不缓存
+         * @param maxBytes 本缓存的内存上限，0表示不限
+         */
+        void configure(int durationMs, int64_t maxBytes);
+
+        /**
+         * @brief 追加一个包
+         * @param packet 包，缓存持有自己的引用
+         * @param video 是否为视频包
+         * @param timeUs 包的DTS(微秒)，用于计算缓存时长
+         */
+        void push(const AVPacket* packet, bool video, int64_t timeUs);
+
+        /**
+         * @brief 按顺序回放缓存的包
+         * @param fromLastKeyframe 为true时只回放最近一个GOP，否则回放全部
+         * @param visitor 回调
+         */
+        void forEach(bool fromLastKeyframe, const PacketVisitor& visitor) const;
+
+        /**
+         * @brief 丢弃全部缓存
+         */
+        void clear();
+
+        /**
+         * @brief 获取缓存的时长(毫秒)
+         */
+        int64_t getDurationMs() const;
+
+        /**
+         * @brief 获取缓存占用的字节数
+         */
+        int64_t getBytes() const;
+
+        /**
+         * @brief 设置所有缓存合计的内存上限，0表示不限
+         */
+        static void setGlobalLimit(int64_t maxBytes);
+
+        /**
+         * @brief 获取所有缓存合计占用的字节数
+         */
+        static int64_t getGlobalBytes();
+
+    private:
+        struct Entry {
+            AVPacket* packet;
+            bool video;
+            int64_t timeUs;
+        };
+
+        // 从头部淘汰一个GOP，只剩一个GOP时返回false
+        bool dropFirstGop();
+
+        // 是否超过本缓存或全局的内存上限
+        bool overBudget() const;
+
+        // 释放一个条目并更新字节计数
+        void release(Entry& entry);
+
+    private:
+        std::deque<Entry> entries_;
+        std::deque<size_t> gopSizes_;     // 每个GOP的条目数，与entries_对应
+        std::deque<int64_t> gopStartUs_;  // 每个GOP关键帧的时间
+        int64_t durationUs_;
+        int64_t maxBytes_;
+        int64_t lastVideoUs_;
+
+        std::atomic<int64_t> bytes_;
+        std::atomic<int64_t> durationMs_;
+
+        static std::atomic<int64_t> globalBytes_;
+        static std::atomic<int64_t> globalLimit_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_GOP_CACHE_H
@@ -0,0 +1,219 @@
+/**
+ * @file http_stream_server.h
+ * @brief 内置HTTP-FLV/MPEG-TS分发服务器，同一路输入可供任意多个本地观看者播放
+ */
+
+#ifndef FFMPEG_STREAM_HTTP_STREAM_SERVER_H
+#define FFMPEG_STREAM_HTTP_STREAM_SERVER_H
+
+#include "common/stage_runner.h"
+#include "stream_source.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+// 套接字句柄，Windows下为SOCKET
+#ifdef _WIN32
+    using SocketHandle = uintptr_t;
+#else
+    using SocketHandle = int;
+#endif
+
+// 按流ID查找当前的输入源，流不存在或未连接时返回nullptr
+    using SourceResolver = std::function<std::shared_ptr<StreamSource>(int streamId)>;
+
+// HTTP分发服务器参数
+    struct HttpServerOptions {
+        std::string bindAddress = "0.0.0.0";
+        int port = 8080;
+        int maxClients = 256;
+        size_t clientQueueDepth = 512;  // 每个观看者的包队列深度，满时丢弃到下一个关键帧
+        int clientTimeoutMs = 5000;     // 观看者持续这么久收不下数据时断开
+    };
+
+/**
+ * @class HttpStreamClient
+ * @brief 一个HTTP观看者连接
+ *
+ * 直接订阅输入源的音视频包，从输入源缓存的最近一个关键帧开始，包以引用方式共享，不拷贝数据。
+ * 每个连接有自己的封装器(FLV或MPEG-TS)，写出的数据先进入有上限的发送缓冲区，
+ * 在自己的StageRunner上以非阻塞方式发送；发送缓冲区满时不再取包，队列满后丢弃到下一个关键帧，
+ * 持续收不下数据的慢速连接被断开，不影响其他观看者和输入源。
+ */
+    class HttpStreamClient {
+    public:
+        /**
+         * @brief 构造函数
+         * @param socket 已接受的连接，由本对象关闭
+         * @param peer 对端地址，用于日志
+         * @param resolver 输入源查找函数
+         * @param options 服务器参数
+         */
+        HttpStreamClient(SocketHandle socket, const std::string& peer, SourceResolver resolver,
+                         const HttpServerOptions& options);
+
+        /**
+         * @brief 析构函数，关闭连接
+         */
+        ~HttpStreamClient();
+
+        HttpStreamClient(const HttpStreamClient&) = delete;
+        HttpStreamClient& operator=(const HttpStreamClient&) = delete;
+
+        /**
+         * @brief 开始读取请求并发送数据
+         */
+        void start();
+
+        /**
+         * @brief 停止发送，取消订阅并关闭连接
+         */
+        void stop();
+
+        /**
+         * @brief 连接是否已结束(对端关闭、出错、输入结束或被判定为慢速连接)
+         */
+        bool isFinished() const;
+
+    private:
+        enum class State {
+            READING_REQUEST,
+            STREAMING,
+            FINISHED
+        };
+
+        // 连接单步
+        bool clientStep();
+
+        // 读取并解析请求，请求完整后订阅输入源并写出响应头
+        bool readRequest();
+
+        // 按请求路径订阅输入源并打开封装器，失败时返回HTTP状态码
+        int startStreaming(const std::string& path);
+
+        // 取包封装到发送缓冲区
+        bool muxPackets();
+
+        // 封装一个包
+        bool writePacket(AVPacket* packet, bool video);
+
+        // 发送缓冲区中的数据，返回是否有进展
+        bool flushOutput();
+
+        // 写出简单的错误响应并结束连接
+        void sendError(int status);
+
+        // 结束连接
+        void finish(const char* reason);
+
+        // 封装器的输出回调
+        static int writeCallback(void* opaque, uint8_t* buf, int size);
+
+    private:
+        SocketHandle socket_;
+        std::string peer_;
+        SourceResolver resolver_;
+        HttpServerOptions options_;
+        std::atomic<State> state_;
+
+        // 请求
+        std::string request_;
+        bool chunked_;  // HTTP/1.1请求使用分块传输
+
+        // 输入源和订阅
+        std::shared_ptr<StreamSource> source_;
+        std::shared_ptr<SourceSubscription> videoSubscription_;
+        std::shared_ptr<SourceSubscription> audioSubscription_;
+        AVRational videoTimeBase_;
+        AVRational audioTimeBase_;
+
+        // 封装：两个队列各暂存一个包，先写出时间戳较早的
+        AVFormatContext* formatContext_;
+        int audioStreamIndex_;  // -1表示不输出音频
+        AVPacket* videoPacket_;
+        AVPacket* audioPacket_;
+        bool videoPending_;
+        bool audioPending_;
+        int64_t startUs_;  // 第一个视频关键帧的时间(微秒)，输出时间戳从0开始
+
+        // 发送缓冲区
+        std::string output_;
+        size_t outputOffset_;
+        int64_t lastSendUs_;  // 最近一次发送出数据(或开始等待发送)的时间
+
+        std::unique_ptr<StageRunner> clientStage_;
+    };
+
+/**
+ * @class HttpStreamServer
+ * @brief 监听HTTP连接，按路径/live/<流ID>.flv或/live/<流ID>.ts分发对应流的音视频
+ *
+ * 接受连接在独立的线程上进行，每个连接的请求读取和发送都在各自的StageRunner上以非阻塞方式完成。
+ * 输入源断开或重连时连接随之结束，播放端重新请求即可接上新的输入源。
+ */
+    class HttpStreamServer {
+    public:
+        /**
+         * @brief 构造函数
+         * @param resolver 输入源查找函数
+         */
+        explicit HttpStreamServer(SourceResolver resolver);
+
+        /**
+         * @brief 析构函数，停止服务器
+         */
+        ~HttpStreamServer();
+
+        HttpStreamServer(const HttpStreamServer&) = delete;
+        HttpStreamServer& operator=(const HttpStreamServer&) = delete;
+
+        /**
+         * @brief 开始监听
+         * @param options 服务器参数
+         * @return 是否成功监听
+         */
+        bool start(const HttpServerOptions& options);
+
+        /**
+         * @brief 停止监听并断开所有连接
+         */
+        void stop();
+
+        /**
+         * @brief 获取当前连接数
+         */
+        size_t getClientCount();
+
+    private:
+        // 接受连接的线程函数
+        void acceptLoop();
+
+        // 回收已结束的连接
+        void reapClients();
+
+    private:
+        SourceResolver resolver_;
+        HttpServerOptions options_;
+
+        SocketHandle listenSocket_;
+        std::atomic<bool> running_;
+        std::thread acceptThread_;
+
+        std::mutex clientsMutex_;
+        std::vector<std::unique_ptr<HttpStreamClient>> clients_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_HTTP_STREAM_SERVER_H
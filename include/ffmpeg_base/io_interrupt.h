@@ -0,0 +1,116 @@
+/**
+ * @file io_interrupt.h
+ * @brief FFmpeg阻塞I/O的中断控制：停止标志和单次调用的截止时间
+ */
+
+#ifndef FFMPEG_STREAM_IO_INTERRUPT_H
+#define FFMPEG_STREAM_IO_INTERRUPT_H
+
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class IOInterrupter
+ * @brief 作为AVIOInterruptCB安装到格式上下文上，FFmpeg在阻塞I/O中反复轮询
+ *
+ * 以下任一条件成立时阻塞中的调用返回AVERROR_EXIT：
+ * 调用了abort()、当前调用超过了截止时间、或父中断器已中止。
+ * 父中断器用于让流处理器的停止信号同时中断它所使用的输出和正在打开的输入。
+ * 所有方法都可以从任意线程调用。
+ */
+    class IOInterrupter {
+    public:
+        IOInterrupter();
+
+        IOInterrupter(const IOInterrupter&) = delete;
+        IOInterrupter& operator=(const IOInterrupter&) = delete;
+
+        /**
+         * @brief 安装到格式上下文，需在打开I/O之前调用
+         * @param context 格式上下文
+         */
+        void install(AVFormatContext* context);
+
+        /**
+         * @brief 获取中断回调，用于avio_open2等不经过格式上下文的调用
+         */
+        AVIOInterruptCB getCallback();
+
+        /**
+         * @brief 设置父中断器，为空时取消
+         * @param parent 父中断器，需在取消前保持有效
+         */
+        void setParent(const IOInterrupter* parent);
+
+        /**
+         * @brief 设置当前调用的截止时间
+         * @param timeoutMs 从现在起的毫秒数，不大于0时清除截止时间
+         */
+        void setDeadline(int timeoutMs);
+
+        /**
+         * @brief 清除截止时间
+         */
+        void clearDeadline();
+
+        /**
+         * @brief 中止所有进行中和之后的I/O，直到reset()
+         */
+        void abort();
+
+        /**
+         * @brief 清除中止标志和截止时间
+         */
+        void reset();
+
+        /**
+         * @brief 是否已中止(包括父中断器)
+         */
+        bool isAborted() const;
+
+        /**
+         * @brief 是否应中断当前调用
+         */
+        bool shouldInterrupt() const;
+
+    private:
+        // AVIOInterruptCB回调
+        static int onInterrupt(void* opaque);
+
+    private:
+        std::atomic<bool> aborted_;
+        std::atomic<int64_t> deadlineUs_;  // av_gettime_relative()时间，0表示无截止时间
+        std::atomic<const IOInterrupter*> parent_;
+    };
+
+/**
+ * @class IODeadline
+ * @brief 在作用域内为一次阻塞调用设置截止时间
+ */
+    class IODeadline {
+    public:
+        IODeadline(IOInterrupter& interrupter, int timeoutMs)
+                : interrupter_(interrupter) {
+            interrupter_.setDeadline(timeoutMs);
+        }
+
+        ~IODeadline() {
+            interrupter_.clearDeadline();
+        }
+
+        IODeadline(const IODeadline&) = delete;
+        IODeadline& operator=(const IODeadline&) = delete;
+
+    private:
+        IOInterrupter& interrupter_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_IO_INTERRUPT_H
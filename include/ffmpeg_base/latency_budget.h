@@ -0,0 +1,87 @@
+/**
+ * @file latency_budget.h
+ * @brief 推流延迟预算，处理落后时按GOP边界丢帧
+ */
+
+#ifndef FFMPEG_STREAM_LATENCY_BUDGET_H
+#define FFMPEG_STREAM_LATENCY_BUDGET_H
+
+#include <atomic>
+#include <cstdint>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class LatencyBudget
+ * @brief 以第一帧为锚点，比较时间戳推进和墙钟推进，估算处理落后于实时的程度
+ *
+ * 超过软上限时丢弃非参考帧；超过硬上限时丢弃所有数据直到下一个关键帧，
+ * 从关键帧恢复后重新锚定时钟。只在处理线程中调用check()，统计值可从其他线程读取。
+ */
+    class LatencyBudget {
+    public:
+        // 对当前单元的处理方式
+        enum class Action {
+            KEEP,              // 正常处理
+            DROP_NONREF,       // 超过软上限，非参考帧应丢弃
+            DROP_TO_KEYFRAME   // 超过硬上限，丢弃直到下一个关键帧
+        };
+
+        LatencyBudget();
+
+        /**
+         * @brief 设置延迟上限，softMs为0时关闭
+         * @param softMs 软上限(毫秒)
+         * @param hardMs 硬上限(毫秒)，不大于softMs时取softMs的3倍
+         */
+        void configure(int softMs, int hardMs);
+
+        /**
+         * @brief 清除锚点和丢帧状态(重连后调用)
+         */
+        void reset();
+
+        /**
+         * @brief 检查一个包或一帧
+         * @param timestamp 时间戳
+         * @param timeBase 时间基
+         * @param keyframe 是否为关键帧
+         * @param backlogMs 下游队列中尚未处理的数据时长
+         * @return 处理方式
+         */
+        Action check(int64_t timestamp, AVRational timeBase, bool keyframe, int64_t backlogMs);
+
+        /**
+         * @brief 最近一次估算的延迟(毫秒)
+         */
+        int64_t getLatencyMs() const;
+
+        /**
+         * @brief 当前是否处于丢弃非参考帧的状态
+         */
+        bool isSheddingNonRef() const;
+
+    private:
+        // 以当前单元重新锚定时钟
+        void anchor(int64_t now, int64_t timestamp, AVRational timeBase);
+
+    private:
+        int softLimitMs_;
+        int hardLimitMs_;
+
+        // 锚点：墙钟(微秒)和对应的时间戳(微秒)
+        int64_t startWallUs_;
+        int64_t startTimestampUs_;
+
+        bool waitKeyframe_;
+        std::atomic<bool> sheddingNonRef_;
+        std::atomic<int64_t> latencyMs_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_LATENCY_BUDGET_H
@@ -0,0 +1,247 @@
+/**
+ * @file media_queue.h
+ * @brief 流水线阶段之间传递AVPacket/AVFrame引用的有界队列
+ */
+
+#ifndef FFMPEG_STREAM_MEDIA_QUEUE_H
+#define FFMPEG_STREAM_MEDIA_QUEUE_H
+
+#include "common/common.h"
+#include "common/scheduler.h"
+#include "common/spsc_queue.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+namespace ffmpeg_stream {
+
+// AVPacket/AVFrame的引用计数操作
+    template<typename T>
+    struct MediaRefTraits;
+
+    template<>
+    struct MediaRefTraits<AVPacket> {
+        static AVPacket* alloc() { return av_packet_alloc(); }
+        static void free(AVPacket** packet) { av_packet_free(packet); }
+        static int ref(AVPacket* dst, const AVPacket* src) { return av_packet_ref(dst, src); }
+        static void moveRef(AVPacket* dst, AVPacket* src) { av_packet_move_ref(dst, src); }
+        static void unref(AVPacket* packet) { av_packet_unref(packet); }
+        // 丢包后需要等到下一个关键帧才能继续解码
+        static bool isSyncPoint(const AVPacket* packet) { return (packet->flags & AV_PKT_FLAG_KEY) != 0; }
+    };
+
+    template<>
+    struct MediaRefTraits<AVFrame> {
+        static AVFrame* alloc() { return av_frame_alloc(); }
+        static void free(AVFrame** frame) { av_frame_free(frame); }
+        static int ref(AVFrame* dst, const AVFrame* src) { return av_frame_ref(dst, src); }
+        static void moveRef(AVFrame* dst, AVFrame* src) { av_frame_move_ref(dst, src); }
+        static void unref(AVFrame* frame) { av_frame_unref(frame); }
+        // 解码后的帧彼此独立，任何一帧都可以作为恢复点
+        static bool isSyncPoint(const AVFrame*) { return true; }
+    };
+
+/**
+ * @class MediaQueue
+ * @brief 基于SPSCQueue的引用计数媒体队列
+ *
+ * push时对输入做av_*_ref，pop时move到调用方对象，数据本身不拷贝。
+ * 槽位中的AVPacket/AVFrame首次使用时分配，之后一直复用。
+ * 队列满时按溢出策略阻塞生产者、丢弃新数据或丢弃队首的旧数据；
+ * 丢弃包后会一直丢弃到下一个关键帧，保证下游解码器不会收到缺少参考帧的数据。
+ * DROP_OLDEST由生产者代为出队，因此该策略下出队操作都在popMutex_保护下进行，
+ * 其他策略仍是无锁的单生产者单消费者访问。
+ * 生产者运行在调度器工作线程上时，BLOCK策略最多等待kMaxWorkerBlock后按丢弃处理，
+ * 避免所有工作线程都阻塞在满队列上而消费者得不到执行。
+ */
+    template<typename T>
+    class MediaQueue {
+    public:
+        using Traits = MediaRefTraits<T>;
+
+        /**
+         * @brief 构造函数
+         * @param capacity 队列深度
+         * @param policy 队列满时的处理策略
+         */
+        MediaQueue(size_t capacity, QueueOverflowPolicy policy)
+                : queue_(capacity), policy_(policy), aborted_(false),
+                  waitSyncPoint_(false), droppedCount_(0) {
+        }
+
+        ~MediaQueue() {
+            clear();
+            queue_.forEachSlot([](T*& slot) {
+                if (slot) {
+                    Traits::free(&slot);
+                }
+            });
+        }
+
+        MediaQueue(const MediaQueue&) = delete;
+        MediaQueue& operator=(const MediaQueue&) = delete;
+
+        /**
+         * @brief 入队一个引用(生产者线程调用)
+         * @param item 输入对象，调用方仍保有自己的引用
+         * @return 是否入队，被丢弃或已中止时返回false
+         */
+        bool push(const T* item) {
+            // 丢弃后等待恢复点
+            if (waitSyncPoint_) {
+                if (!Traits::isSyncPoint(item)) {
+                    droppedCount_++;
+                    return false;
+                }
+                waitSyncPoint_ = false;
+            }
+
+            auto fill = [item](T*& slot) {
+                if (!slot) {
+                    slot = Traits::alloc();
+                    if (!slot) {
+                        return false;
+                    }
+                }
+                return Traits::ref(slot, item) >= 0;
+            };
+
+            auto blockStart = std::chrono::steady_clock::now();
+            while (!aborted_) {
+                if (queue_.tryPush(fill)) {
+                    return true;
+                }
+
+                if (policy_ == QueueOverflowPolicy::DROP_OLDEST) {
+                    if (!dropOldest(item)) {
+                        droppedCount_++;
+                        waitSyncPoint_ = true;
+                        return false;
+                    }
+                    continue;
+                }
+
+                if (policy_ != QueueOverflowPolicy::BLOCK ||
+                    (Scheduler::isWorkerThread() &&
+                     std::chrono::steady_clock::now() - blockStart > kMaxWorkerBlock)) {
+                    droppedCount_++;
+                    waitSyncPoint_ = true;
+                    return false;
+                }
+
+                // BLOCK策略：等待消费者腾出空间
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief 出队到调用方对象(消费者线程调用)
+         * @param item 输出对象，原有引用会先被释放
+         * @return 队列为空时返回false
+         */
+        bool pop(T* item) {
+            auto drain = [item](T*& slot) {
+                Traits::unref(item);
+                Traits::moveRef(item, slot);
+            };
+            if (policy_ == QueueOverflowPolicy::DROP_OLDEST) {
+                std::lock_guard<std::mutex> lock(popMutex_);
+                return queue_.tryPop(drain);
+            }
+            return queue_.tryPop(drain);
+        }
+
+        /**
+         * @brief 丢弃队列中所有数据(消费者线程调用，或生产者和消费者都已停止时调用)
+         */
+        void clear() {
+            std::lock_guard<std::mutex> lock(popMutex_);
+            while (queue_.tryPop([](T*& slot) { Traits::unref(slot); })) {
+            }
+        }
+
+        /**
+         * @brief 中止阻塞中的生产者，之后的push都会失败
+         */
+        void abort() {
+            aborted_ = true;
+        }
+
+        /**
+         * @brief 重新启用队列(生产者和消费者都已停止时调用)
+         */
+        void reset() {
+            clear();
+            aborted_ = false;
+            waitSyncPoint_ = false;
+        }
+
+        size_t size() const {
+            return queue_.size();
+        }
+
+        bool empty() const {
+            return queue_.empty();
+        }
+
+        size_t capacity() const {
+            return queue_.capacity();
+        }
+
+        /**
+         * @brief 获取因队列满而丢弃的数量
+         */
+        uint64_t droppedCount() const {
+            return droppedCount_;
+        }
+
+    private:
+        static constexpr std::chrono::milliseconds kMaxWorkerBlock{50};
+
+        /**
+         * @brief 丢弃队首数据直到新的队首是恢复点(生产者线程调用)
+         * @param incoming 待入队的数据
+         * @return incoming能否接在剩余数据之后入队，队列被清空且incoming不是恢复点时返回false
+         */
+        bool dropOldest(const T* incoming) {
+            std::lock_guard<std::mutex> lock(popMutex_);
+            auto drop = [this](T*& slot) {
+                Traits::unref(slot);
+                droppedCount_++;
+            };
+            queue_.tryPop(drop);
+
+            // 队首若不是恢复点，它依赖的数据已被丢弃，继续丢到下一个恢复点
+            bool headIsSyncPoint = false;
+            while (queue_.tryPeek([&headIsSyncPoint](T*& slot) {
+                headIsSyncPoint = Traits::isSyncPoint(slot);
+            }) && !headIsSyncPoint) {
+                queue_.tryPop(drop);
+            }
+
+            return headIsSyncPoint || Traits::isSyncPoint(incoming);
+        }
+
+        SPSCQueue<T*> queue_;
+        QueueOverflowPolicy policy_;
+        std::atomic<bool> aborted_;
+        std::mutex popMutex_;  // DROP_OLDEST策略下生产者和消费者都会出队
+        bool waitSyncPoint_;  // 仅生产者访问
+        std::atomic<uint64_t> droppedCount_;
+    };
+
+    using PacketQueue = MediaQueue<AVPacket>;
+    using FrameQueue = MediaQueue<AVFrame>;
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_MEDIA_QUEUE_H
@@ -0,0 +1,82 @@
+/**
+ * @file reconnect_policy.h
+ * @brief 重连退避策略：指数退避、随机抖动和按错误类型区分的等待时间
+ */
+
+#ifndef FFMPEG_STREAM_RECONNECT_POLICY_H
+#define FFMPEG_STREAM_RECONNECT_POLICY_H
+
+#include <cstdint>
+#include <random>
+
+namespace ffmpeg_stream {
+
+/**
+ * @class ReconnectPolicy
+ * @brief 计算每次重连前的等待时间
+ *
+ * 等待时间按 基础延迟 * 2^(尝试次数 + 错误类型偏移) 增长并受上限约束，
+ * 实际取值在[一半, 全部]之间随机，避免大量流在同一时刻集中重连。
+ * 认证失败和资源不存在短时间内不会自行恢复，退避更快且上限更高。
+ */
+    class ReconnectPolicy {
+    public:
+        // 导致重连的错误类型
+        enum class ErrorClass {
+            TRANSIENT,    // 流结束或未知错误
+            TIMEOUT,      // 网络超时
+            UNREACHABLE,  // 连接被拒绝、主机或网络不可达
+            AUTH,         // 认证失败或无权限
+            NOT_FOUND     // 地址不存在或无可用的视频流
+        };
+
+        ReconnectPolicy();
+
+        /**
+         * @brief 设置参数
+         * @param baseDelayMs 第一次重连的基础等待时间(毫秒)
+         * @param maxDelayMs 等待时间上限(毫秒)
+         * @param maxAttempts 最大连续重连次数，小于0表示不限
+         */
+        void configure(int baseDelayMs, int maxDelayMs, int maxAttempts);
+
+        /**
+         * @brief 清除连续重连次数(连接稳定后调用)
+         */
+        void reset();
+
+        /**
+         * @brief 计算下一次重连的等待时间并累加尝试次数
+         * @param error 导致重连的FFmpeg错误码，0表示未知
+         * @return 等待时间(毫秒)，已达到最大次数时返回-1
+         */
+        int nextDelay(int error);
+
+        /**
+         * @brief 获取连续重连次数
+         */
+        int getAttempts() const;
+
+        /**
+         * @brief 按FFmpeg错误码分类
+         * @param error FFmpeg错误码
+         * @return 错误类型
+         */
+        static ErrorClass classify(int error);
+
+        /**
+         * @brief 错误类型名称，用于日志
+         */
+        static const char* errorClassToString(ErrorClass errorClass);
+
+    private:
+        int baseDelayMs_;
+        int maxDelayMs_;
+        int maxAttempts_;
+        int attempts_;
+        std::mt19937 random_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_RECONNECT_POLICY_H
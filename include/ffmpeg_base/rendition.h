@@ -0,0 +1,243 @@
+/**
+ * @file rendition.h
+ * @brief 推流输出档位：缩放、编码和封装一路输出
+ */
+
+#ifndef FFMPEG_STREAM_RENDITION_H
+#define FFMPEG_STREAM_RENDITION_H
+
+#include "common/common.h"
+#include "common/stage_runner.h"
+#include "config/config.h"
+#include "audio_transcoder.h"
+#include "encoder.h"
+#include "frame_rate_converter.h"
+#include "media_queue.h"
+#include "reconnect_policy.h"
+#include "stream_output.h"
+#include "video_scaler.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class Rendition
+ * @brief 多码率阶梯中的一档输出
+ *
+ * 转码档位拥有自己的帧队列和编码阶段，同一解码帧以引用方式交给各档位，
+ * 各档位的缩放和编码在各自的StageRunner上并行执行，编码前按档位帧率丢弃或重复帧。
+ * 输入编码参数与档位配置一致时该档位直接转封装，不解码也不编码。
+ * 输入音频默认直通；只有输出容器无法承载输入的音频编码时才转码为AAC。
+ * 输出格式为"llhls"或"cmaf"时，输出地址是本地目录，写入fMP4分段、部分分段和滚动的HLS播放列表，
+ * 直接使用本档位编码(或转封装)的包，不做第二次编码。
+ *
+ * 一个档位可以有多路输出(主输出加extraOutputs)，编码只进行一次，同一个包以引用方式交给每路输出，
+ * 每路输出有自己的封装器、封装队列和重连状态。有多路输出时，出错的输出由I/O调度器按退避定时关闭并重新打开，
+ * 等待期间不占用线程，其余输出不受影响；只有所有输出都放弃后档位才报告错误，由所属流整体重连。
+ */
+    class Rendition {
+    public:
+        /**
+         * @brief 构造函数
+         * @param name 档位名称，用于日志和线程名
+         * @param config 档位配置
+         * @param streamConfig 所属流的配置，提供硬件加速、队列和网络超时参数
+         * @param interrupter 所属流的中断器(可选)，中止时打断输出的阻塞I/O
+         */
+        Rendition(const std::string& name, const RenditionConfig& config, const StreamConfig& streamConfig,
+                  const IOInterrupter* interrupter = nullptr);
+
+        /**
+         * @brief 析构函数，关闭输出
+         */
+        ~Rendition();
+
+        Rendition(const Rendition&) = delete;
+        Rendition& operator=(const Rendition&) = delete;
+
+        /**
+         * @brief 判断输出格式是否为本地HLS/CMAF输出
+         * @param format 档位配置的输出格式
+         */
+        static bool isHlsFormat(const std::string& format);
+
+        /**
+         * @brief 生成本地HLS/CMAF输出的封装器选项
+         * @param config 流配置，提供分段、部分分段时长和播放列表长度
+         */
+        static std::map<std::string, std::string> makeHlsOptions(const StreamConfig& config);
+
+        /**
+         * @brief 判断输入编码参数是否与档位配置一致，可直接转封装
+         * @param config 档位配置
+         * @param codecParams 输入视频流编码参数
+         */
+        static bool canCopy(const RenditionConfig& config, const AVCodecParameters* codecParams);
+
+        /**
+         * @brief 选择转封装或转码，初始化编码器并打开输出
+         * @param inputStream 输入视频流
+         * @param audioStream 输入音频流，nullptr表示只输出视频
+         * @return 是否成功打开
+         */
+        bool open(const AVStream* inputStream, const AVStream* audioStream = nullptr);
+
+        /**
+         * @brief 停止编码阶段，编码剩余的帧并冲刷编码器，关闭输出
+         */
+        void close();
+
+        /**
+         * @brief 是否为转封装档位
+         */
+        bool isCopy() const;
+
+        /**
+         * @brief 转封装一个输入包(仅重算时间戳)，仅转封装档位使用
+         * @param packet 输入包，时间戳会被原地修改
+         * @return 输出出错时返回false
+         */
+        bool pushPacket(AVPacket* packet);
+
+        /**
+         * @brief 输出一个音频包，时间戳按视频的起点归零，视频起点确定之前的音频被丢弃
+         * @param packet 输入音频包，时间戳会被原地修改
+         * @return 输出出错时返回false
+         */
+        bool pushAudio(AVPacket* packet);
+
+        /**
+         * @brief 将解码帧的引用交给编码阶段，仅转码档位使用
+         * @param frame 解码帧，调用方仍保有引用
+         * @return 编码或输出出错时返回false
+         */
+        bool pushFrame(const AVFrame* frame);
+
+        /**
+         * @brief 获取编码或封装的错误码，0表示正常(至少还有一路输出可用)
+         */
+        int getError() const;
+
+        /**
+         * @brief 获取编码队列中积压的时长(毫秒)，按本档位的帧时间戳计算
+         */
+        int64_t getBacklogMs() const;
+
+        /**
+         * @brief 获取因编码队列或封装队列满而丢弃的数量
+         */
+        uint64_t getDroppedCount() const;
+
+        /**
+         * @brief 获取当前正常写入的输出数
+         */
+        size_t getActiveOutputCount() const;
+
+        /**
+         * @brief 获取档位配置
+         */
+        const RenditionConfig& getConfig() const;
+
+    private:
+        // 一路输出：封装器和重连状态
+        struct OutputSlot {
+            std::string name;    // 输出名称，用于日志和线程名
+            std::string url;     // 实际打开的地址，本地HLS为目录下的清单
+            std::string format;  // 实际使用的封装格式
+            bool hls;
+
+            std::mutex openMutex;  // 重新打开期间持有，档位关闭时借此等待进行中的重新打开
+            bool closed;           // 档位已关闭，定时的重新打开直接放弃，受openMutex保护
+
+            std::mutex mutex;                       // 保护以下成员
+            std::unique_ptr<StreamOutput> output;   // 正在写入的输出，等待重连时为空
+            std::unique_ptr<StreamOutput> stale;    // 出错的输出，由重新打开任务关闭
+            ReconnectPolicy reconnect;
+            bool waitKeyframe;   // 重新打开后从下一个视频关键帧开始写入
+            bool failed;         // 已放弃
+        };
+
+        // 按主输出和额外输出创建输出槽
+        bool createOutputSlots();
+
+        // 以保存的编码参数创建并打开一路输出，失败时返回nullptr
+        std::unique_ptr<StreamOutput> openOutput(OutputSlot& slot, int& error);
+
+        // 将包的引用交给每路正常的输出，所有输出都已放弃时返回false
+        bool writeToOutputs(AVPacket* packet, AVRational timeBase, bool video);
+
+        // 摘下出错的输出并按退避定时重新打开，或放弃，需持有slot->mutex
+        void failOutput(const std::shared_ptr<OutputSlot>& slot, int error);
+
+        // 关闭出错的输出并重新打开，需持有slot->openMutex且档位未关闭
+        void reopenOutput(const std::shared_ptr<OutputSlot>& slot);
+
+        // 关闭全部输出并释放保存的编码参数
+        void releaseOutputs();
+
+        // 编码阶段的单步函数，返回是否有进展
+        bool encodeStep();
+
+        // 按目标帧率取舍，缩放并编码一帧
+        bool encodeFrame(AVFrame* frame);
+
+        // 将编码后的包交给输出
+        bool writeEncodedPacket(AVPacket* packet);
+
+        // 记录编码阶段的第一个错误
+        void setError(int error);
+
+    private:
+        std::string name_;
+        RenditionConfig config_;
+        StreamConfig streamConfig_;
+        const IOInterrupter* interrupter_;
+
+        bool copy_;  // 是否转封装
+        AVRational inputTimeBase_;
+        int64_t startDts_;   // 转封装时第一个输出包的DTS，用于将时间戳归零
+        std::atomic<int64_t> ptsOffset_;  // 转码时第一帧的PTS，用于将时间戳归零，音频也以此对齐
+        std::atomic<int64_t> queuedPts_;    // 最近入队的帧的PTS(输入时间基)
+        std::atomic<int64_t> encodingPts_;  // 编码阶段最近取出的帧的PTS(输入时间基)
+
+        // 音频：直通或转码
+        AVRational audioTimeBase_;  // 输入音频流时间基，未输出音频时num为0
+        std::unique_ptr<AudioTranscoder> audioTranscoder_;
+
+        std::unique_ptr<FrameRateConverter> rateConverter_;
+        std::unique_ptr<VideoScaler> scaler_;
+        std::unique_ptr<HWEncoder> encoder_;
+
+        // 输出：各路共用的编码参数，重连时用于重新打开
+        std::vector<std::shared_ptr<OutputSlot>> outputs_;  // 定时的重新打开任务持有弱引用
+        AVCodecParameters* videoParams_;
+        AVRational videoOutTimeBase_;
+        AVCodecParameters* audioParams_;  // nullptr表示只输出视频
+        AVRational audioOutTimeBase_;
+        AVPacket* videoRef_;  // 视频写入线程交给各输出的引用
+        AVPacket* audioRef_;  // 音频写入线程交给各输出的引用
+        std::atomic<size_t> failedOutputs_;
+        std::atomic<int> outputError_;  // 最近一路放弃的输出的错误码
+
+        // 处理阶段 -> frameQueue_ -> 缩放/编码 -> 输出
+        std::unique_ptr<FrameQueue> frameQueue_;
+        std::unique_ptr<StageRunner> encodeStage_;
+        AVFrame* encodeFrame_;   // 编码阶段取出的帧
+        AVFrame* scaledFrame_;   // 缩放输出，缓冲区在编码器和帧率转换释放后由缩放器的缓冲池复用
+        AVFrame* repeatFrame_;   // 填补缺少的时隙时重复的上一帧
+
+        std::atomic<int> error_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_RENDITION_H
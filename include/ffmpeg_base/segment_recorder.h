@@ -0,0 +1,168 @@
+/**
+ * @file segment_recorder.h
+ * @brief 分段录像，输入的包不解码直接写入按时长切分的文件
+ */
+
+#ifndef FFMPEG_STREAM_SEGMENT_RECORDER_H
+#define FFMPEG_STREAM_SEGMENT_RECORDER_H
+
+#include "common/stage_runner.h"
+#include "config/config.h"
+#include "stream_output.h"
+#include "stream_source.h"
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class SegmentRecorder
+ * @brief 一个流的录像：订阅输入源的音视频包，在关键帧处切分为MPEG-TS或分片MP4文件
+ *
+ * 分段文件写在recordPath下以流ID命名的子目录中，文件名为分段开始的本地时间。
+ * 两种格式都不依赖尾部：MPEG-TS每个包直接落盘，MP4使用空moov加关键帧分片，断电后已写出的分片仍可播放。
+ * 每个分段结束后以及写入中的每个关键帧处，按保留时长、本流空间上限和所有录像合计的磁盘配额删除最早的分段，
+ * 正在写的分段和启动时目录中已有的分段也计入。队列满丢包时在分段结束时记录警告。
+ * 输入重连时由StreamProcessor停止后重新启动，重连后总是开始新的分段。
+ */
+    class SegmentRecorder {
+    public:
+        /**
+         * @brief 构造函数
+         * @param streamId 流ID，用作录像子目录名
+         * @param config 流配置，提供录像设置
+         */
+        SegmentRecorder(int streamId, const StreamConfig& config);
+
+        /**
+         * @brief 析构函数，结束当前分段
+         */
+        ~SegmentRecorder();
+
+        SegmentRecorder(const SegmentRecorder&) = delete;
+        SegmentRecorder& operator=(const SegmentRecorder&) = delete;
+
+        /**
+         * @brief 订阅输入源并开始录像，输入源缓存的包作为预录写入第一个分段
+         * @param source 已打开的输入源
+         * @return 是否成功开始
+         */
+        bool start(const std::shared_ptr<StreamSource>& source);
+
+        /**
+         * @brief 停止录像，写完当前分段并取消订阅
+         */
+        void stop();
+
+        /**
+         * @brief 获取录像目录
+         */
+        const std::string& getDirectory() const;
+
+        /**
+         * @brief 获取本流已完成的分段数
+         */
+        size_t getSegmentCount() const;
+
+        /**
+         * @brief 获取本流录像占用的字节数，包括正在写的分段(按最近一个关键帧时的文件大小)
+         */
+        int64_t getBytes() const;
+
+        /**
+         * @brief 设置所有流录像合计的磁盘配额，0表示不限
+         */
+        static void setDiskQuota(int64_t maxBytes);
+
+    private:
+        // 已完成的分段文件
+        struct SegmentFile {
+            std::string path;
+            std::time_t endTime;  // 结束时间(墙钟)，用于按保留时长删除
+            int64_t bytes;
+        };
+
+        // 录像阶段单步
+        bool recordStep();
+
+        // 写出一个包，视频关键帧到达分段时长时先切分
+        void writePacket(AVPacket* packet, bool video);
+
+        // 以当前视频关键帧为起点打开新的分段
+        bool openSegment(int64_t startUs);
+
+        // 结束当前分段并执行保留策略
+        void closeSegment();
+
+        // 订阅队列累计丢弃的包数(视频和音频之和)
+        uint64_t subscriptionDropped() const;
+
+        // 扫描录像目录中已有的分段
+        void loadSegments();
+
+        // 按保留时长和本流空间上限删除最早的分段
+        void enforceRetention();
+
+        // 删除本流最早的一个分段，没有可删除的分段时返回false，需持有segmentsMutex_
+        bool removeOldestSegment();
+
+        // 按磁盘配额删除所有流中最早的分段
+        static void enforceDiskQuota();
+
+    private:
+        int streamId_;
+        std::string directory_;
+        std::string format_;     // 封装格式名
+        std::string extension_;  // 分段文件扩展名
+        int64_t segmentUs_;
+        int64_t retentionSeconds_;  // 0表示不按时间删除
+        int64_t maxBytes_;          // 0表示不限
+        size_t queueDepth_;
+
+        // 输入源和订阅
+        std::shared_ptr<StreamSource> source_;
+        std::shared_ptr<SourceSubscription> videoSubscription_;
+        std::shared_ptr<SourceSubscription> audioSubscription_;
+        AVRational videoTimeBase_;
+        AVRational audioTimeBase_;
+        bool recordAudio_;  // 输入有音频且分段格式能直接封装
+
+        // 读取 -> 录像阶段，两个队列各暂存一个包，先写出时间戳较早的
+        std::unique_ptr<StageRunner> recordStage_;
+        AVPacket* videoPacket_;
+        AVPacket* audioPacket_;
+        bool videoPending_;
+        bool audioPending_;
+
+        // 当前分段，仅录像阶段访问
+        std::unique_ptr<StreamOutput> output_;
+        std::string segmentPath_;
+        int64_t segmentStartUs_;  // 分段起点关键帧的DTS(微秒)
+        int64_t retryAfterUs_;    // 打开或写入失败后，到该时间之前不再尝试新分段
+        uint64_t segmentDroppedBase_;  // 分段开始时订阅队列的累计丢弃数
+
+        // 已完成的分段，按开始时间排序
+        mutable std::mutex segmentsMutex_;
+        std::deque<SegmentFile> segments_;
+        std::atomic<int64_t> bytes_;         // 已完成的分段
+        std::atomic<int64_t> currentBytes_;  // 正在写的分段，计入本流空间上限和磁盘配额
+
+        // 所有录像，用于按磁盘配额跨流删除
+        static std::mutex registryMutex_;
+        static std::vector<SegmentRecorder*> recorders_;
+        static std::atomic<int64_t> diskQuota_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_SEGMENT_RECORDER_H
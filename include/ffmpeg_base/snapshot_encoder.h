@@ -0,0 +1,53 @@
+/**
+ * @file snapshot_encoder.h
+ * @brief JPEG快照编码器
+ */
+
+#ifndef FFMPEG_STREAM_SNAPSHOT_ENCODER_H
+#define FFMPEG_STREAM_SNAPSHOT_ENCODER_H
+
+#include "video_scaler.h"
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+}
+
+namespace ffmpeg_stream {
+
+// JPEG快照编码器类：缩放到目标尺寸后用MJPEG编码器编码单帧
+    class SnapshotEncoder {
+    public:
+        SnapshotEncoder();
+        ~SnapshotEncoder();
+
+        SnapshotEncoder(const SnapshotEncoder&) = delete;
+        SnapshotEncoder& operator=(const SnapshotEncoder&) = delete;
+
+        // 设置JPEG质量(2-31，越小质量越高)，下次编码时生效
+        void setQuality(int qscale);
+
+        // 将frame编码为JPEG写入jpeg
+        // width/height为0时按原图宽高比推算，都为0时保持原尺寸
+        bool encode(const AVFrame* frame, int width, int height, std::vector<uint8_t>& jpeg);
+
+        // 清理资源
+        void cleanup();
+
+    private:
+        // 按输出尺寸打开编码器，尺寸不变时复用
+        bool openEncoder(int width, int height);
+
+    private:
+        AVCodecContext* codecContext;
+        VideoScaler scaler;
+        AVFrame* scaledFrame;
+        AVPacket* encodedPacket;
+        int quality;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_SNAPSHOT_ENCODER_H
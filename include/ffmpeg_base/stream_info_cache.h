@@ -0,0 +1,112 @@
+/**
+ * @file stream_info_cache.h
+ * @brief 输入流参数缓存，重连和重启时缩短探测
+ */
+
+#ifndef FFMPEG_STREAM_INFO_CACHE_H
+#define FFMPEG_STREAM_INFO_CACHE_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @struct CachedStreamInfo
+ * @brief 一个输入的视频流参数
+ */
+    struct CachedStreamInfo {
+        AVCodecID codecId = AV_CODEC_ID_NONE;
+        int width = 0;
+        int height = 0;
+        int format = -1;  // 像素格式
+        int profile = -1;
+        int level = -1;
+        AVRational timeBase = {0, 1};
+        AVRational frameRate = {0, 1};
+        std::vector<uint8_t> extradata;  // SPS/PPS等
+    };
+
+/**
+ * @class StreamInfoCache
+ * @brief 按输入地址缓存avformat_find_stream_info得到的视频流参数
+ *
+ * 键中地址的用户名和密码会被去掉，带凭据的RTSP地址不会以明文写入缓存文件。
+ * 有缓存的输入以很小的探测量打开，只等到第一个关键帧给出分辨率，
+ * 其余参数(帧率、extradata)从缓存补齐；探测结果与缓存不一致时以探测结果为准并更新缓存。
+ * 缓存可以保存到文件，冷启动时同样走快速路径。所有方法都是线程安全的。
+ */
+    class StreamInfoCache {
+    public:
+        StreamInfoCache();
+
+        /**
+         * @brief 查找缓存
+         * @param key 输入地址
+         * @param info 输出缓存的参数
+         * @return 是否命中
+         */
+        bool lookup(const std::string& key, CachedStreamInfo& info) const;
+
+        /**
+         * @brief 保存探测到的视频流参数，分辨率未知时忽略
+         * @param key 输入地址
+         * @param stream 视频流
+         */
+        void store(const std::string& key, const AVStream* stream);
+
+        /**
+         * @brief 删除缓存，下一次打开时完整探测
+         * @param key 输入地址
+         */
+        void invalidate(const std::string& key);
+
+        /**
+         * @brief 判断快速探测的结果是否与缓存一致，尚未探测出的字段不参与比较
+         * @param info 缓存的参数
+         * @param stream 快速探测后的视频流
+         */
+        static bool matches(const CachedStreamInfo& info, const AVStream* stream);
+
+        /**
+         * @brief 用缓存补齐快速探测未得到的参数
+         * @param info 缓存的参数
+         * @param stream 视频流
+         */
+        static void apply(const CachedStreamInfo& info, AVStream* stream);
+
+        /**
+         * @brief 从文件加载缓存
+         * @param filePath 文件路径
+         * @return 是否成功加载
+         */
+        bool loadFromFile(const std::string& filePath);
+
+        /**
+         * @brief 缓存有变化时保存到文件
+         * @param filePath 文件路径
+         * @return 是否成功保存(无变化时也返回true)
+         */
+        bool saveToFile(const std::string& filePath);
+
+        /**
+         * @brief 获取缓存条目数
+         */
+        size_t size() const;
+
+    private:
+        mutable std::mutex mutex_;
+        std::map<std::string, CachedStreamInfo> entries_;
+        bool dirty_;  // 自上次保存后有变化
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_INFO_CACHE_H
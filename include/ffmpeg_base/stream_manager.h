@@ -8,7 +8,9 @@
 
 #include "common/common.h"
 #include "config/config.h"
+#include "common/scheduler.h"
 #include "common/threadpool.h"
+#include "ffmpeg_base/http_stream_server.h"
 #include "ffmpeg_base/stream_processor.h"
 #include <mutex>
 #include <thread>
@@ -24,7 +26,8 @@ namespace ffmpeg_stream {
  * @class StreamManager
  * @brief 管理多个流的处理和监控
  *
- * 使用线程池处理多个流，确保实时性和低延迟
+ * 各流的处理任务运行在共享调度器上，少量工作线程服务大量的流；
+ * 线程池只用于重连等可能阻塞的操作
  */
     class StreamManager {
     public:
@@ -117,6 +120,50 @@ namespace ffmpeg_stream {
          */
         StreamStatus getStreamStatus(int streamId);
 
+        /**
+         * @brief 获取流运行统计(延迟和丢帧计数)
+         * @param streamId 流ID
+         * @return 统计值，流不存在时全部为0
+         */
+        StreamStats getStreamStats(int streamId);
+
+        /**
+         * @brief 订阅流的解码帧，回调收到引用计数的帧句柄并异步执行，慢回调不影响拉流
+         * @param streamId 流ID
+         * @param handler 帧回调
+         * @param options 订阅参数(队列深度、溢出策略、执行回调的调度器)
+         * @return 订阅者，流不存在时返回nullptr
+         */
+        std::shared_ptr<FrameSubscriber> subscribeFrames(int streamId, const FrameHandler& handler,
+                                                         const FrameSubscriberOptions& options = FrameSubscriberOptions());
+
+        /**
+         * @brief 取消帧订阅
+         * @param streamId 流ID
+         * @param subscriber subscribeFrames返回的订阅者
+         * @return 流是否存在
+         */
+        bool unsubscribeFrames(int streamId, const std::shared_ptr<FrameSubscriber>& subscriber);
+
+        /**
+         * @brief 获取流最新一帧的JPEG快照，按需编码并短时间缓存，不额外建立连接或解码
+         * @param streamId 流ID
+         * @param width 宽度，0表示按宽高比推算
+         * @param height 高度，0表示按宽高比推算，都为0时保持原尺寸
+         * @return JPEG数据，流不存在、尚无解码帧或编码失败时为空
+         */
+        std::vector<uint8_t> getSnapshot(int streamId, int width = 0, int height = 0);
+
+        /**
+         * @brief 运行中切换拉流的解码模式，不重连
+         * @param streamId 流ID
+         * @param mode 解码模式
+         * @param frameInterval EVERY_NTH模式下每N帧输出一帧
+         * @param fastDecode 是否快速解码
+         * @return 流不存在或不是拉流时返回false
+         */
+        bool setDecodeMode(int streamId, DecodeMode mode, int frameInterval = 1, bool fastDecode = false);
+
         /**
          * @brief 获取流配置
          * @param streamId 流ID
@@ -133,7 +180,7 @@ namespace ffmpeg_stream {
         bool updateStreamConfig(int streamId, const StreamConfig& config);
 
         /**
-         * @brief 调整线程池大小
+         * @brief 调整线程池和调度器工作线程数
          * @param numThreads 新的线程数
          */
         void resizeThreadPool(size_t numThreads);
@@ -169,8 +216,13 @@ namespace ffmpeg_stream {
         bool saveConfig(const std::string& filePath);
 
     private:
-        // 流处理循环函数
-        void streamProcessingLoop(std::shared_ptr<StreamProcessor> processor);
+        // 按退避策略定时安排重连，等待期间不占用线程，失败且未被停止时继续重试
+        void scheduleReconnect(const std::shared_ptr<StreamProcessor>& processor);
+
+        // 创建流处理器并注册输入结束回调
+        std::shared_ptr<StreamProcessor> createProcessor(int streamId, const StreamConfig& config,
+                                                         const StatusCallback& statusCb,
+                                                         const FrameCallback& frameCb);
 
         // 检查流状态
         void checkStreams();
@@ -178,20 +230,39 @@ namespace ffmpeg_stream {
         // 获取下一个流ID
         int getNextStreamId();
 
+        // 流参数缓存有变化时保存到文件
+        void saveStreamInfoCache();
+
+        // 按当前各流的输入源和输出数调整I/O调度器线程数，需持有streamsMutex_
+        void updateIOSchedulerSize();
+
     private:
         // 线程池
         std::unique_ptr<ThreadPool> threadPool_;
 
+        // 重连专用线程池，大量输入同时断开时阻塞的打开不会占满通用线程池
+        std::unique_ptr<ThreadPool> reconnectPool_;
+
         // 流处理器映射
         std::mutex streamsMutex_;
         std::map<int, std::shared_ptr<StreamProcessor>> streams_;
 
-        // 流处理任务映射
-        std::map<int, std::future<void>> streamTasks_;
+        // 流参数缓存，重连和重启时缩短探测
+        std::shared_ptr<StreamInfoCache> streamInfoCache_;
+        std::string streamInfoCachePath_;  // 为空时不保存
+
+        // 共享输入源注册表，相同输入的流共用一次拉流和解码
+        std::shared_ptr<SourceRegistry> sourceRegistry_;
 
         // 流ID计数器
         std::atomic<int> nextStreamId_;
 
+        // 配置的I/O调度器线程数，0表示按输入源和输出数自动伸缩
+        int ioThreadPoolSize_;
+
+        // 内置HTTP分发服务器，配置启用时创建
+        std::unique_ptr<HttpStreamServer> httpServer_;
+
         // 监控线程控制
         std::atomic<bool> monitorRunning_;
         std::thread monitorThread_;
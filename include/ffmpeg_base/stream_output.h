@@ -0,0 +1,173 @@
+/**
+ * @file stream_output.h
+ * @brief 单路输出，负责视频(及可选音频)的封装和写出
+ */
+
+#ifndef FFMPEG_STREAM_OUTPUT_H
+#define FFMPEG_STREAM_OUTPUT_H
+
+#include "common/common.h"
+#include "common/stage_runner.h"
+#include "io_interrupt.h"
+#include "media_queue.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+/**
+ * @class StreamOutput
+ * @brief 一个输出URL：输出上下文、封装队列和封装阶段
+ *
+ * 生产者(编码或转封装)调用write()入队，封装阶段在独立的StageRunner上写出，
+ * 网络写入的阻塞不会影响上游。每次写入都有截止时间，父中断器中止时进行中的写入立即返回。
+ * 音频包使用独立的队列，保证每个队列只有一个生产者，两路数据由av_interleaved_write_frame交织。
+ */
+    class StreamOutput {
+    public:
+        /**
+         * @brief 构造函数
+         * @param name 输出名称，用于日志和线程名
+         * @param url 输出地址
+         * @param format 输出格式，为空时按地址推断
+         * @param queueDepth 封装队列深度
+         * @param policy 封装队列满时的处理策略
+         * @param ioTimeoutMs 单次打开或写入的超时(毫秒)，0表示不限
+         * @param interrupter 父中断器(可选)，中止时打断进行中的I/O
+         */
+        StreamOutput(const std::string& name, const std::string& url, const std::string& format,
+                     size_t queueDepth, QueueOverflowPolicy policy,
+                     int ioTimeoutMs = 0, const IOInterrupter* interrupter = nullptr);
+
+        /**
+         * @brief 析构函数，关闭输出
+         */
+        ~StreamOutput();
+
+        StreamOutput(const StreamOutput&) = delete;
+        StreamOutput& operator=(const StreamOutput&) = delete;
+
+        /**
+         * @brief 设置写入头时传给封装器的选项(如movflags)，open()之前调用
+         * @param options 选项名和值
+         */
+        void setMuxOptions(const std::map<std::string, std::string>& options);
+
+        /**
+         * @brief 创建视频流(流0)和可选的音频流(流1)，打开输出地址，写入头并启动封装阶段
+         * @param codecParams 视频流编码参数
+         * @param timeBase 建议的视频流时间基，封装器可能修改
+         * @param audioParams 音频流编码参数，nullptr表示只输出视频
+         * @param audioTimeBase 建议的音频流时间基
+         * @return 是否成功打开
+         */
+        bool open(const AVCodecParameters* codecParams, AVRational timeBase,
+                  const AVCodecParameters* audioParams = nullptr, AVRational audioTimeBase = {0, 1});
+
+        /**
+         * @brief 入队一个包
+         * @param packet 包，时间戳会被原地转换到输出流时间基，调用方仍保有引用
+         * @param srcTimeBase 包时间戳的时间基
+         * @return 输出已出错时返回false，队列满被丢弃不算错误
+         */
+        bool write(AVPacket* packet, AVRational srcTimeBase);
+
+        /**
+         * @brief 入队一个音频包，用法同write()
+         * @param packet 音频包
+         * @param srcTimeBase 包时间戳的时间基
+         * @return 输出已出错或没有音频流时返回false
+         */
+        bool writeAudio(AVPacket* packet, AVRational srcTimeBase);
+
+        /**
+         * @brief 停止封装阶段，写出队列中剩余的包和尾部，关闭输出
+         *
+         * 剩余数据和尾部的写出共用一个较短的截止时间，不受父中断器影响，
+         * 对端已失效时不会长时间阻塞，本地文件仍能完整写出尾部。
+         */
+        void close();
+
+        /**
+         * @brief 获取打开或封装阶段的错误码，0表示正常
+         */
+        int getError() const;
+
+        /**
+         * @brief 获取因封装队列满而丢弃的包数(视频和音频之和)
+         */
+        uint64_t getDroppedCount() const;
+
+        /**
+         * @brief 输出是否已打开
+         */
+        bool isOpened() const;
+
+        /**
+         * @brief 获取输出地址
+         */
+        const std::string& getUrl() const;
+
+        /**
+         * @brief 输出是否带有音频流
+         */
+        bool hasAudio() const;
+
+        /**
+         * @brief 按格式名或地址推断输出格式
+         * @param format 格式名，为空时按地址推断
+         * @param url 输出地址
+         * @return 输出格式，无法推断时返回nullptr
+         */
+        static const AVOutputFormat* guessFormat(const std::string& format, const std::string& url);
+
+        /**
+         * @brief 判断输出格式能否直接封装某种音频编码
+         * @param format 输出格式，nullptr时不做限制
+         * @param codecId 音频编码
+         */
+        static bool canCarryAudio(const AVOutputFormat* format, AVCodecID codecId);
+
+    private:
+        // 封装阶段的单步函数，返回是否有进展
+        bool muxStep();
+
+        // 记录第一个错误
+        void setError(int error);
+
+        // 释放输出上下文
+        void freeContext();
+
+    private:
+        std::string name_;
+        std::string url_;
+        std::string format_;
+        std::map<std::string, std::string> muxOptions_;
+
+        AVFormatContext* formatContext_;
+        bool opened_;
+
+        // I/O中断控制
+        IOInterrupter interrupter_;
+        const IOInterrupter* parentInterrupter_;
+        int ioTimeoutMs_;
+
+        // 生产者 -> queue_ / audioQueue_ -> 封装
+        std::unique_ptr<PacketQueue> queue_;
+        std::unique_ptr<PacketQueue> audioQueue_;
+        int audioStreamIndex_;  // -1表示没有音频流
+        std::unique_ptr<StageRunner> muxStage_;
+        AVPacket* muxPacket_;
+
+        std::atomic<int> error_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_OUTPUT_H
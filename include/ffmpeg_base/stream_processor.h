@@ -7,13 +7,24 @@
 #define FFMPEG_STREAM_PROCESSOR_H
 
 #include "common/common.h"
+#include "common/stage_runner.h"
 #include "config/config.h"
-#include "decoder.h"
-#include "encoder.h"
+#include "frame_subscriber.h"
+#include "io_interrupt.h"
+#include "latency_budget.h"
+#include "reconnect_policy.h"
+#include "media_queue.h"
+#include "rendition.h"
+#include "segment_recorder.h"
+#include "snapshot_encoder.h"
+#include "stream_source.h"
 #include <atomic>
 #include <chrono>
+#include <map>
 #include <memory>
 #include <functional>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -21,12 +32,20 @@ extern "C" {
 
 namespace ffmpeg_stream {
 
+// 单次处理的结果
+    enum class ProcessResult {
+        PROGRESS,  // 处理了数据
+        IDLE,      // 暂无数据或未在运行
+        ENDED      // 输入结束或输出出错，需要重连
+    };
+
 /**
  * @class StreamProcessor
  * @brief 处理单个流的编解码和转发
  *
  * 该类负责单个流的处理逻辑，包括拉流和推流。
- * 与原始设计不同，处理逻辑从StreamManager移到此类，以便通过线程池调度。
+ * 处理逻辑作为可恢复的任务运行在调度器上，每次只处理一个包或一帧，
+ * 少量工作线程即可轮流服务大量的流。
  */
     class StreamProcessor {
     public:
@@ -35,11 +54,13 @@ namespace ffmpeg_stream {
          * @param id 流ID
          * @param config 流配置
          * @param statusCallback 状态回调函数
-         * @param frameCallback 帧回调函数（可选）
+         * @param frameCallback 帧回调函数（可选），以BLOCK策略的帧订阅者异步调用，帧仅在回调期间有效
+         * @param sourceRegistry 共享输入源注册表（可选，为空时输入不与其他流共享）
          */
         StreamProcessor(int id, const StreamConfig& config,
                         const StatusCallback& statusCallback = nullptr,
-                        const FrameCallback& frameCallback = nullptr);
+                        const FrameCallback& frameCallback = nullptr,
+                        std::shared_ptr<SourceRegistry> sourceRegistry = nullptr);
 
         /**
          * @brief 析构函数
@@ -53,10 +74,17 @@ namespace ffmpeg_stream {
         bool start();
 
         /**
-         * @brief 停止流处理
+         * @brief 停止流处理，先中断正在阻塞的网络I/O
          */
         void stop();
 
+        /**
+         * @brief 中断正在进行的输入打开和输出写入，之后的I/O立即失败直到下次启动
+         *
+         * 只设置标志，可从任意线程调用，用于停止和超时重连前让阻塞的调用尽快返回。
+         */
+        void interrupt();
+
         /**
          * @brief 获取当前状态
          * @return 流状态
@@ -71,9 +99,9 @@ namespace ffmpeg_stream {
 
         /**
          * @brief 获取配置
-         * @return 流配置
+         * @return 流配置，解码模式取当前生效值
          */
-        const StreamConfig& getConfig() const;
+        StreamConfig getConfig() const;
 
         /**
          * @brief 更新配置
@@ -82,6 +110,15 @@ namespace ffmpeg_stream {
          */
         bool updateConfig(const StreamConfig& config);
 
+        /**
+         * @brief 运行中切换解码模式，不重连(仅拉流)
+         * @param mode 解码模式
+         * @param frameInterval EVERY_NTH模式下每N帧输出一帧
+         * @param fastDecode 是否快速解码(跳过环路滤波，编码支持时以低分辨率解码)
+         * @return 推流时返回false
+         */
+        bool setDecodeMode(DecodeMode mode, int frameInterval, bool fastDecode);
+
         /**
          * @brief 获取最后活动时间
          * @return 最后活动时间点
@@ -90,19 +127,34 @@ namespace ffmpeg_stream {
 
         /**
          * @brief 处理一次拉流工作
-         * @return 是否需要继续处理
+         * @return 处理结果
          */
-        bool processPull();
+        ProcessResult processPull();
 
         /**
          * @brief 处理一次推流工作
-         * @return 是否需要继续处理
+         * @return 处理结果
+         */
+        ProcessResult processPush();
+
+        /**
+         * @brief 设置输入结束或输出出错时的回调，在调度器工作线程上调用，不应阻塞
+         * @param callback 回调函数
+         */
+        void setEndCallback(const std::function<void()>& callback);
+
+        /**
+         * @brief 计算下一次重连前的等待时间，并将状态置为RECONNECTING
+         *
+         * 已有重连在等待中、流已停止或达到最大重连次数时返回-1，后者会将流置为STOPPED。
+         * 连接保持稳定一段时间后断开时，退避从头开始计算。
+         * @return 等待时间(毫秒)或-1
          */
-        bool processPush();
+        int nextReconnectDelay();
 
         /**
-         * @brief 处理重连
-         * @return 是否成功启动重连
+         * @brief 立即执行一次重连(不等待)，打开输入可能阻塞到网络超时
+         * @return 是否重连成功
          */
         bool handleReconnect();
 
@@ -113,19 +165,104 @@ namespace ffmpeg_stream {
          */
         bool isTimeout(int timeout = 30) const;
 
+        /**
+         * @brief 是否处于转封装(仅复制包)模式
+         * @return 推流且所有档位的输出配置都与输入编码参数一致时为true
+         */
+        bool isRemuxMode() const;
+
+        /**
+         * @brief 获取运行统计(延迟和丢帧计数)
+         * @return 统计值
+         */
+        StreamStats getStats() const;
+
+        /**
+         * @brief 订阅解码帧，回调收到引用计数的帧句柄，不拷贝像素数据
+         *
+         * 订阅跨越重连一直有效。拉流总有解码帧；推流只有存在转码档位时才有解码帧。
+         * @param handler 帧回调，在订阅者的分发任务上异步执行
+         * @param options 订阅参数(队列深度、溢出策略、执行回调的调度器)
+         * @return 订阅者，用于取消订阅和查询统计
+         */
+        std::shared_ptr<FrameSubscriber> subscribeFrames(FrameHandler handler,
+                                                         const FrameSubscriberOptions& options = FrameSubscriberOptions());
+
+        /**
+         * @brief 取消帧订阅，未分发的帧被丢弃，可以在回调中调用
+         * @param subscriber 订阅者
+         */
+        void unsubscribeFrames(const std::shared_ptr<FrameSubscriber>& subscriber);
+
+        /**
+         * @brief 获取最新一帧的JPEG快照
+         *
+         * 按需编码，snapshotCacheMs内同一尺寸的重复请求(或最新帧未变化时)直接返回缓存。
+         * 拉流没有帧回调和帧订阅者时只解码关键帧，快照最多落后一个GOP。
+         * @param width 宽度，0表示按高度和原图宽高比推算
+         * @param height 高度，0表示按宽度和原图宽高比推算，都为0时保持原尺寸
+         * @return JPEG数据，尚无解码帧或编码失败时为空
+         */
+        std::vector<uint8_t> getSnapshot(int width = 0, int height = 0);
+
+        /**
+         * @brief 获取当前连接的输入源，可在任意线程调用
+         *
+         * 输入源在重连时会更换，使用者应订阅其数据并在数据结束时重新获取。
+         * @return 输入源，未连接时返回nullptr
+         */
+        std::shared_ptr<StreamSource> getSource();
+
     private:
         // 设置流状态
         void setStatus(StreamStatus status, const std::string& message = "");
 
-        // 打开输入
+        // 从共享输入源订阅输入
         bool openInput();
 
+        // 取消订阅并释放输入源
+        void closeInput();
+
         // 打开输出（仅推流）
         bool openOutput();
 
         // 清理资源
         void cleanup();
 
+        // 推流的全部档位配置，主输出在前
+        std::vector<RenditionConfig> getRenditionConfigs() const;
+
+        // 将一个输入包交给所有转封装档位
+        bool dispatchPacket(AVPacket* packet);
+
+        // 将一帧解码帧交给所有转码档位
+        bool dispatchFrame(AVFrame* frame);
+
+        // 将一个音频包交给所有档位
+        bool dispatchAudio(AVPacket* packet);
+
+        // 把当前解码模式应用到帧订阅，没有帧消费者(只有快照)时只解码关键帧，需持有decodeModeMutex_
+        void applyDecodeMode();
+
+        // 将解码帧的引用转移到句柄中，保存为最新帧并交给所有帧订阅者，frame随后为空
+        void deliverFrame(AVFrame* frame);
+
+        // 按延迟预算判断是否丢弃一个包/一帧
+        bool shouldDropPacket(const AVPacket* packet);
+        bool shouldDropFrame(const AVFrame* frame);
+
+        // 汇总各队列的丢弃计数
+        void updateQueueDropStats();
+
+        // 输入结束(EOF或出错)后的处理，总是返回ENDED
+        ProcessResult handleInputEnd(int error);
+
+        // 处理任务的单步函数，返回是否有进展
+        bool processStep();
+
+        // 打开输入输出并启动处理任务，需持有lifecycleMutex_
+        bool connect();
+
     private:
         int id_;  // 流ID
         StreamConfig config_;  // 流配置
@@ -136,25 +273,83 @@ namespace ffmpeg_stream {
         StatusCallback statusCallback_;
         FrameCallback frameCallback_;
 
-        // 重连计数
-        int reconnectCount_;
+        // 帧订阅者，旧接口的帧回调也作为一个订阅者
+        mutable std::mutex frameSubscribersMutex_;
+        std::vector<std::shared_ptr<FrameSubscriber>> frameSubscribers_;
+        std::atomic<size_t> frameSubscriberCount_;
+        int nextSubscriberId_;
+
+        // 快照：最新一帧的引用，以及按尺寸缓存的JPEG
+        struct Snapshot {
+            FrameHandle frame;  // 编码所用的帧
+            std::chrono::steady_clock::time_point time;
+            std::vector<uint8_t> jpeg;
+        };
+        std::mutex latestFrameMutex_;
+        FrameHandle latestFrame_;
+        std::mutex snapshotMutex_;  // 同一流的快照串行编码，重复请求等待并复用结果
+        SnapshotEncoder snapshotEncoder_;
+        std::map<std::pair<int, int>, Snapshot> snapshots_;
+        std::function<void()> endCallback_;
+
+        // 处理任务
+        std::unique_ptr<StageRunner> processStage_;
+
+        // 启动、停止和重连互斥，停止前先中断I/O，不会长时间等待
+        std::mutex lifecycleMutex_;
+
+        // 重连退避
+        ReconnectPolicy reconnectPolicy_;
+        std::atomic<bool> reconnectPending_;  // 已安排重连，尚未执行
+        std::atomic<int> lastError_;  // 最近一次导致断开的错误码
+        std::atomic<int64_t> connectedTimeUs_;  // 最近一次连接成功的时间(av_gettime_relative)
 
         // 最后活动时间
         std::chrono::steady_clock::time_point lastActiveTime_;
 
-        // FFmpeg上下文
-        AVFormatContext* inputFormatContext_;
-        AVFormatContext* outputFormatContext_;
-        int videoStreamIndex_;
+        // 共享输入源：读取和解码在输入源中完成，同一输入的多个流只拉取和解码一次
+        std::shared_ptr<SourceRegistry> sourceRegistry_;
+        std::shared_ptr<StreamSource> source_;
+        std::mutex sourceMutex_;  // 保护source_的发布和inputOpened_，供getSource()在其他线程读取
+        std::shared_ptr<SourceSubscription> packetSubscription_;  // 转封装档位使用
+        std::shared_ptr<SourceSubscription> frameSubscription_;   // 拉流回调和转码档位使用
+        std::mutex decodeModeMutex_;  // 保护解码模式配置和frameSubscription_的设置，不随重连阻塞
+        std::shared_ptr<SourceSubscription> audioSubscription_;   // 推流音频直通使用
+
+        // 录像：直接订阅输入源的包，跨越重连保留，每次连接开始新的分段
+        std::unique_ptr<SegmentRecorder> recorder_;
 
-        // 解码器和编码器
-        std::unique_ptr<HWDecoder> decoder_;
-        std::unique_ptr<HWEncoder> encoder_;
+        // 推流输出档位：每个档位独立缩放、编码和封装
+        std::vector<std::unique_ptr<Rendition>> renditions_;
 
         // 工作状态变量
         bool inputOpened_;
         bool outputOpened_;
-        int64_t ptsOffset_;  // 用于PTS校正
+
+        // 复用的包/帧对象
+        AVPacket* packet_;       // 从输入源取出的包
+        AVPacket* copyPacket_;   // 交给各转封装档位的引用
+        AVFrame* frame_;         // 从输入源取出的帧
+
+        // 延迟预算，包和帧的时间戳分别锚定
+        LatencyBudget packetLatency_;
+        LatencyBudget frameLatency_;
+
+        // 各转码档位的帧率都远低于输入时，解码器跳过非参考帧以减少解码开销
+        bool decimateNonRef_;
+
+        // 运行中可调整的解码模式，处理阶段与getConfig()无锁读取，不改写config_
+        std::atomic<DecodeMode> decodeMode_;
+        std::atomic<int> decodeFrameInterval_;
+        std::atomic<bool> fastDecode_;
+
+        // 丢帧计数
+        std::atomic<uint64_t> nonRefDropped_;
+        std::atomic<uint64_t> gopDropped_;
+        std::atomic<uint64_t> queueDropped_;
+
+        // 本流所有输出和输入打开的父中断器
+        IOInterrupter ioInterrupter_;
     };
 
 } // namespace ffmpeg_stream
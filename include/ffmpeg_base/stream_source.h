@@ -0,0 +1,311 @@
+/**
+ * @file stream_source.h
+ * @brief 共享输入源，同一个输入只拉取和解码一次，分发给多个流处理器
+ */
+
+#ifndef FFMPEG_STREAM_SOURCE_H
+#define FFMPEG_STREAM_SOURCE_H
+
+#include "common/common.h"
+#include "common/stage_runner.h"
+#include "config/config.h"
+#include "decoder.h"
+#include "gop_cache.h"
+#include "io_interrupt.h"
+#include "media_queue.h"
+#include "stream_info_cache.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace ffmpeg_stream {
+
+// 订阅的数据类型
+    enum class SourceDataType {
+        PACKETS,        // 未解码的视频包(转封装)
+        FRAMES,         // 解码后的视频帧
+        AUDIO_PACKETS   // 未解码的音频包(直通)
+    };
+
+// 包订阅开始时从输入源的包缓存回放的范围
+    enum class SourcePreroll {
+        NONE,      // 只接收订阅之后读到的包
+        LAST_GOP,  // 从最近一个关键帧开始，用于秒开
+        ALL        // 缓存的全部包，用于录像预录
+    };
+
+/**
+ * @struct SourceSubscription
+ * @brief 一个订阅者的数据通道
+ *
+ * 输入源线程是队列唯一的生产者，订阅者是唯一的消费者。
+ */
+    struct SourceSubscription {
+        SourceSubscription(SourceDataType type, size_t depth, QueueOverflowPolicy policy,
+                           std::function<void()> notify);
+
+        SourceDataType type;
+        std::unique_ptr<PacketQueue> packets;  // type为PACKETS或AUDIO_PACKETS时有效
+        std::unique_ptr<FrameQueue> frames;    // type为FRAMES时有效
+
+        // 数据结束的原因(AVERROR_EOF或读取错误)，0表示仍在继续
+        // 队列取空后再检查该值，保证不会丢掉结束前的数据
+        std::atomic<int> endError;
+
+        // 有新数据或数据结束时在输入源线程上调用，用于唤醒订阅者的处理任务
+        std::function<void()> notify;
+
+        // 帧订阅者处理落后时置位，任一帧订阅者置位时解码器跳过非参考帧
+        std::atomic<bool> skipNonRef;
+
+        // 帧订阅者的解码模式，运行中可修改；共享的解码器按所有帧订阅者中要求最高的设置解码，
+        // 多解出的帧在分发时按各自的模式过滤
+        std::atomic<DecodeMode> decodeMode;
+        std::atomic<int> frameInterval;  // EVERY_NTH模式下每N帧输出一帧
+        std::atomic<bool> fastDecode;    // 所有帧订阅者都要求时才启用
+        uint64_t frameCounter;           // EVERY_NTH计数，仅输入源解码阶段访问
+
+        // 待回放的缓存范围，由读取阶段在分发下一个包之前回放，保证队列只有一个生产者
+        std::atomic<SourcePreroll> preroll;
+    };
+
+/**
+ * @class StreamSource
+ * @brief 打开一个输入URL，读取视频包并按需解码，以引用计数的方式分发给所有订阅者
+ *
+ * 读取阶段和解码阶段各自运行在StageRunner上。只有存在帧订阅者时才初始化解码器。
+ * 音频包只转发给音频订阅者，从不解码。
+ * 读取阶段把最近的包保存在GopCache中，新的包订阅者可以从关键帧立即开始。
+ * 读取阶段运行在I/O调度器上，可能阻塞的读取不占用编码、封装等阶段的工作线程。
+ * 输入以AVFMT_FLAG_NONBLOCK方式读取，支持非阻塞的协议暂无数据时让出工作线程并稍后重试。
+ * 打开和每次读取都有networkTimeout截止时间，超过该时间没有数据时按超时错误结束。
+ * 输入出错后输入源不再恢复，订阅者应释放它并通过SourceRegistry重新获取。
+ */
+    class StreamSource {
+    public:
+        /**
+         * @brief 构造函数
+         * @param key 注册表中的键
+         * @param config 第一个使用者的流配置，提供输入地址和网络选项
+         * @param infoCache 流参数缓存(可选)，命中时缩短探测
+         */
+        StreamSource(const std::string& key, const StreamConfig& config,
+                     std::shared_ptr<StreamInfoCache> infoCache = nullptr);
+
+        /**
+         * @brief 析构函数，关闭输入
+         */
+        ~StreamSource();
+
+        StreamSource(const StreamSource&) = delete;
+        StreamSource& operator=(const StreamSource&) = delete;
+
+        /**
+         * @brief 打开输入并开始读取，多个使用者并发调用时只打开一次
+         * @param interrupter 调用者的中断器(可选)，中止时打断正在进行的打开
+         * @return 是否成功打开
+         */
+        bool open(const IOInterrupter* interrupter = nullptr);
+
+        /**
+         * @brief 订阅数据
+         * @param type 数据类型
+         * @param depth 队列深度
+         * @param policy 队列满时的处理策略
+         * @param notify 有新数据或数据结束时的通知(可选)
+         * @param preroll 包订阅开始时回放的缓存范围，帧订阅忽略该参数
+         * @return 订阅通道，解码器初始化失败或订阅音频但输入没有音频时返回nullptr
+         */
+        std::shared_ptr<SourceSubscription> subscribe(SourceDataType type, size_t depth,
+                                                      QueueOverflowPolicy policy,
+                                                      std::function<void()> notify = nullptr,
+                                                      SourcePreroll preroll = SourcePreroll::NONE);
+
+        /**
+         * @brief 取消订阅
+         * @param subscription 订阅通道
+         */
+        void unsubscribe(const std::shared_ptr<SourceSubscription>& subscription);
+
+        /**
+         * @brief 获取视频流，输入打开后有效
+         */
+        AVStream* getVideoStream() const;
+
+        /**
+         * @brief 获取音频流，输入没有可用的音频时返回nullptr
+         */
+        AVStream* getAudioStream() const;
+
+        /**
+         * @brief 输入是否已失效(打开失败或读取出错)
+         */
+        bool isFailed() const;
+
+        /**
+         * @brief 获取打开输入时使用的配置
+         */
+        const StreamConfig& getConfig() const;
+
+        /**
+         * @brief 获取打开失败的错误码，用于区分重连策略
+         */
+        int getOpenError() const;
+
+        /**
+         * @brief 获取注册表键
+         */
+        const std::string& getKey() const;
+
+        /**
+         * @brief 获取当前订阅者数量
+         */
+        size_t getSubscriberCount() const;
+
+        /**
+         * @brief 获取包缓存的时长(毫秒)
+         */
+        int64_t getGopCacheDurationMs() const;
+
+        /**
+         * @brief 获取包缓存占用的字节数
+         */
+        int64_t getGopCacheBytes() const;
+
+    private:
+        // 打开输入格式上下文
+        bool openInput();
+
+        // 快速启动时用配置的输入参数提示补齐探测未得到的参数
+        void applyConfigHints(AVStream* stream, AVCodecID codecHint);
+
+        // 初始化解码器并启动解码阶段，需持有subscribersMutex_
+        bool startDecoding();
+
+        // 关闭输入
+        void close();
+
+        // 读取阶段单步
+        bool ingestStep();
+
+        // 限速读取时，距离包的释放时间还需等待的微秒数
+        int64_t paceDelay(const AVPacket* packet);
+
+        // 解码阶段单步
+        bool decodeStep();
+
+        // 回放订阅者待回放的缓存包，需持有subscribersMutex_
+        void replayGopCache();
+
+        // 将某一类订阅标记为结束
+        void endSubscriptions(SourceDataType type, int error);
+
+        // 将解码后的帧分发给帧订阅者
+        void dispatchFrame(AVFrame* frame);
+
+        // 按帧订阅者的解码模式和降帧请求设置解码器的跳帧和快速解码
+        void updateDecodeSettings();
+
+    private:
+        std::string key_;
+        StreamConfig config_;
+        std::shared_ptr<StreamInfoCache> infoCache_;
+
+        // 打开状态，打开过程中不持有openMutex_，其他使用者在openCondition_上等待结果
+        std::mutex openMutex_;
+        std::condition_variable openCondition_;
+        bool opened_;
+        bool opening_;
+        std::atomic<bool> openFailed_;
+        std::atomic<int> openError_;
+
+        // FFmpeg上下文
+        AVFormatContext* formatContext_;
+        int videoStreamIndex_;
+        int audioStreamIndex_;  // -1表示没有可用的音频
+        IOInterrupter interrupter_;
+        int64_t lastReadUs_;  // 最近一次读到数据的时间，用于检测非阻塞读取的超时
+        std::unique_ptr<HWDecoder> decoder_;
+
+        // 订阅者
+        mutable std::mutex subscribersMutex_;
+        std::vector<std::shared_ptr<SourceSubscription>> subscribers_;
+
+        // 读取 -> decodeQueue_ -> 解码，只有存在帧订阅者时才启用
+        std::atomic<bool> decodeEnabled_;
+        std::unique_ptr<PacketQueue> decodeQueue_;
+        std::unique_ptr<StageRunner> ingestStage_;
+        std::unique_ptr<StageRunner> decodeStage_;
+        AVPacket* readPacket_;
+        bool readPending_;  // readPacket_中有已读取但尚未到释放时间的包
+        AVPacket* decodePacket_;
+
+        // 最近的音视频包，仅读取阶段访问
+        GopCache gopCache_;
+        std::atomic<bool> prerollPending_;  // 有订阅者等待回放缓存
+
+        // 当前解码设置，仅解码阶段访问
+        AVDiscard skipFrame_;
+        bool fastDecoding_;
+        bool waitKeyframe_;  // 从只解码关键帧恢复或重建解码器后，等到关键帧再送入解码器
+
+        // 限速读取：单调时钟锚定到第一个包的DTS
+        int64_t paceStartUs_;
+        int64_t paceStartDtsUs_;
+
+        // 读取错误码，0表示正常
+        std::atomic<int> error_;
+    };
+
+/**
+ * @class SourceRegistry
+ * @brief 按输入URL和传输选项索引的输入源注册表
+ *
+ * 注册表只保存弱引用，最后一个使用者释放后输入源即关闭。
+ */
+    class SourceRegistry {
+    public:
+        /**
+         * @brief 构造函数
+         * @param infoCache 交给各输入源的流参数缓存(可选)
+         */
+        explicit SourceRegistry(std::shared_ptr<StreamInfoCache> infoCache = nullptr);
+
+        /**
+         * @brief 获取或创建输入源，返回的输入源需要调用open()
+         * @param config 流配置
+         * @return 输入源
+         */
+        std::shared_ptr<StreamSource> acquire(const StreamConfig& config);
+
+        /**
+         * @brief 生成输入源的键
+         * @param config 流配置
+         * @return 键
+         */
+        static std::string makeKey(const StreamConfig& config);
+
+        /**
+         * @brief 获取仍在使用的输入源数量
+         */
+        size_t getSourceCount();
+
+    private:
+        std::mutex mutex_;
+        std::map<std::string, std::weak_ptr<StreamSource>> sources_;
+        std::shared_ptr<StreamInfoCache> infoCache_;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_SOURCE_H
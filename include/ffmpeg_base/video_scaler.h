@@ -0,0 +1,99 @@
+/**
+ * @file video_scaler.h
+ * @brief 视频缩放和像素格式转换
+ */
+
+#ifndef FFMPEG_STREAM_VIDEO_SCALER_H
+#define FFMPEG_STREAM_VIDEO_SCALER_H
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace ffmpeg_stream {
+
+// 将配置中的缩放算法名称转换为SWS_*标志，未知名称返回SWS_BILINEAR
+    int scaleAlgorithmToSwsFlags(const std::string& name);
+
+/**
+ * @class VideoScaler
+ * @brief 编码前的转换阶段，将解码帧转换为编码器需要的尺寸和像素格式
+ *
+ * SwsContext按输入尺寸和像素格式缓存，只有这些参数变化时才重建；
+ * 输出帧的缓冲区在编码器和帧率转换不再引用时原地复用，仍被引用时从按输出参数建立的AVBufferPool换一块，
+ * 稳定运行时不再逐帧分配整帧内存。
+ * threads大于1时并行缩放：libswscale支持切片线程时(FFmpeg 5.0+)交给libswscale，
+ * 否则按输出行切成threads个条带，每个条带一个SwsContext，在共享的切片线程上并行执行。
+ */
+    class VideoScaler {
+    public:
+        VideoScaler();
+        ~VideoScaler();
+
+        VideoScaler(const VideoScaler&) = delete;
+        VideoScaler& operator=(const VideoScaler&) = delete;
+
+        // 设置输出尺寸和像素格式
+        void setTarget(int width, int height, AVPixelFormat pixFmt);
+
+        // 设置缩放算法(SWS_*)和切片线程数(0表示自动，FFmpeg 4下不切分)，下次缩放时生效
+        void setOptions(int swsFlags, int threads);
+
+        // 输入帧是否需要转换
+        bool needsScaling(const AVFrame* src) const;
+
+        // 将src转换到dst，dst的缓冲区在可写时原地复用，否则从缓冲池获取，时间戳等属性从src复制
+        // 返回0表示成功，否则返回FFmpeg错误码
+        int scale(const AVFrame* src, AVFrame* dst);
+
+        // 释放SwsContext
+        void cleanup();
+
+    private:
+        // 按输入参数重建SwsContext
+        bool rebuild(int width, int height, AVPixelFormat pixFmt);
+
+        // 释放dst原有的引用，从缓冲池为其分配输出缓冲
+        int allocateOutput(AVFrame* dst);
+
+        // 各条带并行缩放，返回FFmpeg错误码
+        int scaleBands(const AVFrame* src, AVFrame* dst);
+
+        // 按行切分的一个条带
+        struct ScaleBand {
+            SwsContext* context;
+            int srcY;
+            int srcHeight;
+            int dstY;
+            int dstHeight;
+        };
+
+    private:
+        SwsContext* swsContext;
+        AVBufferPool* bufferPool;  // 输出帧缓冲池，输出参数变化时重建
+        std::vector<ScaleBand> bands;  // 旧版libswscale按行切分时的条带，不切分时为空
+
+        // 当前SwsContext对应的输入参数
+        int srcWidth;
+        int srcHeight;
+        AVPixelFormat srcPixFmt;
+
+        // 输出参数
+        int dstWidth;
+        int dstHeight;
+        AVPixelFormat dstPixFmt;
+
+        // 缩放选项
+        int flags;
+        int threadCount;
+    };
+
+} // namespace ffmpeg_stream
+
+#endif // FFMPEG_STREAM_VIDEO_SCALER_H
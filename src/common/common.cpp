@@ -4,9 +4,21 @@
  */
 
 #include "common/common.h"
+#include <algorithm>
+#include <cctype>
 
 namespace ffmpeg_stream {
 
+    namespace {
+        // 配置中的枚举值不区分大小写
+        std::string toUpper(const std::string& str) {
+            std::string upper = str;
+            std::transform(upper.begin(), upper.end(), upper.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+            return upper;
+        }
+    }
+
     std::string streamStatusToString(StreamStatus status) {
         switch (status) {
             case StreamStatus::DISCONNECTED: return "DISCONNECTED";
@@ -38,6 +50,24 @@ namespace ffmpeg_stream {
         }
     }
 
+    std::string queueOverflowPolicyToString(QueueOverflowPolicy policy) {
+        switch (policy) {
+            case QueueOverflowPolicy::BLOCK: return "BLOCK";
+            case QueueOverflowPolicy::DROP_NEWEST: return "DROP_NEWEST";
+            case QueueOverflowPolicy::DROP_OLDEST: return "DROP_OLDEST";
+            default: return "UNKNOWN";
+        }
+    }
+
+    std::string decodeModeToString(DecodeMode mode) {
+        switch (mode) {
+            case DecodeMode::FULL: return "FULL";
+            case DecodeMode::EVERY_NTH: return "EVERY_NTH";
+            case DecodeMode::KEYFRAMES: return "KEYFRAMES";
+            default: return "UNKNOWN";
+        }
+    }
+
     StreamStatus stringToStreamStatus(const std::string& str) {
         if (str == "DISCONNECTED") return StreamStatus::DISCONNECTED;
         if (str == "CONNECTING") return StreamStatus::CONNECTING;
@@ -62,4 +92,18 @@ namespace ffmpeg_stream {
         return LogLevel::INFO;
     }
 
+    QueueOverflowPolicy stringToQueueOverflowPolicy(const std::string& str) {
+        std::string upper = toUpper(str);
+        if (upper == "BLOCK") return QueueOverflowPolicy::BLOCK;
+        if (upper == "DROP_OLDEST") return QueueOverflowPolicy::DROP_OLDEST;
+        return QueueOverflowPolicy::DROP_NEWEST;
+    }
+
+    DecodeMode stringToDecodeMode(const std::string& str) {
+        std::string upper = toUpper(str);
+        if (upper == "EVERY_NTH") return DecodeMode::EVERY_NTH;
+        if (upper == "KEYFRAMES") return DecodeMode::KEYFRAMES;
+        return DecodeMode::FULL;
+    }
+
 } // namespace ffmpeg_stream
\ No newline at end of file
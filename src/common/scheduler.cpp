@@ -0,0 +1,320 @@
+/**
+ * @file scheduler.cpp
+ * @brief 多路复用调度器实现
+ */
+
+#include "common/scheduler.h"
+#include "logger/logger.h"
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 一个任务连续有进展时，最多执行这么多次单步后让出工作线程
+        constexpr int kMaxStepsPerTurn = 16;
+
+        // 当前线程正在执行的任务，用于识别任务在单步中移除自己
+        thread_local const void* currentTask = nullptr;
+        thread_local bool workerThreadFlag = false;
+    }
+
+    Scheduler::Scheduler(size_t numWorkers)
+            : nextTaskId_(1), stop_(false), targetWorkers_(0), runningWorkers_(0),
+              workerCount_(0), activeWorkers_(0) {
+        resize(numWorkers);
+    }
+
+    Scheduler::~Scheduler() {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        stopWorkers();
+    }
+
+    Scheduler& Scheduler::getInstance() {
+        static Scheduler instance;
+        return instance;
+    }
+
+    Scheduler& Scheduler::getIOInstance() {
+        static Scheduler instance;
+        return instance;
+    }
+
+    Scheduler::TaskId Scheduler::addTask(const std::string& name, StepFunction step,
+                                         std::chrono::microseconds idleWait) {
+        auto task = std::make_shared<Task>();
+        task->name = name;
+        task->step = std::move(step);
+        task->idleWait = idleWait;
+        task->state = TaskState::QUEUED;
+        task->wakePending = false;
+        task->removed = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task->id = nextTaskId_++;
+            tasks_[task->id] = task;
+            ready_.push_back(task);
+        }
+        workCondition_.notify_one();
+
+        Logger::debug("Scheduler added task %s (%llu)", name.c_str(),
+                      static_cast<unsigned long long>(task->id));
+        return task->id;
+    }
+
+    void Scheduler::removeTask(TaskId id) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = tasks_.find(id);
+        if (it == tasks_.end()) {
+            return;
+        }
+
+        std::shared_ptr<Task> task = it->second;
+        tasks_.erase(it);
+        task->removed = true;
+
+        if (task->state == TaskState::PARKED) {
+            parked_.erase(task->parkedIt);
+        }
+        // 就绪队列中的任务由工作线程取出时跳过
+
+        // 在自己的单步中移除自己时不能等待
+        if (task->state == TaskState::RUNNING && currentTask != task.get()) {
+            doneCondition_.wait(lock, [&task] { return task->state != TaskState::RUNNING; });
+        }
+    }
+
+    void Scheduler::wakeTask(TaskId id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = tasks_.find(id);
+        if (it == tasks_.end()) {
+            return;
+        }
+
+        const std::shared_ptr<Task>& task = it->second;
+        if (task->state == TaskState::RUNNING) {
+            task->wakePending = true;
+        } else if (task->state == TaskState::PARKED) {
+            parked_.erase(task->parkedIt);
+            enqueueLocked(task);
+        }
+    }
+
+    void Scheduler::runAfter(std::chrono::milliseconds delay, std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            timers_.emplace(Clock::now() + delay, std::move(fn));
+        }
+        // 唤醒一个工作线程重新计算等待时间
+        workCondition_.notify_one();
+    }
+
+    void Scheduler::resize(size_t numWorkers) {
+        if (numWorkers == 0) {
+            numWorkers = std::thread::hardware_concurrency();
+        }
+        if (numWorkers == 0) {
+            numWorkers = 1;
+        }
+
+        // 并发的resize串行执行；size()读取workerCount_，不需要等待调整完成
+        std::lock_guard<std::mutex> workersLock(workersMutex_);
+        size_t currentSize = workerCount_;
+        if (numWorkers == currentSize) {
+            return;
+        }
+
+        reapRetiredWorkers();
+
+        // 任务状态保存在调度器中，增减工作线程不影响任务。
+        // 多出的工作线程在当前单步返回后自行退出，不等待阻塞在I/O上的单步
+        size_t toStart = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = false;
+            targetWorkers_ = numWorkers;
+            if (runningWorkers_ < numWorkers) {
+                toStart = numWorkers - runningWorkers_;
+                runningWorkers_ = numWorkers;
+            }
+        }
+        workCondition_.notify_all();
+
+        for (size_t i = 0; i < toStart; ++i) {
+            workers_.emplace_back(&Scheduler::workerThread, this);
+        }
+        workerCount_ = numWorkers;
+
+        Logger::info("Scheduler resized from %zu to %zu workers", currentSize, numWorkers);
+    }
+
+    size_t Scheduler::size() const {
+        return workerCount_;
+    }
+
+    size_t Scheduler::getTaskCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.size();
+    }
+
+    size_t Scheduler::activeWorkers() const {
+        return activeWorkers_;
+    }
+
+    bool Scheduler::isWorkerThread() {
+        return workerThreadFlag;
+    }
+
+    void Scheduler::reapRetiredWorkers() {
+        std::vector<std::thread::id> retired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            retired.swap(retired_);
+        }
+
+        // 已退出工作循环的线程很快结束，join不会长时间等待
+        for (const std::thread::id& id : retired) {
+            for (auto it = workers_.begin(); it != workers_.end(); ++it) {
+                if (it->get_id() == id) {
+                    it->join();
+                    workers_.erase(it);
+                    break;
+                }
+            }
+        }
+    }
+
+    void Scheduler::stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        workCondition_.notify_all();
+
+        for (std::thread& worker : workers_) {
+            if (worker.joinable()) {
+                worker.join();
+            }
+        }
+        workers_.clear();
+        workerCount_ = 0;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        retired_.clear();
+        runningWorkers_ = 0;
+        targetWorkers_ = 0;
+    }
+
+    void Scheduler::enqueueLocked(const std::shared_ptr<Task>& task) {
+        task->state = TaskState::QUEUED;
+        ready_.push_back(task);
+        workCondition_.notify_one();
+    }
+
+    void Scheduler::parkLocked(const std::shared_ptr<Task>& task, Clock::time_point deadline) {
+        task->state = TaskState::PARKED;
+        task->parkedIt = parked_.emplace(deadline, task);
+    }
+
+    void Scheduler::workerThread() {
+        workerThreadFlag = true;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            // 缩容时多出的工作线程退出，由下一次resize回收
+            if (runningWorkers_ > targetWorkers_) {
+                --runningWorkers_;
+                retired_.push_back(std::this_thread::get_id());
+                break;
+            }
+
+            Clock::time_point now = Clock::now();
+
+            // 超时的挂起任务重新进入就绪队列
+            while (!parked_.empty() && parked_.begin()->first <= now) {
+                std::shared_ptr<Task> task = parked_.begin()->second;
+                parked_.erase(parked_.begin());
+                task->state = TaskState::QUEUED;
+                ready_.push_back(task);
+            }
+
+            // 到期的定时函数
+            if (!timers_.empty() && timers_.begin()->first <= now) {
+                std::function<void()> fn = std::move(timers_.begin()->second);
+                timers_.erase(timers_.begin());
+
+                lock.unlock();
+                try {
+                    fn();
+                } catch (const std::exception& e) {
+                    Logger::error("Exception in scheduled timer: %s", e.what());
+                } catch (...) {
+                    Logger::error("Unknown exception in scheduled timer");
+                }
+                lock.lock();
+                continue;
+            }
+
+            if (ready_.empty()) {
+                // 等待新任务或最早的超时
+                Clock::time_point deadline = Clock::time_point::max();
+                if (!parked_.empty()) deadline = parked_.begin()->first;
+                if (!timers_.empty() && timers_.begin()->first < deadline) deadline = timers_.begin()->first;
+
+                if (deadline == Clock::time_point::max()) {
+                    workCondition_.wait(lock);
+                } else {
+                    workCondition_.wait_until(lock, deadline);
+                }
+                continue;
+            }
+
+            std::shared_ptr<Task> task = std::move(ready_.front());
+            ready_.pop_front();
+            if (task->removed) {
+                continue;
+            }
+
+            task->state = TaskState::RUNNING;
+            task->wakePending = false;
+            lock.unlock();
+
+            // 连续执行单步直到无进展或用完本轮配额
+            ++activeWorkers_;
+            currentTask = task.get();
+            bool hasMore = true;
+            for (int i = 0; i < kMaxStepsPerTurn; ++i) {
+                bool progressed = false;
+                try {
+                    progressed = task->step();
+                } catch (const std::exception& e) {
+                    Logger::error("Exception in task %s: %s", task->name.c_str(), e.what());
+                } catch (...) {
+                    Logger::error("Unknown exception in task %s", task->name.c_str());
+                }
+                if (!progressed) {
+                    hasMore = false;
+                    break;
+                }
+            }
+            currentTask = nullptr;
+            --activeWorkers_;
+
+            lock.lock();
+            if (task->removed) {
+                task->state = TaskState::PARKED;
+                doneCondition_.notify_all();
+                continue;
+            }
+
+            if (hasMore || task->wakePending) {
+                // 排到队尾，保证其他任务也能得到执行
+                enqueueLocked(task);
+            } else {
+                parkLocked(task, Clock::now() + task->idleWait);
+            }
+        }
+
+        workerThreadFlag = false;
+    }
+
+} // namespace ffmpeg_stream
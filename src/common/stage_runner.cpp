@@ -0,0 +1,55 @@
+/**
+ * @file stage_runner.cpp
+ * @brief 流水线阶段执行器实现
+ */
+
+#include "common/stage_runner.h"
+#include "logger/logger.h"
+
+namespace ffmpeg_stream {
+
+    StageRunner::StageRunner(const std::string& name, std::chrono::microseconds idleWait, Scheduler* scheduler)
+            : name_(name),
+              idleWait_(idleWait),
+              scheduler_(scheduler ? *scheduler : Scheduler::getInstance()),
+              taskId_(0) {
+    }
+
+    StageRunner::~StageRunner() {
+        stop();
+    }
+
+    void StageRunner::start(StepFunction step) {
+        if (taskId_ != 0) {
+            Logger::warning("Stage %s is already running", name_.c_str());
+            return;
+        }
+
+        taskId_ = scheduler_.addTask(name_, std::move(step), idleWait_);
+
+        Logger::debug("Stage %s started", name_.c_str());
+    }
+
+    void StageRunner::stop() {
+        Scheduler::TaskId id = taskId_.exchange(0);
+        if (id == 0) {
+            return;
+        }
+
+        scheduler_.removeTask(id);
+
+        Logger::debug("Stage %s stopped", name_.c_str());
+    }
+
+    void StageRunner::wake() {
+        Scheduler::TaskId id = taskId_;
+        if (id != 0) {
+            scheduler_.wakeTask(id);
+        }
+    }
+
+    bool StageRunner::isRunning() const {
+        return taskId_ != 0;
+    }
+
+} // namespace ffmpeg_stream
@@ -9,14 +9,109 @@
 
 namespace ffmpeg_stream {
 
+// RenditionConfig 实现
+    OutputTarget OutputTarget::fromJson(const json& j) {
+        OutputTarget target;
+        if (j.is_string()) {
+            target.url = j;
+            return target;
+        }
+
+        if (j.contains("url")) target.url = j["url"];
+        if (j.contains("format")) target.format = j["format"];
+        return target;
+    }
+
+    json OutputTarget::toJson() const {
+        json j;
+        j["url"] = url;
+        j["format"] = format;
+        return j;
+    }
+
+    RenditionConfig::RenditionConfig()
+            : width(1920), height(1080), bitrate(4000000), fps(30), videoCodec("h264") {
+    }
+
+    RenditionConfig RenditionConfig::fromStreamConfig(const StreamConfig& config) {
+        RenditionConfig rendition;
+        rendition.name = "main";
+        rendition.outputUrl = config.outputUrl;
+        rendition.outputFormat = config.outputFormat;
+        rendition.width = config.width;
+        rendition.height = config.height;
+        rendition.bitrate = config.bitrate;
+        rendition.fps = config.fps;
+        rendition.videoCodec = config.videoCodec;
+        rendition.extraOutputs = config.extraOutputs;
+        return rendition;
+    }
+
+    RenditionConfig RenditionConfig::fromJson(const json& j, const StreamConfig& parent) {
+        RenditionConfig rendition = fromStreamConfig(parent);
+        rendition.name.clear();
+        rendition.outputUrl.clear();
+        rendition.extraOutputs.clear();
+
+        if (j.contains("name")) rendition.name = j["name"];
+        if (j.contains("outputUrl")) rendition.outputUrl = j["outputUrl"];
+        if (j.contains("outputFormat")) rendition.outputFormat = j["outputFormat"];
+        if (j.contains("width")) rendition.width = j["width"];
+        if (j.contains("height")) rendition.height = j["height"];
+        if (j.contains("bitrate")) rendition.bitrate = j["bitrate"];
+        if (j.contains("fps")) rendition.fps = j["fps"];
+        if (j.contains("videoCodec")) rendition.videoCodec = j["videoCodec"];
+        if (j.contains("extraOutputs") && j["extraOutputs"].is_array()) {
+            for (const auto& outputJson : j["extraOutputs"]) {
+                rendition.extraOutputs.push_back(OutputTarget::fromJson(outputJson));
+            }
+        }
+
+        if (rendition.name.empty()) {
+            rendition.name = std::to_string(rendition.height) + "p";
+        }
+
+        return rendition;
+    }
+
+    json RenditionConfig::toJson() const {
+        json j;
+
+        j["name"] = name;
+        j["outputUrl"] = outputUrl;
+        j["outputFormat"] = outputFormat;
+        j["width"] = width;
+        j["height"] = height;
+        j["bitrate"] = bitrate;
+        j["fps"] = fps;
+        j["videoCodec"] = videoCodec;
+
+        j["extraOutputs"] = json::array();
+        for (const auto& output : extraOutputs) {
+            j["extraOutputs"].push_back(output.toJson());
+        }
+
+        return j;
+    }
+
 // StreamConfig 实现
     StreamConfig::StreamConfig()
             : id(-1), type(StreamType::PULL), autoStart(false),
-              maxReconnects(10), reconnectDelay(3000),
+              maxReconnects(10), reconnectDelay(3000), reconnectMaxDelay(60000),
               width(1920), height(1080), bitrate(4000000), fps(30),
-              videoCodec("h264"),
+              videoCodec("h264"), scaleAlgorithm("bilinear"), scaleThreads(0),
               decoderHWAccel(HWAccelType::CUDA), encoderHWAccel(HWAccelType::CUDA),
-              networkTimeout(5000), rtspTransport("tcp"), lowLatency(true) {
+              probeSize(10485760), analyzeDurationMs(5000), fpsProbeSize(-1), fastStart(false),
+              inputWidth(0), inputHeight(0), inputFps(0),
+              audioEnabled(true), audioBitrate(64000),
+              networkTimeout(5000), rtspTransport("tcp"), lowLatency(true),
+              maxLatencyMs(1000), maxLatencyHardMs(3000), readRate(0.0),
+              queueDepth(128), queueOverflowPolicy(QueueOverflowPolicy::DROP_NEWEST),
+              gopCacheMs(2000), gopCacheMaxBytes(16 * 1024 * 1024),
+              decodeMode(DecodeMode::FULL), decodeFrameInterval(5), fastDecode(false),
+              snapshotCacheMs(1000), hlsSegmentMs(2000), hlsPartMs(500), hlsListSize(6),
+              recordEnabled(false), recordPath("recordings"), recordFormat("mpegts"),
+              recordSegmentSeconds(300), recordRetentionHours(72), recordMaxBytes(0) {
     }
 
     StreamConfig StreamConfig::fromJson(const json& j) {
@@ -28,10 +123,16 @@ namespace ffmpeg_stream {
         if (j.contains("inputUrl")) config.inputUrl = j["inputUrl"];
         if (j.contains("outputUrl")) config.outputUrl = j["outputUrl"];
         if (j.contains("outputFormat")) config.outputFormat = j["outputFormat"];
+        if (j.contains("extraOutputs") && j["extraOutputs"].is_array()) {
+            for (const auto& outputJson : j["extraOutputs"]) {
+                config.extraOutputs.push_back(OutputTarget::fromJson(outputJson));
+            }
+        }
         if (j.contains("autoStart")) config.autoStart = j["autoStart"];
 
         if (j.contains("maxReconnects")) config.maxReconnects = j["maxReconnects"];
         if (j.contains("reconnectDelay")) config.reconnectDelay = j["reconnectDelay"];
+        if (j.contains("reconnectMaxDelay")) config.reconnectMaxDelay = j["reconnectMaxDelay"];
 
         if (j.contains("width")) config.width = j["width"];
         if (j.contains("height")) config.height = j["height"];
@@ -39,12 +140,58 @@ namespace ffmpeg_stream {
         if (j.contains("fps")) config.fps = j["fps"];
         if (j.contains("videoCodec")) config.videoCodec = j["videoCodec"];
 
+        if (j.contains("renditions") && j["renditions"].is_array()) {
+            for (const auto& renditionJson : j["renditions"]) {
+                config.renditions.push_back(RenditionConfig::fromJson(renditionJson, config));
+            }
+        }
+
+        if (j.contains("scaleAlgorithm")) config.scaleAlgorithm = j["scaleAlgorithm"];
+        if (j.contains("scaleThreads")) config.scaleThreads = j["scaleThreads"];
+
         if (j.contains("decoderHWAccel")) config.decoderHWAccel = stringToHWAccelType(j["decoderHWAccel"]);
         if (j.contains("encoderHWAccel")) config.encoderHWAccel = stringToHWAccelType(j["encoderHWAccel"]);
 
+        if (j.contains("probeSize")) config.probeSize = j["probeSize"];
+        if (j.contains("analyzeDurationMs")) config.analyzeDurationMs = j["analyzeDurationMs"];
+        if (j.contains("fpsProbeSize")) config.fpsProbeSize = j["fpsProbeSize"];
+        if (j.contains("fastStart")) config.fastStart = j["fastStart"];
+        if (j.contains("inputCodec")) config.inputCodec = j["inputCodec"];
+        if (j.contains("inputWidth")) config.inputWidth = j["inputWidth"];
+        if (j.contains("inputHeight")) config.inputHeight = j["inputHeight"];
+        if (j.contains("inputFps")) config.inputFps = j["inputFps"];
+
+        if (j.contains("audioEnabled")) config.audioEnabled = j["audioEnabled"];
+        if (j.contains("audioBitrate")) config.audioBitrate = j["audioBitrate"];
+
         if (j.contains("networkTimeout")) config.networkTimeout = j["networkTimeout"];
         if (j.contains("rtspTransport")) config.rtspTransport = j["rtspTransport"];
         if (j.contains("lowLatency")) config.lowLatency = j["lowLatency"];
+        if (j.contains("maxLatencyMs")) config.maxLatencyMs = j["maxLatencyMs"];
+        if (j.contains("maxLatencyHardMs")) config.maxLatencyHardMs = j["maxLatencyHardMs"];
+        if (j.contains("readRate")) config.readRate = j["readRate"];
+
+        if (j.contains("queueDepth")) config.queueDepth = j["queueDepth"];
+        if (j.contains("queueOverflowPolicy"))
+            config.queueOverflowPolicy = stringToQueueOverflowPolicy(j["queueOverflowPolicy"]);
+        if (j.contains("gopCacheMs")) config.gopCacheMs = j["gopCacheMs"];
+        if (j.contains("gopCacheMaxBytes")) config.gopCacheMaxBytes = j["gopCacheMaxBytes"];
+
+        if (j.contains("decodeMode")) config.decodeMode = stringToDecodeMode(j["decodeMode"]);
+        if (j.contains("decodeFrameInterval")) config.decodeFrameInterval = j["decodeFrameInterval"];
+        if (j.contains("fastDecode")) config.fastDecode = j["fastDecode"];
+        if (j.contains("snapshotCacheMs")) config.snapshotCacheMs = j["snapshotCacheMs"];
+
+        if (j.contains("hlsSegmentMs")) config.hlsSegmentMs = j["hlsSegmentMs"];
+        if (j.contains("hlsPartMs")) config.hlsPartMs = j["hlsPartMs"];
+        if (j.contains("hlsListSize")) config.hlsListSize = j["hlsListSize"];
+
+        if (j.contains("recordEnabled")) config.recordEnabled = j["recordEnabled"];
+        if (j.contains("recordPath")) config.recordPath = j["recordPath"];
+        if (j.contains("recordFormat")) config.recordFormat = j["recordFormat"];
+        if (j.contains("recordSegmentSeconds")) config.recordSegmentSeconds = j["recordSegmentSeconds"];
+        if (j.contains("recordRetentionHours")) config.recordRetentionHours = j["recordRetentionHours"];
+        if (j.contains("recordMaxBytes")) config.recordMaxBytes = j["recordMaxBytes"];
 
         if (j.contains("extraOptions") && j["extraOptions"].is_object()) {
             for (auto& [key, value] : j["extraOptions"].items()) {
@@ -64,10 +211,15 @@ namespace ffmpeg_stream {
         j["inputUrl"] = inputUrl;
         j["outputUrl"] = outputUrl;
         j["outputFormat"] = outputFormat;
+        j["extraOutputs"] = json::array();
+        for (const auto& output : extraOutputs) {
+            j["extraOutputs"].push_back(output.toJson());
+        }
         j["autoStart"] = autoStart;
 
         j["maxReconnects"] = maxReconnects;
         j["reconnectDelay"] = reconnectDelay;
+        j["reconnectMaxDelay"] = reconnectMaxDelay;
 
         j["width"] = width;
         j["height"] = height;
@@ -75,12 +227,56 @@ namespace ffmpeg_stream {
         j["fps"] = fps;
         j["videoCodec"] = videoCodec;
 
+        j["renditions"] = json::array();
+        for (const auto& rendition : renditions) {
+            j["renditions"].push_back(rendition.toJson());
+        }
+
+        j["scaleAlgorithm"] = scaleAlgorithm;
+        j["scaleThreads"] = scaleThreads;
+
         j["decoderHWAccel"] = hwAccelTypeToString(decoderHWAccel);
         j["encoderHWAccel"] = hwAccelTypeToString(encoderHWAccel);
 
+        j["probeSize"] = probeSize;
+        j["analyzeDurationMs"] = analyzeDurationMs;
+        j["fpsProbeSize"] = fpsProbeSize;
+        j["fastStart"] = fastStart;
+        j["inputCodec"] = inputCodec;
+        j["inputWidth"] = inputWidth;
+        j["inputHeight"] = inputHeight;
+        j["inputFps"] = inputFps;
+
+        j["audioEnabled"] = audioEnabled;
+        j["audioBitrate"] = audioBitrate;
+
         j["networkTimeout"] = networkTimeout;
         j["rtspTransport"] = rtspTransport;
         j["lowLatency"] = lowLatency;
+        j["maxLatencyMs"] = maxLatencyMs;
+        j["maxLatencyHardMs"] = maxLatencyHardMs;
+        j["readRate"] = readRate;
+
+        j["queueDepth"] = queueDepth;
+        j["queueOverflowPolicy"] = queueOverflowPolicyToString(queueOverflowPolicy);
+        j["gopCacheMs"] = gopCacheMs;
+        j["gopCacheMaxBytes"] = gopCacheMaxBytes;
+
+        j["decodeMode"] = decodeModeToString(decodeMode);
+        j["decodeFrameInterval"] = decodeFrameInterval;
+        j["fastDecode"] = fastDecode;
+        j["snapshotCacheMs"] = snapshotCacheMs;
+
+        j["hlsSegmentMs"] = hlsSegmentMs;
+        j["hlsPartMs"] = hlsPartMs;
+        j["hlsListSize"] = hlsListSize;
+
+        j["recordEnabled"] = recordEnabled;
+        j["recordPath"] = recordPath;
+        j["recordFormat"] = recordFormat;
+        j["recordSegmentSeconds"] = recordSegmentSeconds;
+        j["recordRetentionHours"] = recordRetentionHours;
+        j["recordMaxBytes"] = recordMaxBytes;
 
         j["extraOptions"] = extraOptions;
 
@@ -90,7 +286,11 @@ namespace ffmpeg_stream {
 // GlobalConfig 实现
     GlobalConfig::GlobalConfig()
             : logLevel(LogLevel::INFO), logToFile(false), logFilePath("ffmpeg_stream.log"),
-              monitorInterval(5000), threadPoolSize(4), preloadLibraries(true),
+              monitorInterval(5000), threadPoolSize(4), ioThreadPoolSize(0), maxConcurrentReconnects(4), preloadLibraries(true),
+              streamInfoCacheFile("stream_info_cache.json"), gopCacheTotalBytes(512LL * 1024 * 1024),
+              recordDiskQuotaBytes(0),
+              httpServerEnabled(false), httpServerBindAddress("0.0.0.0"), httpServerPort(8080),
+              httpMaxClients(256), httpClientQueueDepth(512), httpClientTimeoutMs(5000),
               defaultDecoderHWAccel(HWAccelType::CUDA), defaultEncoderHWAccel(HWAccelType::CUDA) {
     }
 
@@ -107,7 +307,19 @@ namespace ffmpeg_stream {
 
         if (j.contains("monitorInterval")) config.monitorInterval = j["monitorInterval"];
         if (j.contains("threadPoolSize")) config.threadPoolSize = j["threadPoolSize"];
+        if (j.contains("ioThreadPoolSize")) config.ioThreadPoolSize = j["ioThreadPoolSize"];
+        if (j.contains("maxConcurrentReconnects")) config.maxConcurrentReconnects = j["maxConcurrentReconnects"];
         if (j.contains("preloadLibraries")) config.preloadLibraries = j["preloadLibraries"];
+        if (j.contains("streamInfoCacheFile")) config.streamInfoCacheFile = j["streamInfoCacheFile"];
+        if (j.contains("gopCacheTotalBytes")) config.gopCacheTotalBytes = j["gopCacheTotalBytes"];
+        if (j.contains("recordDiskQuotaBytes")) config.recordDiskQuotaBytes = j["recordDiskQuotaBytes"];
+
+        if (j.contains("httpServerEnabled")) config.httpServerEnabled = j["httpServerEnabled"];
+        if (j.contains("httpServerBindAddress")) config.httpServerBindAddress = j["httpServerBindAddress"];
+        if (j.contains("httpServerPort")) config.httpServerPort = j["httpServerPort"];
+        if (j.contains("httpMaxClients")) config.httpMaxClients = j["httpMaxClients"];
+        if (j.contains("httpClientQueueDepth")) config.httpClientQueueDepth = j["httpClientQueueDepth"];
+        if (j.contains("httpClientTimeoutMs")) config.httpClientTimeoutMs = j["httpClientTimeoutMs"];
 
         if (j.contains("defaultDecoderHWAccel"))
             config.defaultDecoderHWAccel = stringToHWAccelType(j["defaultDecoderHWAccel"]);
@@ -132,7 +344,19 @@ namespace ffmpeg_stream {
 
         j["monitorInterval"] = monitorInterval;
         j["threadPoolSize"] = threadPoolSize;
+        j["ioThreadPoolSize"] = ioThreadPoolSize;
+        j["maxConcurrentReconnects"] = maxConcurrentReconnects;
         j["preloadLibraries"] = preloadLibraries;
+        j["streamInfoCacheFile"] = streamInfoCacheFile;
+        j["gopCacheTotalBytes"] = gopCacheTotalBytes;
+        j["recordDiskQuotaBytes"] = recordDiskQuotaBytes;
+
+        j["httpServerEnabled"] = httpServerEnabled;
+        j["httpServerBindAddress"] = httpServerBindAddress;
+        j["httpServerPort"] = httpServerPort;
+        j["httpMaxClients"] = httpMaxClients;
+        j["httpClientQueueDepth"] = httpClientQueueDepth;
+        j["httpClientTimeoutMs"] = httpClientTimeoutMs;
 
         j["defaultDecoderHWAccel"] = hwAccelTypeToString(defaultDecoderHWAccel);
         j["defaultEncoderHWAccel"] = hwAccelTypeToString(defaultEncoderHWAccel);
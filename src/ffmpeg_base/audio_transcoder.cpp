@@ -0,0 +1,399 @@
+/**
+ * @file audio_transcoder.cpp
+ * @brief 音频转码器实现
+ */
+
+#include "ffmpeg_base/audio_transcoder.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 编码器不限制帧长时每帧的样本数
+        constexpr int kDefaultFrameSize = 1024;
+
+        // 输入时间戳与累计样本数的偏差超过该值(且超过一帧)时重新对齐
+        constexpr int64_t kMaxDriftMs = 100;
+
+        // 不超过该长度的输入空洞用静音填补，更长的直接跳到新时间戳
+        constexpr int64_t kMaxSilencePadMs = 1000;
+
+        // 从编码器支持的采样率中选取，优先保持输入采样率
+        int selectSampleRate(const AVCodec* encoder, int inputRate) {
+            if (!encoder->supported_samplerates) {
+                return inputRate;
+            }
+            int best = 0;
+            for (const int* rate = encoder->supported_samplerates; *rate; rate++) {
+                if (*rate == inputRate) {
+                    return inputRate;
+                }
+                if (best == 0 || std::abs(*rate - inputRate) < std::abs(best - inputRate)) {
+                    best = *rate;
+                }
+            }
+            return best;
+        }
+    }
+
+    AudioTranscoder::AudioTranscoder()
+            : decoderContext(nullptr), encoderContext(nullptr), resampler(nullptr), fifo(nullptr),
+              decodedFrame(av_frame_alloc()), convertedFrame(av_frame_alloc()),
+              encodeFrameBuffer(av_frame_alloc()), encodedPacket(av_packet_alloc()),
+              inputTimeBase{0, 1}, nextPts(AV_NOPTS_VALUE) {
+    }
+
+    AudioTranscoder::~AudioTranscoder() {
+        cleanup();
+        av_frame_free(&decodedFrame);
+        av_frame_free(&convertedFrame);
+        av_frame_free(&encodeFrameBuffer);
+        av_packet_free(&encodedPacket);
+    }
+
+    bool AudioTranscoder::init(const AVCodecParameters* inputParams, AVRational timeBase,
+                               AVCodecID codecId, int bitrate, bool globalHeader) {
+        cleanup();
+        inputTimeBase = timeBase;
+
+        // 创建解码器
+        const AVCodec* decoder = avcodec_find_decoder(inputParams->codec_id);
+        if (!decoder) {
+            Logger::error("Audio decoder not found for codec id %d", inputParams->codec_id);
+            return false;
+        }
+
+        decoderContext = avcodec_alloc_context3(decoder);
+        if (!decoderContext) {
+            Logger::error("Failed to allocate audio decoder context");
+            return false;
+        }
+
+        int ret = avcodec_parameters_to_context(decoderContext, inputParams);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to copy audio decoder parameters", ret);
+            cleanup();
+            return false;
+        }
+        decoderContext->pkt_timebase = inputTimeBase;
+
+        ret = avcodec_open2(decoderContext, decoder, nullptr);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to open audio decoder", ret);
+            cleanup();
+            return false;
+        }
+
+        if (decoderContext->channel_layout == 0) {
+            decoderContext->channel_layout = av_get_default_channel_layout(decoderContext->channels);
+        }
+
+        // 创建编码器
+        const AVCodec* encoder = avcodec_find_encoder(codecId);
+        if (!encoder) {
+            Logger::error("Audio encoder not found for codec id %d", codecId);
+            cleanup();
+            return false;
+        }
+
+        encoderContext = avcodec_alloc_context3(encoder);
+        if (!encoderContext) {
+            Logger::error("Failed to allocate audio encoder context");
+            cleanup();
+            return false;
+        }
+
+        encoderContext->sample_rate = selectSampleRate(encoder, decoderContext->sample_rate);
+        encoderContext->channel_layout = decoderContext->channel_layout;
+        encoderContext->channels = decoderContext->channels;
+        encoderContext->sample_fmt = encoder->sample_fmts ? encoder->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+        encoderContext->bit_rate = bitrate;
+        encoderContext->time_base = AVRational{1, encoderContext->sample_rate};
+        if (globalHeader) {
+            encoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
+        ret = avcodec_open2(encoderContext, encoder, nullptr);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to open audio encoder", ret);
+            cleanup();
+            return false;
+        }
+
+        // 创建重采样器，只做格式转换时不会引入延迟
+        resampler = swr_alloc_set_opts(nullptr,
+                                       encoderContext->channel_layout, encoderContext->sample_fmt,
+                                       encoderContext->sample_rate,
+                                       decoderContext->channel_layout, decoderContext->sample_fmt,
+                                       decoderContext->sample_rate,
+                                       0, nullptr);
+        if (!resampler || (ret = swr_init(resampler)) < 0) {
+            utils::printFFmpegError("Failed to initialize audio resampler", resampler ? ret : AVERROR(ENOMEM));
+            cleanup();
+            return false;
+        }
+
+        fifo = av_audio_fifo_alloc(encoderContext->sample_fmt, encoderContext->channels, kDefaultFrameSize);
+        if (!fifo) {
+            Logger::error("Failed to allocate audio fifo");
+            cleanup();
+            return false;
+        }
+
+        Logger::info("Audio transcoder initialized: %s %dHz %d channels -> %s %dHz %d bps",
+                     decoder->name, decoderContext->sample_rate, decoderContext->channels,
+                     encoder->name, encoderContext->sample_rate, bitrate);
+        return true;
+    }
+
+    int AudioTranscoder::transcode(const AVPacket* packet, const PacketSink& sink) {
+        if (!decoderContext || !encoderContext) {
+            return AVERROR(EINVAL);
+        }
+
+        int ret = avcodec_send_packet(decoderContext, packet);
+        if (ret < 0) {
+            // 单个损坏的音频包不影响后续数据
+            if (ret != AVERROR(EAGAIN)) {
+                utils::printFFmpegError("Error sending audio packet to decoder", ret);
+            }
+            return 0;
+        }
+
+        ret = receiveDecodedFrames();
+        if (ret < 0) {
+            return ret;
+        }
+
+        return encodeFromFifo(sink, false);
+    }
+
+    int AudioTranscoder::flush(const PacketSink& sink) {
+        if (!decoderContext || !encoderContext) {
+            return 0;
+        }
+
+        // 冲刷解码器和重采样器中的剩余样本
+        avcodec_send_packet(decoderContext, nullptr);
+        int ret = receiveDecodedFrames();
+        if (ret < 0) {
+            return ret;
+        }
+
+        av_frame_unref(convertedFrame);
+        convertedFrame->format = encoderContext->sample_fmt;
+        convertedFrame->channel_layout = encoderContext->channel_layout;
+        convertedFrame->sample_rate = encoderContext->sample_rate;
+        if (swr_convert_frame(resampler, convertedFrame, nullptr) >= 0 && convertedFrame->nb_samples > 0) {
+            av_audio_fifo_write(fifo, reinterpret_cast<void**>(convertedFrame->data), convertedFrame->nb_samples);
+        }
+        av_frame_unref(convertedFrame);
+
+        int packetCount = encodeFromFifo(sink, true);
+        if (packetCount < 0) {
+            return packetCount;
+        }
+
+        ret = encodeFrame(nullptr, sink);
+        if (ret < 0) {
+            return ret;
+        }
+        return packetCount + ret;
+    }
+
+    int AudioTranscoder::receiveDecodedFrames() {
+        while (true) {
+            int ret = avcodec_receive_frame(decoderContext, decodedFrame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                return 0;
+            }
+            if (ret < 0) {
+                utils::printFFmpegError("Error decoding audio", ret);
+                return ret;
+            }
+
+            // 以第一帧的时间戳为起点，之后按样本数累加，保证输出时间戳连续；
+            // 输入出现空洞(丢包、解码器丢弃损坏包)时按输入时间戳重新对齐，避免音频逐渐超前于视频
+            if (decodedFrame->pts != AV_NOPTS_VALUE) {
+                int64_t framePts = av_rescale_q(decodedFrame->pts, inputTimeBase, encoderContext->time_base);
+                if (nextPts == AV_NOPTS_VALUE) {
+                    nextPts = framePts;
+                } else {
+                    ret = alignToInput(framePts);
+                    if (ret < 0) {
+                        av_frame_unref(decodedFrame);
+                        return ret;
+                    }
+                }
+            }
+
+            if (decodedFrame->channel_layout == 0) {
+                decodedFrame->channel_layout = decoderContext->channel_layout;
+            }
+
+            // 重采样到编码器格式，输出帧由swr_convert_frame分配
+            convertedFrame->format = encoderContext->sample_fmt;
+            convertedFrame->channel_layout = encoderContext->channel_layout;
+            convertedFrame->sample_rate = encoderContext->sample_rate;
+            ret = swr_convert_frame(resampler, convertedFrame, decodedFrame);
+            av_frame_unref(decodedFrame);
+            if (ret < 0) {
+                utils::printFFmpegError("Error resampling audio", ret);
+                av_frame_unref(convertedFrame);
+                return ret;
+            }
+
+            if (convertedFrame->nb_samples > 0 &&
+                av_audio_fifo_write(fifo, reinterpret_cast<void**>(convertedFrame->data),
+                                    convertedFrame->nb_samples) < convertedFrame->nb_samples) {
+                Logger::error("Failed to write samples to audio fifo");
+                av_frame_unref(convertedFrame);
+                return AVERROR(ENOMEM);
+            }
+            av_frame_unref(convertedFrame);
+        }
+    }
+
+    int AudioTranscoder::alignToInput(int64_t framePts) {
+        // 本帧第一个样本按累计样本数推算出的时间戳，包括FIFO和重采样器中尚未编码的样本
+        int64_t pending = av_audio_fifo_size(fifo) + swr_get_delay(resampler, encoderContext->sample_rate);
+        int64_t expectedPts = nextPts + pending;
+        int64_t drift = framePts - expectedPts;
+
+        int frameSize = encoderContext->frame_size > 0 ? encoderContext->frame_size : kDefaultFrameSize;
+        int64_t threshold = std::max<int64_t>(frameSize, encoderContext->sample_rate * kMaxDriftMs / 1000);
+        if (std::llabs(drift) <= threshold) {
+            return 0;
+        }
+
+        if (drift > 0 && drift <= encoderContext->sample_rate * kMaxSilencePadMs / 1000) {
+            // 用静音补齐空洞，FIFO中的样本和本帧都保持原有时间戳
+            av_frame_unref(convertedFrame);
+            convertedFrame->nb_samples = static_cast<int>(drift);
+            convertedFrame->format = encoderContext->sample_fmt;
+            convertedFrame->channel_layout = encoderContext->channel_layout;
+            convertedFrame->sample_rate = encoderContext->sample_rate;
+            int ret = av_frame_get_buffer(convertedFrame, 0);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to allocate silence frame", ret);
+                return ret;
+            }
+            av_samples_set_silence(convertedFrame->data, 0, convertedFrame->nb_samples,
+                                   encoderContext->channels, encoderContext->sample_fmt);
+            ret = av_audio_fifo_write(fifo, reinterpret_cast<void**>(convertedFrame->data),
+                                      convertedFrame->nb_samples);
+            av_frame_unref(convertedFrame);
+            if (ret < drift) {
+                Logger::error("Failed to write silence to audio fifo");
+                return AVERROR(ENOMEM);
+            }
+            Logger::debug("Audio gap of %lld samples padded with silence", static_cast<long long>(drift));
+            return 0;
+        }
+
+        // 空洞过长或输入时间戳回退，直接让累计时间戳跟随输入
+        nextPts = framePts - pending;
+        Logger::warning("Audio timestamps re-anchored after a drift of %lld samples", static_cast<long long>(drift));
+        return 0;
+    }
+
+    int AudioTranscoder::encodeFromFifo(const PacketSink& sink, bool final) {
+        int frameSize = encoderContext->frame_size > 0 ? encoderContext->frame_size : kDefaultFrameSize;
+        int packetCount = 0;
+
+        while (av_audio_fifo_size(fifo) >= frameSize || (final && av_audio_fifo_size(fifo) > 0)) {
+            int samples = std::min(av_audio_fifo_size(fifo), frameSize);
+
+            // 编码器可能持有上一帧的引用，每次分配新的缓冲
+            av_frame_unref(encodeFrameBuffer);
+            encodeFrameBuffer->nb_samples = samples;
+            encodeFrameBuffer->format = encoderContext->sample_fmt;
+            encodeFrameBuffer->channel_layout = encoderContext->channel_layout;
+            encodeFrameBuffer->sample_rate = encoderContext->sample_rate;
+            int ret = av_frame_get_buffer(encodeFrameBuffer, 0);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to allocate audio frame", ret);
+                return ret;
+            }
+
+            av_audio_fifo_read(fifo, reinterpret_cast<void**>(encodeFrameBuffer->data), samples);
+            encodeFrameBuffer->pts = nextPts == AV_NOPTS_VALUE ? 0 : nextPts;
+            nextPts = encodeFrameBuffer->pts + samples;
+
+            ret = encodeFrame(encodeFrameBuffer, sink);
+            av_frame_unref(encodeFrameBuffer);
+            if (ret < 0) {
+                return ret;
+            }
+            packetCount += ret;
+        }
+
+        return packetCount;
+    }
+
+    int AudioTranscoder::encodeFrame(AVFrame* frame, const PacketSink& sink) {
+        int ret = avcodec_send_frame(encoderContext, frame);
+        if (ret < 0 && !(frame == nullptr && ret == AVERROR_EOF)) {
+            utils::printFFmpegError("Error sending frame to audio encoder", ret);
+            return ret;
+        }
+
+        int packetCount = 0;
+        while (true) {
+            ret = avcodec_receive_packet(encoderContext, encodedPacket);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                break;
+            }
+            if (ret < 0) {
+                utils::printFFmpegError("Error receiving packet from audio encoder", ret);
+                return ret;
+            }
+
+            bool accepted = !sink || sink(encodedPacket);
+            av_packet_unref(encodedPacket);
+            if (!accepted) {
+                return AVERROR_EXIT;
+            }
+            packetCount++;
+        }
+
+        return packetCount;
+    }
+
+    void AudioTranscoder::cleanup() {
+        if (decoderContext) {
+            avcodec_free_context(&decoderContext);
+            decoderContext = nullptr;
+        }
+
+        if (encoderContext) {
+            avcodec_free_context(&encoderContext);
+            encoderContext = nullptr;
+        }
+
+        if (resampler) {
+            swr_free(&resampler);
+            resampler = nullptr;
+        }
+
+        if (fifo) {
+            av_audio_fifo_free(fifo);
+            fifo = nullptr;
+        }
+
+        nextPts = AV_NOPTS_VALUE;
+    }
+
+    AVCodecContext* AudioTranscoder::getCodecContext() {
+        return encoderContext;
+    }
+
+} // namespace ffmpeg_stream
@@ -6,14 +6,18 @@
 #include "ffmpeg_base/decoder.h"
 #include "logger/logger.h"
 #include "common/utils.h"
+#include <algorithm>
 
 namespace ffmpeg_stream {
 
-    HWDecoder::HWDecoder() : codecContext(nullptr), hwDeviceContext(nullptr), hwPixFmt(AV_PIX_FMT_NONE) {
+    HWDecoder::HWDecoder() : codecContext(nullptr), hwDeviceContext(nullptr), hwPixFmt(AV_PIX_FMT_NONE), lowres(0),
+                             decodedFrame(av_frame_alloc()), transferFrame(av_frame_alloc()) {
     }
 
     HWDecoder::~HWDecoder() {
         cleanup();
+        av_frame_free(&decodedFrame);
+        av_frame_free(&transferFrame);
     }
 
     bool HWDecoder::init(AVCodecParameters* codecParams, HWAccelType hwType) {
@@ -110,6 +114,9 @@ namespace ffmpeg_stream {
             return false;
         }
 
+        // 低分辨率解码，输出帧的宽高按级别减半
+        codecContext->lowres = std::min(lowres, static_cast<int>(decoder->max_lowres));
+
         if ((err = avcodec_open2(codecContext, decoder, nullptr)) < 0) {
             utils::printFFmpegError("Failed to open codec", err);
             return false;
@@ -121,41 +128,112 @@ namespace ffmpeg_stream {
         return true;
     }
 
-    AVFrame* HWDecoder::decode(AVPacket* packet) {
-        int ret = avcodec_send_packet(codecContext, packet);
-        if (ret < 0) {
-            if (ret != AVERROR(EAGAIN)) {
-                utils::printFFmpegError("Error sending packet for decoding", ret);
-            }
-            return nullptr;
+    void HWDecoder::setLowres(int level) {
+        lowres = std::max(level, 0);
+    }
+
+    int HWDecoder::getMaxLowres(AVCodecID codecId) {
+        const AVCodec* decoder = avcodec_find_decoder(codecId);
+        return decoder ? decoder->max_lowres : 0;
+    }
+
+    int HWDecoder::sendPacket(const AVPacket* packet) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
+        }
+        return avcodec_send_packet(codecContext, packet);
+    }
+
+    int HWDecoder::receiveFrame(AVFrame* frame) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
         }
 
-        AVFrame* frame = av_frame_alloc();
-        ret = avcodec_receive_frame(codecContext, frame);
+        int ret = avcodec_receive_frame(codecContext, frame);
         if (ret < 0) {
-            av_frame_free(&frame);
-            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
-                utils::printFFmpegError("Error receiving frame", ret);
-            }
-            return nullptr;
+            return ret;
         }
 
         // 如果是硬件帧，需要将其转换为软件帧
         if (frame->format == hwPixFmt) {
-            AVFrame* swFrame = av_frame_alloc();
-            ret = av_hwframe_transfer_data(swFrame, frame, 0);
+            ret = av_hwframe_transfer_data(transferFrame, frame, 0);
             if (ret < 0) {
                 utils::printFFmpegError("Error transferring data from GPU to CPU", ret);
-                av_frame_free(&swFrame);
-                av_frame_free(&frame);
-                return nullptr;
+                av_frame_unref(frame);
+                return ret;
+            }
+            av_frame_copy_props(transferFrame, frame);
+            av_frame_unref(frame);
+            av_frame_move_ref(frame, transferFrame);
+        }
+
+        return 0;
+    }
+
+    int HWDecoder::decode(AVPacket* packet, const FrameSink& sink) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
+        }
+
+        int frameCount = 0;
+        int ret = sendPacket(packet);
+
+        // 解码器输出队列已满时先取出帧，再重新发送同一个包
+        while (ret == AVERROR(EAGAIN)) {
+            int received = receiveFrames(sink);
+            if (received < 0) {
+                return received;
+            }
+            if (received == 0) {
+                // 无帧可取却仍拒绝输入，说明解码器状态异常
+                Logger::error("Decoder refused packet but produced no frames");
+                return AVERROR(EAGAIN);
+            }
+            frameCount += received;
+            ret = sendPacket(packet);
+        }
+
+        if (ret < 0 && ret != AVERROR_EOF) {
+            utils::printFFmpegError("Error sending packet for decoding", ret);
+            return ret;
+        }
+
+        int received = receiveFrames(sink);
+        if (received < 0) {
+            return received;
+        }
+        frameCount += received;
+
+        // 冲刷完成后重置解码器，使其可以继续接收新的包
+        if (!packet) {
+            avcodec_flush_buffers(codecContext);
+        }
+
+        return frameCount;
+    }
+
+    int HWDecoder::receiveFrames(const FrameSink& sink) {
+        int frameCount = 0;
+
+        while (true) {
+            int ret = receiveFrame(decodedFrame);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+                break;
             }
-            av_frame_copy_props(swFrame, frame);
-            av_frame_free(&frame);
-            return swFrame;
+            if (ret < 0) {
+                utils::printFFmpegError("Error receiving frame", ret);
+                return ret;
+            }
+
+            if (sink) {
+                sink(decodedFrame);
+            }
+            frameCount++;
+
+            av_frame_unref(decodedFrame);
         }
 
-        return frame;
+        return frameCount;
     }
 
     void HWDecoder::flush() {
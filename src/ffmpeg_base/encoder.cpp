@@ -9,11 +9,25 @@
 
 namespace ffmpeg_stream {
 
-    HWEncoder::HWEncoder() : codecContext(nullptr), hwDeviceContext(nullptr), hwPixFmt(AV_PIX_FMT_NONE) {
+    AVCodecID codecNameToAVCodecID(const std::string& name) {
+        std::string lower = utils::toLower(name);
+        if (lower == "h264" || lower == "avc") return AV_CODEC_ID_H264;
+        if (lower == "h265" || lower == "hevc") return AV_CODEC_ID_HEVC;
+        if (lower == "vp9") return AV_CODEC_ID_VP9;
+        return AV_CODEC_ID_NONE;
+    }
+
+    HWEncoder::HWEncoder() : codecContext(nullptr), hwDeviceContext(nullptr), hwPixFmt(AV_PIX_FMT_NONE),
+                             globalHeader(false), encodedPacket(av_packet_alloc()) {
+    }
+
+    void HWEncoder::setGlobalHeader(bool enabled) {
+        globalHeader = enabled;
     }
 
     HWEncoder::~HWEncoder() {
         cleanup();
+        av_packet_free(&encodedPacket);
     }
 
     bool HWEncoder::init(const StreamConfig& config) {
@@ -115,6 +129,10 @@ namespace ffmpeg_stream {
         // 设置硬件设备上下文
         codecContext->hw_device_ctx = av_buffer_ref(hwDeviceContext);
 
+        if (globalHeader) {
+            codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
         // 打开编码器
         AVDictionary* options = nullptr;
         // 设置低延迟选项
@@ -179,6 +197,10 @@ namespace ffmpeg_stream {
             codecContext->profile = FF_PROFILE_H264_MAIN;
         }
 
+        if (globalHeader) {
+            codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+
         // 打开编码器
         AVDictionary* options = nullptr;
         // 设置低延迟选项
@@ -199,50 +221,92 @@ namespace ffmpeg_stream {
         return true;
     }
 
-    AVPacket* HWEncoder::encode(AVFrame* frame) {
-        int ret = avcodec_send_frame(codecContext, frame);
+    int HWEncoder::sendFrame(const AVFrame* frame) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
+        }
+        return avcodec_send_frame(codecContext, frame);
+    }
+
+    int HWEncoder::receivePacket(AVPacket* packet) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
+        }
+        return avcodec_receive_packet(codecContext, packet);
+    }
+
+    int HWEncoder::encode(AVFrame* frame, const PacketSink& sink) {
+        if (!codecContext) {
+            return AVERROR(EINVAL);
+        }
+
+        int packetCount = 0;
+        int ret = sendFrame(frame);
+
+        // 编码器输出队列已满时先取出包，再重新发送同一帧
+        while (ret == AVERROR(EAGAIN)) {
+            int received = receivePackets(sink);
+            if (received < 0) {
+                return received;
+            }
+            if (received == 0) {
+                Logger::error("Encoder refused frame but produced no packets");
+                return AVERROR(EAGAIN);
+            }
+            packetCount += received;
+            ret = sendFrame(frame);
+        }
+
         if (ret < 0) {
             utils::printFFmpegError("Error sending frame for encoding", ret);
-            return nullptr;
+            return ret;
         }
 
-        AVPacket* packet = av_packet_alloc();
-        ret = avcodec_receive_packet(codecContext, packet);
-        if (ret < 0) {
-            av_packet_free(&packet);
-            if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
-                utils::printFFmpegError("Error receiving packet from encoder", ret);
-            }
-            return nullptr;
+        int received = receivePackets(sink);
+        if (received < 0) {
+            return received;
         }
 
-        return packet;
+        return packetCount + received;
     }
 
-    void HWEncoder::flush() {
+    int HWEncoder::flush(const PacketSink& sink) {
+        if (!codecContext) {
+            return 0;
+        }
+
         // 刷新编码器缓冲区
-        int ret = avcodec_send_frame(codecContext, nullptr);
-        if (ret < 0) {
+        int ret = sendFrame(nullptr);
+        if (ret < 0 && ret != AVERROR_EOF) {
             utils::printFFmpegError("Error flushing encoder", ret);
-            return;
+            return ret;
         }
 
-        AVPacket* packet = av_packet_alloc();
-        while (ret >= 0) {
-            ret = avcodec_receive_packet(codecContext, packet);
+        return receivePackets(sink);
+    }
+
+    int HWEncoder::receivePackets(const PacketSink& sink) {
+        int packetCount = 0;
+
+        while (true) {
+            int ret = receivePacket(encodedPacket);
             if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
                 break;
-            } else if (ret < 0) {
-                utils::printFFmpegError("Error receiving packet while flushing", ret);
-                break;
+            }
+            if (ret < 0) {
+                utils::printFFmpegError("Error receiving packet from encoder", ret);
+                return ret;
             }
 
-            // 处理刷出的包
-            // ...
-
-            av_packet_unref(packet);
+            bool accepted = !sink || sink(encodedPacket);
+            av_packet_unref(encodedPacket);
+            if (!accepted) {
+                return AVERROR_EXIT;
+            }
+            packetCount++;
         }
-        av_packet_free(&packet);
+
+        return packetCount;
     }
 
     void HWEncoder::cleanup() {
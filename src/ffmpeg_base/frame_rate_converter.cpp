@@ -0,0 +1,98 @@
+/**
+ * @file frame_rate_converter.cpp
+ * @brief 编码前的帧率转换实现
+ */
+
+#include "ffmpeg_base/frame_rate_converter.h"
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+}
+
+namespace ffmpeg_stream {
+
+    FrameRateConverter::FrameRateConverter()
+            : inputTimeBase(AVRational{1, 1}), outputTimeBase(AVRational{1, 1}), slotsPerSecond(1),
+              nextSlot(AV_NOPTS_VALUE), slotOffset(0), lastFrame(av_frame_alloc()) {
+    }
+
+    FrameRateConverter::~FrameRateConverter() {
+        av_frame_free(&lastFrame);
+    }
+
+    void FrameRateConverter::setRate(AVRational inputTimeBase, AVRational outputTimeBase) {
+        this->inputTimeBase = inputTimeBase;
+        this->outputTimeBase = outputTimeBase;
+        slotsPerSecond = av_rescale_q(1, AVRational{1, 1}, outputTimeBase);
+        if (slotsPerSecond < 1) {
+            slotsPerSecond = 1;
+        }
+        reset();
+    }
+
+    bool FrameRateConverter::next(int64_t pts, int64_t& outputPts, int& repeat) {
+        repeat = 0;
+
+        int64_t slot;
+        if (pts == AV_NOPTS_VALUE) {
+            slot = nextSlot == AV_NOPTS_VALUE ? 0 : nextSlot;
+        } else {
+            // 取最近的时隙，与fps滤镜的默认取整一致
+            slot = av_rescale_q_rnd(pts, inputTimeBase, outputTimeBase, AV_ROUND_NEAR_INF) + slotOffset;
+        }
+
+        if (nextSlot == AV_NOPTS_VALUE) {
+            outputPts = slot;
+            nextSlot = slot + 1;
+            return true;
+        }
+
+        // 时间戳大幅回退(输入时间戳重置)时从下一个时隙继续
+        if (slot < nextSlot - slotsPerSecond) {
+            slotOffset += nextSlot - slot;
+            slot = nextSlot;
+        }
+
+        // 该时隙已有帧，输入帧率高于目标时在这里丢弃
+        if (slot < nextSlot) {
+            return false;
+        }
+
+        // 输入帧率低于目标或有短暂间隙时重复上一帧，更长的间隙直接跳过
+        int64_t gap = slot - nextSlot;
+        if (gap > 0 && gap <= slotsPerSecond && lastFrame->buf[0]) {
+            repeat = static_cast<int>(gap);
+        }
+
+        outputPts = slot;
+        nextSlot = slot + 1;
+        return true;
+    }
+
+    void FrameRateConverter::keep(const AVFrame* frame) {
+        av_frame_unref(lastFrame);
+        if (av_frame_ref(lastFrame, frame) < 0) {
+            av_frame_unref(lastFrame);
+        }
+    }
+
+    bool FrameRateConverter::repeatLast(AVFrame* dst, int64_t outputPts) const {
+        if (!lastFrame->buf[0] || av_frame_ref(dst, lastFrame) < 0) {
+            return false;
+        }
+
+        // 重复的帧不应让编码器强制插入关键帧
+        dst->pts = outputPts;
+        dst->pict_type = AV_PICTURE_TYPE_NONE;
+        dst->key_frame = 0;
+        return true;
+    }
+
+    void FrameRateConverter::reset() {
+        nextSlot = AV_NOPTS_VALUE;
+        slotOffset = 0;
+        av_frame_unref(lastFrame);
+    }
+
+} // namespace ffmpeg_stream
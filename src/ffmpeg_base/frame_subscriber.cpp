@@ -0,0 +1,166 @@
+/**
+ * @file frame_subscriber.cpp
+ * @brief 解码帧订阅者实现
+ */
+
+#include "ffmpeg_base/frame_subscriber.h"
+#include "logger/logger.h"
+#include <exception>
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 生产者运行在调度器工作线程上时，BLOCK策略的最长等待时间
+        constexpr std::chrono::milliseconds kMaxWorkerBlock{50};
+    }
+
+    FrameHandle makeFrameHandle(AVFrame* frame) {
+        AVFrame* handleFrame = av_frame_alloc();
+        if (!handleFrame) {
+            return nullptr;
+        }
+        av_frame_move_ref(handleFrame, frame);
+        return FrameHandle(handleFrame, [](const AVFrame* f) {
+            AVFrame* owned = const_cast<AVFrame*>(f);
+            av_frame_free(&owned);
+        });
+    }
+
+    FrameSubscriber::FrameSubscriber(const std::string& name, int streamId, FrameHandler handler,
+                                     const FrameSubscriberOptions& options)
+            : name_(name),
+              streamId_(streamId),
+              handler_(std::move(handler)),
+              capacity_(options.queueDepth > 0 ? options.queueDepth : 1),
+              policy_(options.policy),
+              stopped_(true),
+              droppedCount_(0),
+              deliveredCount_(0) {
+        dispatchStage_ = std::make_unique<StageRunner>(
+                name_, std::chrono::microseconds(100000),
+                options.executor ? options.executor : &getDispatchScheduler());
+    }
+
+    FrameSubscriber::~FrameSubscriber() {
+        stop();
+    }
+
+    void FrameSubscriber::start() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!stopped_) {
+                return;
+            }
+            stopped_ = false;
+        }
+
+        // 回调中释放最后一个引用时，订阅者要活到本次单步结束
+        std::weak_ptr<FrameSubscriber> weakSelf = weak_from_this();
+        dispatchStage_->start([weakSelf]() {
+            auto self = weakSelf.lock();
+            return self && self->dispatchStep();
+        });
+    }
+
+    void FrameSubscriber::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+            queue_.clear();
+        }
+        spaceCondition_.notify_all();
+        dispatchStage_->stop();
+    }
+
+    bool FrameSubscriber::push(const FrameHandle& frame) {
+        if (!frame) {
+            return false;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (stopped_) {
+                return false;
+            }
+
+            if (queue_.size() >= capacity_) {
+                switch (policy_) {
+                    case QueueOverflowPolicy::DROP_OLDEST:
+                        queue_.pop_front();
+                        droppedCount_++;
+                        break;
+
+                    case QueueOverflowPolicy::BLOCK: {
+                        auto hasSpace = [this]() { return stopped_ || queue_.size() < capacity_; };
+                        if (Scheduler::isWorkerThread()) {
+                            spaceCondition_.wait_for(lock, kMaxWorkerBlock, hasSpace);
+                        } else {
+                            spaceCondition_.wait(lock, hasSpace);
+                        }
+                        if (stopped_) {
+                            return false;
+                        }
+                        if (queue_.size() >= capacity_) {
+                            droppedCount_++;
+                            return false;
+                        }
+                        break;
+                    }
+
+                    default:
+                        droppedCount_++;
+                        return false;
+                }
+            }
+
+            queue_.push_back(frame);
+        }
+
+        dispatchStage_->wake();
+        return true;
+    }
+
+    size_t FrameSubscriber::getBacklog() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    uint64_t FrameSubscriber::getDroppedCount() const {
+        return droppedCount_;
+    }
+
+    uint64_t FrameSubscriber::getDeliveredCount() const {
+        return deliveredCount_;
+    }
+
+    Scheduler& FrameSubscriber::getDispatchScheduler() {
+        // 与流水线调度器分开，回调阻塞不影响拉流和编码
+        static Scheduler instance;
+        return instance;
+    }
+
+    bool FrameSubscriber::dispatchStep() {
+        FrameHandle frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopped_ || queue_.empty()) {
+                return false;
+            }
+            frame = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        spaceCondition_.notify_one();
+
+        // 回调是用户代码，异常不能逃逸到调度器工作线程
+        try {
+            handler_(streamId_, frame);
+        } catch (const std::exception& e) {
+            Logger::error("Frame subscriber %s callback threw: %s", name_.c_str(), e.what());
+        } catch (...) {
+            Logger::error("Frame subscriber %s callback threw an unknown exception", name_.c_str());
+        }
+        deliveredCount_++;
+        return true;
+    }
+
+} // namespace ffmpeg_stream
@@ -0,0 +1,142 @@
+/**
+ * @file gop_cache.cpp
+ * @brief 以关键帧对齐的包缓存实现
+ */
+
+#include "ffmpeg_base/gop_cache.h"
+
+namespace ffmpeg_stream {
+
+    std::atomic<int64_t> GopCache::globalBytes_(0);
+    std::atomic<int64_t> GopCache::globalLimit_(0);
+
+    GopCache::GopCache()
+            : durationUs_(0), maxBytes_(0), lastVideoUs_(AV_NOPTS_VALUE), bytes_(0), durationMs_(0) {
+    }
+
+    GopCache::~GopCache() {
+        clear();
+    }
+
+    void GopCache::configure(int durationMs, int64_t maxBytes) {
+        durationUs_ = durationMs > 0 ? static_cast<int64_t>(durationMs) * 1000 : 0;
+        maxBytes_ = maxBytes > 0 ? maxBytes : 0;
+        if (durationUs_ == 0) {
+            clear();
+        }
+    }
+
+    void GopCache::push(const AVPacket* packet, bool video, int64_t timeUs) {
+        if (durationUs_ == 0) {
+            return;
+        }
+
+        bool keyframe = video && (packet->flags & AV_PKT_FLAG_KEY);
+
+        // 缓存总是从关键帧开始
+        if (entries_.empty() && !keyframe) {
+            return;
+        }
+
+        AVPacket* ref = av_packet_alloc();
+        if (!ref || av_packet_ref(ref, packet) < 0) {
+            av_packet_free(&ref);
+            return;
+        }
+
+        if (video && timeUs != AV_NOPTS_VALUE) {
+            lastVideoUs_ = timeUs;
+        }
+
+        if (keyframe) {
+            gopSizes_.push_back(0);
+            gopStartUs_.push_back(lastVideoUs_);
+        }
+        entries_.push_back(Entry{ref, video, timeUs});
+        gopSizes_.back()++;
+        bytes_ += ref->size;
+        globalBytes_ += ref->size;
+
+        // 第二个GOP起已覆盖要求的时长时，淘汰第一个GOP
+        while (gopStartUs_.size() > 1 && lastVideoUs_ != AV_NOPTS_VALUE &&
+               gopStartUs_[1] != AV_NOPTS_VALUE && lastVideoUs_ - gopStartUs_[1] >= durationUs_) {
+            dropFirstGop();
+        }
+
+        // 超过内存上限时淘汰最早的GOP，单个GOP仍超限时清空，等下一个关键帧重新开始
+        while (overBudget() && dropFirstGop()) {
+        }
+        if (overBudget()) {
+            clear();
+            return;
+        }
+
+        int64_t startUs = gopStartUs_.front();
+        durationMs_ = startUs != AV_NOPTS_VALUE && lastVideoUs_ != AV_NOPTS_VALUE
+                      ? (lastVideoUs_ - startUs) / 1000 : 0;
+    }
+
+    void GopCache::forEach(bool fromLastKeyframe, const PacketVisitor& visitor) const {
+        if (entries_.empty()) {
+            return;
+        }
+
+        size_t start = fromLastKeyframe ? entries_.size() - gopSizes_.back() : 0;
+        for (size_t i = start; i < entries_.size(); i++) {
+            visitor(entries_[i].packet, entries_[i].video);
+        }
+    }
+
+    void GopCache::clear() {
+        for (auto& entry : entries_) {
+            release(entry);
+        }
+        entries_.clear();
+        gopSizes_.clear();
+        gopStartUs_.clear();
+        lastVideoUs_ = AV_NOPTS_VALUE;
+        durationMs_ = 0;
+    }
+
+    int64_t GopCache::getDurationMs() const {
+        return durationMs_;
+    }
+
+    int64_t GopCache::getBytes() const {
+        return bytes_;
+    }
+
+    void GopCache::setGlobalLimit(int64_t maxBytes) {
+        globalLimit_ = maxBytes > 0 ? maxBytes : 0;
+    }
+
+    int64_t GopCache::getGlobalBytes() {
+        return globalBytes_;
+    }
+
+    bool GopCache::dropFirstGop() {
+        if (gopSizes_.size() <= 1) {
+            return false;
+        }
+
+        for (size_t i = 0; i < gopSizes_.front(); i++) {
+            release(entries_.front());
+            entries_.pop_front();
+        }
+        gopSizes_.pop_front();
+        gopStartUs_.pop_front();
+        return true;
+    }
+
+    bool GopCache::overBudget() const {
+        int64_t globalLimit = globalLimit_;
+        return (maxBytes_ > 0 && bytes_ > maxBytes_) || (globalLimit > 0 && globalBytes_ > globalLimit);
+    }
+
+    void GopCache::release(Entry& entry) {
+        bytes_ -= entry.packet->size;
+        globalBytes_ -= entry.packet->size;
+        av_packet_free(&entry.packet);
+    }
+
+} // namespace ffmpeg_stream
@@ -0,0 +1,717 @@
+/**
+ * @file http_stream_server.cpp
+ * @brief 内置HTTP-FLV/MPEG-TS分发服务器实现
+ */
+
+#include "ffmpeg_base/http_stream_server.h"
+#include "ffmpeg_base/stream_output.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+extern "C" {
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 请求头的长度上限
+        constexpr size_t kMaxRequestBytes = 8192;
+
+        // 发送缓冲区超过该大小时不再取包，让队列按丢弃策略处理
+        constexpr size_t kMaxOutputBytes = 2 * 1024 * 1024;
+
+        // 每步最多封装的包数，避免一个连接长时间占用工作线程
+        constexpr int kMaxPacketsPerStep = 32;
+
+        // 封装器的I/O缓冲区大小
+        constexpr int kIOBufferSize = 32 * 1024;
+
+        // 接受连接时的轮询间隔，也是回收已结束连接的间隔
+        constexpr int kAcceptPollMs = 200;
+
+        const SocketHandle kInvalidSocket = static_cast<SocketHandle>(-1);
+
+        // 套接字接口在Windows(Winsock2)和POSIX之间的差异
+#ifdef _WIN32
+        bool initSockets() {
+            // 进程内只初始化一次，退出时由静态对象清理
+            struct WinsockInit {
+                bool ok;
+                WinsockInit() {
+                    WSADATA data;
+                    ok = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+                }
+                ~WinsockInit() {
+                    if (ok) WSACleanup();
+                }
+            };
+            static WinsockInit init;
+            return init.ok;
+        }
+
+        int socketError() {
+            return WSAGetLastError();
+        }
+
+        bool wouldBlock(int error) {
+            return error == WSAEWOULDBLOCK || error == WSAEINTR;
+        }
+
+        std::string socketErrorString(int error) {
+            return "WSA error " + std::to_string(error);
+        }
+
+        void setNonBlocking(SocketHandle socket) {
+            u_long mode = 1;
+            ioctlsocket(static_cast<SOCKET>(socket), FIONBIO, &mode);
+        }
+
+        void closeSocket(SocketHandle socket) {
+            closesocket(static_cast<SOCKET>(socket));
+        }
+
+        long sendSocket(SocketHandle socket, const char* data, size_t size) {
+            return send(static_cast<SOCKET>(socket), data, static_cast<int>(size), 0);
+        }
+
+        long recvSocket(SocketHandle socket, char* data, size_t size) {
+            return recv(static_cast<SOCKET>(socket), data, static_cast<int>(size), 0);
+        }
+
+        // 等待套接字可读，返回值同poll
+        int waitReadable(SocketHandle socket, int timeoutMs) {
+            WSAPOLLFD pfd{};
+            pfd.fd = static_cast<SOCKET>(socket);
+            pfd.events = POLLRDNORM;
+            int ret = WSAPoll(&pfd, 1, timeoutMs);
+            return ret > 0 && (pfd.revents & POLLRDNORM) ? ret : (ret < 0 ? ret : 0);
+        }
+#else
+        bool initSockets() {
+            return true;
+        }
+
+        int socketError() {
+            return errno;
+        }
+
+        bool wouldBlock(int error) {
+            return error == EAGAIN || error == EWOULDBLOCK || error == EINTR;
+        }
+
+        std::string socketErrorString(int error) {
+            return strerror(error);
+        }
+
+        void setNonBlocking(SocketHandle socket) {
+            int flags = fcntl(socket, F_GETFL, 0);
+            fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+        }
+
+        void closeSocket(SocketHandle socket) {
+            ::close(socket);
+        }
+
+        long sendSocket(SocketHandle socket, const char* data, size_t size) {
+            return send(socket, data, size, MSG_NOSIGNAL);
+        }
+
+        long recvSocket(SocketHandle socket, char* data, size_t size) {
+            return recv(socket, data, size, 0);
+        }
+
+        // 等待套接字可读，返回值同poll
+        int waitReadable(SocketHandle socket, int timeoutMs) {
+            pollfd pfd{};
+            pfd.fd = socket;
+            pfd.events = POLLIN;
+            int ret = poll(&pfd, 1, timeoutMs);
+            return ret > 0 && (pfd.revents & POLLIN) ? ret : (ret < 0 ? ret : 0);
+        }
+#endif
+
+        // 包的时间戳，优先DTS
+        int64_t packetTime(const AVPacket* packet) {
+            return packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        }
+
+        const char* statusReason(int status) {
+            switch (status) {
+                case 400: return "Bad Request";
+                case 404: return "Not Found";
+                case 405: return "Method Not Allowed";
+                case 415: return "Unsupported Media Type";
+                case 503: return "Service Unavailable";
+                default: return "Internal Server Error";
+            }
+        }
+    }
+
+    HttpStreamClient::HttpStreamClient(SocketHandle socket, const std::string& peer, SourceResolver resolver,
+                                       const HttpServerOptions& options)
+            : socket_(socket),
+              peer_(peer),
+              resolver_(std::move(resolver)),
+              options_(options),
+              state_(State::READING_REQUEST),
+              chunked_(false),
+              videoTimeBase_{0, 1},
+              audioTimeBase_{0, 1},
+              formatContext_(nullptr),
+              audioStreamIndex_(-1),
+              videoPacket_(av_packet_alloc()),
+              audioPacket_(av_packet_alloc()),
+              videoPending_(false),
+              audioPending_(false),
+              startUs_(AV_NOPTS_VALUE),
+              outputOffset_(0),
+              lastSendUs_(av_gettime_relative()) {
+        // 读写都不阻塞工作线程
+        setNonBlocking(socket_);
+
+        // 无可发送数据时轮询套接字是否可写
+        clientStage_ = std::make_unique<StageRunner>("http-" + peer_, std::chrono::microseconds(20000));
+    }
+
+    HttpStreamClient::~HttpStreamClient() {
+        stop();
+        av_packet_free(&videoPacket_);
+        av_packet_free(&audioPacket_);
+    }
+
+    void HttpStreamClient::start() {
+        lastSendUs_ = av_gettime_relative();
+        clientStage_->start([this]() { return clientStep(); });
+    }
+
+    void HttpStreamClient::stop() {
+        clientStage_->stop();
+        state_ = State::FINISHED;
+
+        if (source_) {
+            if (videoSubscription_) source_->unsubscribe(videoSubscription_);
+            if (audioSubscription_) source_->unsubscribe(audioSubscription_);
+        }
+        videoSubscription_.reset();
+        audioSubscription_.reset();
+        source_.reset();
+
+        // 连接即将关闭，不再写尾部
+        if (formatContext_) {
+            if (formatContext_->pb) {
+                av_freep(&formatContext_->pb->buffer);
+                avio_context_free(&formatContext_->pb);
+            }
+            avformat_free_context(formatContext_);
+            formatContext_ = nullptr;
+        }
+        av_packet_unref(videoPacket_);
+        av_packet_unref(audioPacket_);
+        videoPending_ = false;
+        audioPending_ = false;
+
+        if (socket_ != kInvalidSocket) {
+            closeSocket(socket_);
+            socket_ = kInvalidSocket;
+        }
+    }
+
+    bool HttpStreamClient::isFinished() const {
+        return state_ == State::FINISHED;
+    }
+
+    bool HttpStreamClient::clientStep() {
+        if (state_ == State::READING_REQUEST) {
+            return readRequest();
+        }
+        if (state_ != State::STREAMING) {
+            return false;
+        }
+
+        bool progressed = flushOutput();
+        if (state_ == State::STREAMING && output_.size() - outputOffset_ < kMaxOutputBytes) {
+            progressed = muxPackets() || progressed;
+            progressed = flushOutput() || progressed;
+        }
+
+        // 慢速连接：发送缓冲区中的数据持续发不出去
+        if (state_ == State::STREAMING && outputOffset_ < output_.size() &&
+            av_gettime_relative() - lastSendUs_ > static_cast<int64_t>(options_.clientTimeoutMs) * 1000) {
+            finish("client too slow");
+        }
+        return progressed && state_ == State::STREAMING;
+    }
+
+    bool HttpStreamClient::readRequest() {
+        char buf[1024];
+        long n = recvSocket(socket_, buf, sizeof(buf));
+        if (n == 0) {
+            finish("closed before request");
+            return false;
+        }
+        if (n < 0) {
+            if (!wouldBlock(socketError())) {
+                finish("read error");
+            } else if (av_gettime_relative() - lastSendUs_ > static_cast<int64_t>(options_.clientTimeoutMs) * 1000) {
+                finish("request timeout");
+            }
+            return false;
+        }
+
+        request_.append(buf, static_cast<size_t>(n));
+        if (request_.find("\r\n\r\n") == std::string::npos) {
+            if (request_.size() > kMaxRequestBytes) {
+                sendError(400);
+            }
+            return true;
+        }
+
+        // 请求行：方法 路径 版本
+        std::vector<std::string> parts = utils::splitString(request_.substr(0, request_.find("\r\n")), ' ');
+        if (parts.size() < 3) {
+            sendError(400);
+            return false;
+        }
+        if (parts[0] != "GET") {
+            sendError(405);
+            return false;
+        }
+        chunked_ = parts[2] == "HTTP/1.1";
+
+        std::string path = parts[1].substr(0, parts[1].find('?'));
+        int status = startStreaming(path);
+        if (status != 200) {
+            sendError(status);
+            return false;
+        }
+        return true;
+    }
+
+    int HttpStreamClient::startStreaming(const std::string& path) {
+        // 路径为/live/<流ID>.flv或/live/<流ID>.ts
+        const std::string prefix = "/live/";
+        if (!utils::startsWith(path, prefix)) {
+            return 404;
+        }
+        std::string name = path.substr(prefix.size());
+        const char* format;
+        const char* contentType;
+        if (utils::endsWith(name, ".flv")) {
+            format = "flv";
+            contentType = "video/x-flv";
+        } else if (utils::endsWith(name, ".ts")) {
+            format = "mpegts";
+            contentType = "video/mp2t";
+        } else {
+            return 404;
+        }
+
+        std::string idString = name.substr(0, name.find('.'));
+        if (idString.empty() || !std::all_of(idString.begin(), idString.end(),
+                                             [](unsigned char c) { return std::isdigit(c); })) {
+            return 404;
+        }
+        int streamId = std::atoi(idString.c_str());
+
+        source_ = resolver_ ? resolver_(streamId) : nullptr;
+        if (!source_ || source_->isFailed() || !source_->getVideoStream()) {
+            source_.reset();
+            return 503;
+        }
+
+        // FLV只能可靠地承载H.264视频
+        AVStream* videoStream = source_->getVideoStream();
+        if (std::strcmp(format, "flv") == 0 && videoStream->codecpar->codec_id != AV_CODEC_ID_H264) {
+            return 415;
+        }
+
+        // 封装器写到发送缓冲区
+        avformat_alloc_output_context2(&formatContext_, nullptr, format, nullptr);
+        if (!formatContext_) {
+            return 500;
+        }
+        auto* ioBuffer = static_cast<unsigned char*>(av_malloc(kIOBufferSize));
+        formatContext_->pb = ioBuffer ? avio_alloc_context(ioBuffer, kIOBufferSize, 1, this, nullptr,
+                                                           &HttpStreamClient::writeCallback, nullptr)
+                                      : nullptr;
+        if (!formatContext_->pb) {
+            av_free(ioBuffer);
+            return 500;
+        }
+        formatContext_->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        AVStream* outStream = avformat_new_stream(formatContext_, nullptr);
+        if (!outStream || avcodec_parameters_copy(outStream->codecpar, videoStream->codecpar) < 0) {
+            return 500;
+        }
+        outStream->codecpar->codec_tag = 0;
+        outStream->time_base = videoStream->time_base;
+        videoTimeBase_ = videoStream->time_base;
+
+        // 音频直通，容器不能承载时只输出视频
+        AVStream* audioStream = source_->getAudioStream();
+        if (audioStream && StreamOutput::canCarryAudio(formatContext_->oformat, audioStream->codecpar->codec_id)) {
+            AVStream* outAudio = avformat_new_stream(formatContext_, nullptr);
+            if (outAudio && avcodec_parameters_copy(outAudio->codecpar, audioStream->codecpar) >= 0) {
+                outAudio->codecpar->codec_tag = 0;
+                outAudio->time_base = audioStream->time_base;
+                audioTimeBase_ = audioStream->time_base;
+                audioStreamIndex_ = outAudio->index;
+            }
+        }
+
+        // 从输入源缓存的最近一个关键帧开始，播放端立即出画面
+        videoSubscription_ = source_->subscribe(SourceDataType::PACKETS, options_.clientQueueDepth,
+                                                QueueOverflowPolicy::DROP_NEWEST,
+                                                [this]() { clientStage_->wake(); }, SourcePreroll::LAST_GOP);
+        if (!videoSubscription_) {
+            return 503;
+        }
+        if (audioStreamIndex_ >= 0) {
+            audioSubscription_ = source_->subscribe(SourceDataType::AUDIO_PACKETS, options_.clientQueueDepth,
+                                                    QueueOverflowPolicy::DROP_NEWEST,
+                                                    [this]() { clientStage_->wake(); }, SourcePreroll::LAST_GOP);
+        }
+
+        // 响应头之后是封装器的输出，长度未知
+        output_ = std::string("HTTP/1.1 200 OK\r\nContent-Type: ") + contentType + "\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Access-Control-Allow-Origin: *\r\n" +
+                  (chunked_ ? "Transfer-Encoding: chunked\r\n" : "") +
+                  "Connection: close\r\n\r\n";
+        outputOffset_ = 0;
+
+        AVDictionary* muxOptions = nullptr;
+        if (std::strcmp(format, "flv") == 0) {
+            av_dict_set(&muxOptions, "flvflags", "no_duration_filesize", 0);
+        }
+        int ret = avformat_write_header(formatContext_, &muxOptions);
+        av_dict_free(&muxOptions);
+        if (ret < 0) {
+            utils::printFFmpegError("HTTP client failed to write header", ret);
+            output_.clear();
+            return 500;
+        }
+        avio_flush(formatContext_->pb);
+
+        state_ = State::STREAMING;
+        Logger::info("HTTP client %s playing stream %d as %s", peer_.c_str(), streamId, format);
+        return 200;
+    }
+
+    bool HttpStreamClient::muxPackets() {
+        bool progressed = false;
+        for (int i = 0; i < kMaxPacketsPerStep && state_ == State::STREAMING; i++) {
+            if (!videoPending_ && videoSubscription_->packets->pop(videoPacket_)) {
+                videoPending_ = true;
+            }
+            if (audioSubscription_ && !audioPending_ && audioSubscription_->packets->pop(audioPacket_)) {
+                audioPending_ = true;
+            }
+
+            if (!videoPending_ && !audioPending_) {
+                // 输入结束或重连，播放端重新请求即可接上新的输入源
+                if (videoSubscription_->endError != 0) {
+                    finish("input ended");
+                }
+                break;
+            }
+
+            // 两路都有包时先写出时间戳较早的
+            bool video = videoPending_;
+            if (videoPending_ && audioPending_) {
+                int64_t videoTs = packetTime(videoPacket_);
+                int64_t audioTs = packetTime(audioPacket_);
+                video = videoTs == AV_NOPTS_VALUE || audioTs == AV_NOPTS_VALUE ||
+                        av_compare_ts(videoTs, videoTimeBase_, audioTs, audioTimeBase_) <= 0;
+            }
+
+            if (video) {
+                videoPending_ = false;
+                writePacket(videoPacket_, true);
+            } else {
+                audioPending_ = false;
+                writePacket(audioPacket_, false);
+            }
+            progressed = true;
+        }
+        return progressed;
+    }
+
+    bool HttpStreamClient::writePacket(AVPacket* packet, bool video) {
+        AVRational timeBase = video ? videoTimeBase_ : audioTimeBase_;
+        int64_t ts = packetTime(packet);
+        if (ts == AV_NOPTS_VALUE) {
+            av_packet_unref(packet);
+            return true;
+        }
+
+        // 从第一个视频关键帧开始，时间戳归零
+        if (startUs_ == AV_NOPTS_VALUE) {
+            if (!video || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(packet);
+                return true;
+            }
+            startUs_ = av_rescale_q(ts, timeBase, AV_TIME_BASE_Q);
+        }
+
+        int64_t offset = av_rescale_q(startUs_, AV_TIME_BASE_Q, timeBase);
+        if (packet->pts != AV_NOPTS_VALUE) packet->pts -= offset;
+        if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+        if (packetTime(packet) < 0) {
+            av_packet_unref(packet);
+            return true;
+        }
+
+        AVStream* outStream = formatContext_->streams[video ? 0 : audioStreamIndex_];
+        av_packet_rescale_ts(packet, timeBase, outStream->time_base);
+        packet->stream_index = outStream->index;
+        packet->pos = -1;
+
+        // 直播按到达顺序写出，不经过封装器的交织缓冲
+        int ret = av_write_frame(formatContext_, packet);
+        av_packet_unref(packet);
+        if (ret < 0) {
+            utils::printFFmpegError("HTTP client failed to write packet", ret);
+            finish("mux error");
+            return false;
+        }
+        avio_flush(formatContext_->pb);
+        return true;
+    }
+
+    bool HttpStreamClient::flushOutput() {
+        int64_t now = av_gettime_relative();
+        if (outputOffset_ >= output_.size()) {
+            output_.clear();
+            outputOffset_ = 0;
+            lastSendUs_ = now;
+            return false;
+        }
+
+        long n = sendSocket(socket_, output_.data() + outputOffset_, output_.size() - outputOffset_);
+        if (n > 0) {
+            outputOffset_ += static_cast<size_t>(n);
+            lastSendUs_ = now;
+            if (outputOffset_ >= output_.size()) {
+                output_.clear();
+                outputOffset_ = 0;
+            } else if (outputOffset_ >= kIOBufferSize) {
+                output_.erase(0, outputOffset_);
+                outputOffset_ = 0;
+            }
+            return true;
+        }
+
+        if (n < 0 && wouldBlock(socketError())) {
+            return false;
+        }
+        finish("connection closed");
+        return false;
+    }
+
+    void HttpStreamClient::sendError(int status) {
+        const char* reason = statusReason(status);
+        char response[256];
+        int length = snprintf(response, sizeof(response),
+                              "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n%s\n",
+                              status, reason, std::strlen(reason) + 1, reason);
+
+        // 尽力发送，套接字不可写时直接关闭
+        if (length > 0) {
+            sendSocket(socket_, response, static_cast<size_t>(length));
+        }
+        Logger::warning("HTTP client %s: %d %s", peer_.c_str(), status, reason);
+        state_ = State::FINISHED;
+    }
+
+    void HttpStreamClient::finish(const char* reason) {
+        if (state_ == State::FINISHED) {
+            return;
+        }
+        state_ = State::FINISHED;
+
+        uint64_t dropped = 0;
+        if (videoSubscription_) dropped += videoSubscription_->packets->droppedCount();
+        if (audioSubscription_) dropped += audioSubscription_->packets->droppedCount();
+        Logger::info("HTTP client %s disconnected: %s (%llu packets dropped)", peer_.c_str(), reason,
+                     static_cast<unsigned long long>(dropped));
+    }
+
+    int HttpStreamClient::writeCallback(void* opaque, uint8_t* buf, int size) {
+        auto* client = static_cast<HttpStreamClient*>(opaque);
+        if (client->chunked_) {
+            char chunkHeader[16];
+            snprintf(chunkHeader, sizeof(chunkHeader), "%x\r\n", size);
+            client->output_.append(chunkHeader);
+            client->output_.append(reinterpret_cast<const char*>(buf), static_cast<size_t>(size));
+            client->output_.append("\r\n");
+        } else {
+            client->output_.append(reinterpret_cast<const char*>(buf), static_cast<size_t>(size));
+        }
+        return size;
+    }
+
+    HttpStreamServer::HttpStreamServer(SourceResolver resolver)
+            : resolver_(std::move(resolver)),
+              listenSocket_(kInvalidSocket),
+              running_(false) {
+    }
+
+    HttpStreamServer::~HttpStreamServer() {
+        stop();
+    }
+
+    bool HttpStreamServer::start(const HttpServerOptions& options) {
+        if (running_) {
+            return true;
+        }
+        options_ = options;
+
+        if (!initSockets()) {
+            Logger::error("Failed to initialize Winsock");
+            return false;
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(options_.port));
+        if (inet_pton(AF_INET, options_.bindAddress.c_str(), &address.sin_addr) != 1) {
+            Logger::error("Invalid HTTP server bind address %s", options_.bindAddress.c_str());
+            return false;
+        }
+
+        listenSocket_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenSocket_ == kInvalidSocket) {
+            Logger::error("Failed to create HTTP server socket: %s", socketErrorString(socketError()).c_str());
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(listenSocket_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        if (bind(listenSocket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+            listen(listenSocket_, 64) < 0) {
+            Logger::error("Failed to listen on %s:%d: %s", options_.bindAddress.c_str(), options_.port,
+                          socketErrorString(socketError()).c_str());
+            closeSocket(listenSocket_);
+            listenSocket_ = kInvalidSocket;
+            return false;
+        }
+
+        running_ = true;
+        acceptThread_ = std::thread(&HttpStreamServer::acceptLoop, this);
+
+        Logger::info("HTTP stream server listening on %s:%d", options_.bindAddress.c_str(), options_.port);
+        return true;
+    }
+
+    void HttpStreamServer::stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (acceptThread_.joinable()) {
+            acceptThread_.join();
+        }
+        if (listenSocket_ != kInvalidSocket) {
+            closeSocket(listenSocket_);
+            listenSocket_ = kInvalidSocket;
+        }
+
+        // 在锁外断开，停止连接会等待其当前单步返回
+        std::vector<std::unique_ptr<HttpStreamClient>> clients;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            clients.swap(clients_);
+        }
+        clients.clear();
+
+        Logger::info("HTTP stream server stopped");
+    }
+
+    size_t HttpStreamServer::getClientCount() {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        return clients_.size();
+    }
+
+    void HttpStreamServer::acceptLoop() {
+        while (running_) {
+            int ret = waitReadable(listenSocket_, kAcceptPollMs);
+
+            reapClients();
+            if (ret <= 0) {
+                continue;
+            }
+
+            sockaddr_in address{};
+            socklen_t length = sizeof(address);
+            SocketHandle clientSocket = accept(listenSocket_, reinterpret_cast<sockaddr*>(&address), &length);
+            if (clientSocket == kInvalidSocket) {
+                continue;
+            }
+
+            char ip[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &address.sin_addr, ip, sizeof(ip));
+            std::string peer = std::string(ip) + ":" + std::to_string(ntohs(address.sin_port));
+
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            if (static_cast<int>(clients_.size()) >= options_.maxClients) {
+                static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+                                           "Connection: close\r\n\r\n";
+                sendSocket(clientSocket, busy, sizeof(busy) - 1);
+                closeSocket(clientSocket);
+                Logger::warning("HTTP server rejected %s: too many clients", peer.c_str());
+                continue;
+            }
+
+            auto client = std::make_unique<HttpStreamClient>(clientSocket, peer, resolver_, options_);
+            client->start();
+            clients_.push_back(std::move(client));
+        }
+    }
+
+    void HttpStreamServer::reapClients() {
+        std::vector<std::unique_ptr<HttpStreamClient>> finished;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            for (auto it = clients_.begin(); it != clients_.end();) {
+                if ((*it)->isFinished()) {
+                    finished.push_back(std::move(*it));
+                    it = clients_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        // 析构时停止连接并释放订阅
+        finished.clear();
+    }
+
+} // namespace ffmpeg_stream
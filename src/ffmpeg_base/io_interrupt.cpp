@@ -0,0 +1,70 @@
+/**
+ * @file io_interrupt.cpp
+ * @brief FFmpeg阻塞I/O中断控制实现
+ */
+
+#include "ffmpeg_base/io_interrupt.h"
+
+extern "C" {
+#include <libavutil/time.h>
+}
+
+namespace ffmpeg_stream {
+
+    IOInterrupter::IOInterrupter()
+            : aborted_(false), deadlineUs_(0), parent_(nullptr) {
+    }
+
+    void IOInterrupter::install(AVFormatContext* context) {
+        context->interrupt_callback = getCallback();
+    }
+
+    AVIOInterruptCB IOInterrupter::getCallback() {
+        AVIOInterruptCB callback;
+        callback.callback = &IOInterrupter::onInterrupt;
+        callback.opaque = this;
+        return callback;
+    }
+
+    void IOInterrupter::setParent(const IOInterrupter* parent) {
+        parent_ = parent;
+    }
+
+    void IOInterrupter::setDeadline(int timeoutMs) {
+        deadlineUs_ = timeoutMs > 0 ? av_gettime_relative() + static_cast<int64_t>(timeoutMs) * 1000 : 0;
+    }
+
+    void IOInterrupter::clearDeadline() {
+        deadlineUs_ = 0;
+    }
+
+    void IOInterrupter::abort() {
+        aborted_ = true;
+    }
+
+    void IOInterrupter::reset() {
+        aborted_ = false;
+        deadlineUs_ = 0;
+    }
+
+    bool IOInterrupter::isAborted() const {
+        if (aborted_) {
+            return true;
+        }
+        const IOInterrupter* parent = parent_;
+        return parent && parent->isAborted();
+    }
+
+    bool IOInterrupter::shouldInterrupt() const {
+        if (isAborted()) {
+            return true;
+        }
+        int64_t deadline = deadlineUs_;
+        return deadline != 0 && av_gettime_relative() > deadline;
+    }
+
+    int IOInterrupter::onInterrupt(void* opaque) {
+        return static_cast<IOInterrupter*>(opaque)->shouldInterrupt() ? 1 : 0;
+    }
+
+} // namespace ffmpeg_stream
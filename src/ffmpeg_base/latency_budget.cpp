@@ -0,0 +1,104 @@
+/**
+ * @file latency_budget.cpp
+ * @brief 推流延迟预算实现
+ */
+
+#include "ffmpeg_base/latency_budget.h"
+#include "logger/logger.h"
+
+extern "C" {
+#include <libavutil/avutil.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/time.h>
+}
+
+namespace ffmpeg_stream {
+
+    LatencyBudget::LatencyBudget()
+            : softLimitMs_(0), hardLimitMs_(0),
+              startWallUs_(AV_NOPTS_VALUE), startTimestampUs_(AV_NOPTS_VALUE),
+              waitKeyframe_(false), sheddingNonRef_(false), latencyMs_(0) {
+    }
+
+    void LatencyBudget::configure(int softMs, int hardMs) {
+        softLimitMs_ = softMs > 0 ? softMs : 0;
+        hardLimitMs_ = hardMs > softLimitMs_ ? hardMs : softLimitMs_ * 3;
+        reset();
+    }
+
+    void LatencyBudget::reset() {
+        startWallUs_ = AV_NOPTS_VALUE;
+        startTimestampUs_ = AV_NOPTS_VALUE;
+        waitKeyframe_ = false;
+        sheddingNonRef_ = false;
+        latencyMs_ = 0;
+    }
+
+    void LatencyBudget::anchor(int64_t now, int64_t timestamp, AVRational timeBase) {
+        startWallUs_ = now;
+        startTimestampUs_ = av_rescale_q(timestamp, timeBase, AV_TIME_BASE_Q);
+    }
+
+    LatencyBudget::Action LatencyBudget::check(int64_t timestamp, AVRational timeBase,
+                                               bool keyframe, int64_t backlogMs) {
+        if (softLimitMs_ <= 0 || timestamp == AV_NOPTS_VALUE) {
+            return Action::KEEP;
+        }
+
+        int64_t now = av_gettime_relative();
+        if (startWallUs_ == AV_NOPTS_VALUE) {
+            anchor(now, timestamp, timeBase);
+        }
+
+        // 丢到关键帧后重新锚定，已丢弃的积压不再计入
+        if (waitKeyframe_) {
+            if (!keyframe) {
+                return Action::DROP_TO_KEYFRAME;
+            }
+            waitKeyframe_ = false;
+            anchor(now, timestamp, timeBase);
+            Logger::info("Latency recovered at keyframe");
+        }
+
+        int64_t elapsedUs = now - startWallUs_;
+        int64_t advancedUs = av_rescale_q(timestamp, timeBase, AV_TIME_BASE_Q) - startTimestampUs_;
+        int64_t latencyMs = (elapsedUs - advancedUs) / 1000 + backlogMs;
+
+        if (latencyMs > hardLimitMs_) {
+            Logger::warning("Latency %lld ms exceeds hard limit %d ms, dropping to next keyframe",
+                            static_cast<long long>(latencyMs), hardLimitMs_);
+            if (!keyframe) {
+                waitKeyframe_ = true;
+                latencyMs_ = latencyMs;
+                sheddingNonRef_ = true;
+                return Action::DROP_TO_KEYFRAME;
+            }
+            anchor(now, timestamp, timeBase);
+            latencyMs = backlogMs;
+        } else if (latencyMs < -hardLimitMs_) {
+            // 时间戳向前跳变(如输入源重启)，重新锚定
+            anchor(now, timestamp, timeBase);
+            latencyMs = backlogMs;
+        }
+
+        latencyMs_ = latencyMs;
+
+        bool shedding = latencyMs > softLimitMs_;
+        if (shedding != sheddingNonRef_) {
+            Logger::info("Latency %lld ms, %s non-reference frames",
+                         static_cast<long long>(latencyMs), shedding ? "dropping" : "resumed");
+            sheddingNonRef_ = shedding;
+        }
+
+        return shedding ? Action::DROP_NONREF : Action::KEEP;
+    }
+
+    int64_t LatencyBudget::getLatencyMs() const {
+        return latencyMs_;
+    }
+
+    bool LatencyBudget::isSheddingNonRef() const {
+        return sheddingNonRef_;
+    }
+
+} // namespace ffmpeg_stream
@@ -0,0 +1,113 @@
+/**
+ * @file reconnect_policy.cpp
+ * @brief 重连退避策略实现
+ */
+
+#include "ffmpeg_base/reconnect_policy.h"
+#include <algorithm>
+#include <cerrno>
+
+extern "C" {
+#include <libavutil/error.h>
+}
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 无望恢复的错误(认证、不存在)的上限倍数
+        constexpr int kHopelessCapFactor = 4;
+
+        // 指数的最大值，避免移位溢出
+        constexpr int kMaxExponent = 16;
+    }
+
+    ReconnectPolicy::ReconnectPolicy()
+            : baseDelayMs_(3000), maxDelayMs_(60000), maxAttempts_(10), attempts_(0),
+              random_(std::random_device{}()) {
+    }
+
+    void ReconnectPolicy::configure(int baseDelayMs, int maxDelayMs, int maxAttempts) {
+        baseDelayMs_ = std::max(baseDelayMs, 1);
+        maxDelayMs_ = std::max(maxDelayMs, baseDelayMs_);
+        maxAttempts_ = maxAttempts;
+    }
+
+    void ReconnectPolicy::reset() {
+        attempts_ = 0;
+    }
+
+    int ReconnectPolicy::nextDelay(int error) {
+        if (maxAttempts_ >= 0 && attempts_ >= maxAttempts_) {
+            return -1;
+        }
+
+        ErrorClass errorClass = classify(error);
+        int shift = 0;
+        int64_t cap = maxDelayMs_;
+        switch (errorClass) {
+            case ErrorClass::UNREACHABLE:
+                shift = 1;
+                break;
+            case ErrorClass::AUTH:
+            case ErrorClass::NOT_FOUND:
+                shift = 3;
+                cap *= kHopelessCapFactor;
+                break;
+            default:
+                break;
+        }
+
+        int exponent = std::min(attempts_ + shift, kMaxExponent);
+        int64_t delay = std::min(static_cast<int64_t>(baseDelayMs_) << exponent, cap);
+        attempts_++;
+
+        // 在[delay/2, delay]之间随机取值
+        std::uniform_int_distribution<int64_t> jitter(delay / 2, delay);
+        return static_cast<int>(jitter(random_));
+    }
+
+    int ReconnectPolicy::getAttempts() const {
+        return attempts_;
+    }
+
+    ReconnectPolicy::ErrorClass ReconnectPolicy::classify(int error) {
+        switch (error) {
+            case AVERROR(ETIMEDOUT):
+            case AVERROR_EXIT:
+                return ErrorClass::TIMEOUT;
+
+            case AVERROR(ECONNREFUSED):
+            case AVERROR(ECONNRESET):
+            case AVERROR(EHOSTUNREACH):
+            case AVERROR(ENETUNREACH):
+                return ErrorClass::UNREACHABLE;
+
+            // RTSP的401/403在旧版本FFmpeg中映射为EPERM/EACCES
+            case AVERROR_HTTP_UNAUTHORIZED:
+            case AVERROR_HTTP_FORBIDDEN:
+            case AVERROR(EPERM):
+            case AVERROR(EACCES):
+                return ErrorClass::AUTH;
+
+            case AVERROR_HTTP_NOT_FOUND:
+            case AVERROR_STREAM_NOT_FOUND:
+            case AVERROR_PROTOCOL_NOT_FOUND:
+            case AVERROR(ENOENT):
+                return ErrorClass::NOT_FOUND;
+
+            default:
+                return ErrorClass::TRANSIENT;
+        }
+    }
+
+    const char* ReconnectPolicy::errorClassToString(ErrorClass errorClass) {
+        switch (errorClass) {
+            case ErrorClass::TIMEOUT: return "timeout";
+            case ErrorClass::UNREACHABLE: return "unreachable";
+            case ErrorClass::AUTH: return "auth";
+            case ErrorClass::NOT_FOUND: return "not found";
+            default: return "transient";
+        }
+    }
+
+} // namespace ffmpeg_stream
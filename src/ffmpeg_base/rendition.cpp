@@ -0,0 +1,727 @@
+/**
+ * @file rendition.cpp
+ * @brief 推流输出档位实现
+ */
+
+#include "ffmpeg_base/rendition.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+}
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 本地HLS/CMAF输出写入的清单，HLS播放列表(master.m3u8等)与之写在同一目录
+        const char* const kHlsManifestName = "manifest.mpd";
+
+        // dash封装器的lhls、frag_type和frag_duration选项自FFmpeg 4.3(libavformat 58.45.100)起提供
+        const unsigned kHlsMinAVFormatVersion = AV_VERSION_INT(58, 45, 100);
+
+        std::string secondsString(int ms) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.3f", ms / 1000.0);
+            return buf;
+        }
+    }
+
+    Rendition::Rendition(const std::string& name, const RenditionConfig& config, const StreamConfig& streamConfig,
+                         const IOInterrupter* interrupter)
+            : name_(name),
+              config_(config),
+              streamConfig_(streamConfig),
+              interrupter_(interrupter),
+              copy_(false),
+              inputTimeBase_(AVRational{1, 1}),
+              startDts_(AV_NOPTS_VALUE),
+              ptsOffset_(AV_NOPTS_VALUE),
+              queuedPts_(AV_NOPTS_VALUE),
+              encodingPts_(AV_NOPTS_VALUE),
+              audioTimeBase_(AVRational{0, 1}),
+              videoParams_(nullptr),
+              videoOutTimeBase_(AVRational{0, 1}),
+              audioParams_(nullptr),
+              audioOutTimeBase_(AVRational{0, 1}),
+              videoRef_(av_packet_alloc()),
+              audioRef_(av_packet_alloc()),
+              failedOutputs_(0),
+              outputError_(0),
+              encodeFrame_(av_frame_alloc()),
+              scaledFrame_(av_frame_alloc()),
+              repeatFrame_(av_frame_alloc()),
+              error_(0) {
+        encodeStage_ = std::make_unique<StageRunner>(name_ + "-encode");
+    }
+
+    Rendition::~Rendition() {
+        close();
+        av_frame_free(&encodeFrame_);
+        av_frame_free(&scaledFrame_);
+        av_frame_free(&repeatFrame_);
+        av_packet_free(&videoRef_);
+        av_packet_free(&audioRef_);
+    }
+
+    bool Rendition::isHlsFormat(const std::string& format) {
+        std::string name = utils::toLower(format);
+        return name == "llhls" || name == "cmaf";
+    }
+
+    std::map<std::string, std::string> Rendition::makeHlsOptions(const StreamConfig& config) {
+        int segmentMs = config.hlsSegmentMs > 0 ? config.hlsSegmentMs : 2000;
+        int partMs = config.hlsPartMs > 0 ? std::min(config.hlsPartMs, segmentMs) : segmentMs;
+        int listSize = config.hlsListSize > 0 ? config.hlsListSize : 6;
+
+        // 分段在编码器关键帧处切分；分段内按partMs切成CMAF分片，写完一片即可被播放端取走
+        std::map<std::string, std::string> options;
+        options["hls_playlist"] = "1";
+        options["streaming"] = "1";
+        options["lhls"] = "1";
+        options["seg_duration"] = secondsString(segmentMs);
+        options["frag_type"] = "duration";
+        options["frag_duration"] = secondsString(partMs);
+        options["window_size"] = std::to_string(listSize);
+        options["extra_window_size"] = "2";  // 滑出播放列表的分段再保留两个，避免正在下载的播放端取不到
+        options["remove_at_exit"] = "0";
+
+        // dash封装器的lhls仍标记为实验性，默认的严格程度下写头会返回AVERROR_EXPERIMENTAL
+        options["strict"] = "experimental";
+        return options;
+    }
+
+    bool Rendition::canCopy(const RenditionConfig& config, const AVCodecParameters* codecParams) {
+        AVCodecID targetCodec = codecNameToAVCodecID(config.videoCodec);
+        if (targetCodec == AV_CODEC_ID_NONE || codecParams->codec_id != targetCodec) {
+            return false;
+        }
+
+        if (codecParams->width != config.width || codecParams->height != config.height) {
+            return false;
+        }
+
+        // 部分输入(如RTSP)不携带码率信息，此时仅按编码和分辨率判断
+        if (codecParams->bit_rate > 0 && codecParams->bit_rate > config.bitrate) {
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Rendition::open(const AVStream* inputStream, const AVStream* audioStream) {
+        close();
+
+        inputTimeBase_ = inputStream->time_base;
+        startDts_ = AV_NOPTS_VALUE;
+        ptsOffset_ = AV_NOPTS_VALUE;
+        audioTimeBase_ = AVRational{0, 1};
+        error_ = 0;
+        failedOutputs_ = 0;
+        outputError_ = 0;
+
+        if (!createOutputSlots()) {
+            return false;
+        }
+
+        // 各路输出共用一份音视频：任一路的格式要求全局头时编码器输出全局头(MPEG-TS在关键帧前自行插入参数集)，
+        // 所有格式都能承载输入的音频编码时直通，否则转码为AAC
+        bool globalHeader = false;
+        bool carryAudio = audioStream != nullptr;
+        for (const auto& slot : outputs_) {
+            const AVOutputFormat* format = StreamOutput::guessFormat(slot->format, slot->url);
+            if (format && (format->flags & AVFMT_GLOBALHEADER)) {
+                globalHeader = true;
+            }
+            if (audioStream && !StreamOutput::canCarryAudio(format, audioStream->codecpar->codec_id)) {
+                carryAudio = false;
+            }
+        }
+
+        // 转码器初始化失败时只输出视频
+        if (audioStream) {
+            if (carryAudio) {
+                audioParams_ = avcodec_parameters_alloc();
+                if (audioParams_ && avcodec_parameters_copy(audioParams_, audioStream->codecpar) >= 0) {
+                    audioOutTimeBase_ = audioStream->time_base;
+                } else {
+                    Logger::warning("Rendition %s: failed to copy audio parameters, audio disabled", name_.c_str());
+                    avcodec_parameters_free(&audioParams_);
+                }
+            } else {
+                audioTranscoder_ = std::make_unique<AudioTranscoder>();
+                if (audioTranscoder_->init(audioStream->codecpar, audioStream->time_base, AV_CODEC_ID_AAC,
+                                           streamConfig_.audioBitrate, globalHeader)) {
+                    Logger::info("Rendition %s: output format cannot carry %s audio, transcoding to AAC",
+                                 name_.c_str(), avcodec_get_name(audioStream->codecpar->codec_id));
+                } else {
+                    Logger::warning("Rendition %s: failed to initialize audio transcoder, audio disabled",
+                                    name_.c_str());
+                    audioTranscoder_.reset();
+                }
+            }
+        }
+
+        // 转码时输出流参数来自音频编码器
+        if (audioTranscoder_) {
+            audioParams_ = avcodec_parameters_alloc();
+            if (!audioParams_ ||
+                avcodec_parameters_from_context(audioParams_, audioTranscoder_->getCodecContext()) < 0) {
+                Logger::warning("Rendition %s: failed to copy audio encoder parameters, audio disabled",
+                                name_.c_str());
+                avcodec_parameters_free(&audioParams_);
+                audioTranscoder_.reset();
+            } else {
+                audioOutTimeBase_ = audioTranscoder_->getCodecContext()->time_base;
+            }
+        }
+        if (audioParams_) {
+            audioTimeBase_ = audioStream->time_base;
+        }
+
+        // 输入已符合档位要求时直接转封装
+        copy_ = canCopy(config_, inputStream->codecpar);
+        if (copy_) {
+            Logger::info("Rendition %s matches input, using remux mode", name_.c_str());
+            videoParams_ = avcodec_parameters_alloc();
+            int ret = videoParams_ ? avcodec_parameters_copy(videoParams_, inputStream->codecpar) : AVERROR(ENOMEM);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to copy input parameters", ret);
+                releaseOutputs();
+                audioTranscoder_.reset();
+                return false;
+            }
+            videoOutTimeBase_ = inputStream->time_base;
+        } else {
+            // 初始化编码器
+            AVCodecID codecId = codecNameToAVCodecID(config_.videoCodec);
+            if (codecId == AV_CODEC_ID_NONE) {
+                codecId = AV_CODEC_ID_H264;
+            }
+
+            // fMP4等要求全局头的格式在写头时就需要参数集
+            encoder_ = std::make_unique<HWEncoder>();
+            encoder_->setGlobalHeader(globalHeader);
+            if (!encoder_->init(config_.width, config_.height, AV_PIX_FMT_YUV420P, config_.bitrate,
+                                config_.fps, streamConfig_.encoderHWAccel, codecId)) {
+                Logger::error("Failed to initialize encoder for rendition %s", name_.c_str());
+                encoder_.reset();
+                releaseOutputs();
+                audioTranscoder_.reset();
+                return false;
+            }
+
+            AVCodecContext* codecContext = encoder_->getCodecContext();
+
+            // 缩放到编码器的输入格式，硬件像素格式由编码器内部上传，这里转换为YUV420P
+            AVPixelFormat pixFmt = codecContext->pix_fmt;
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFmt);
+            if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+                pixFmt = AV_PIX_FMT_YUV420P;
+            }
+            scaler_ = std::make_unique<VideoScaler>();
+            scaler_->setTarget(config_.width, config_.height, pixFmt);
+            scaler_->setOptions(scaleAlgorithmToSwsFlags(streamConfig_.scaleAlgorithm), streamConfig_.scaleThreads);
+
+            // 解码帧按输入时间基计时，编码器按1/fps计时，由帧率转换对齐
+            rateConverter_ = std::make_unique<FrameRateConverter>();
+            rateConverter_->setRate(inputStream->time_base, codecContext->time_base);
+            AVRational inputRate = inputStream->avg_frame_rate.num > 0 ? inputStream->avg_frame_rate
+                                                                        : inputStream->r_frame_rate;
+            if (inputRate.num > 0 && inputRate.den > 0 && av_cmp_q(inputRate, codecContext->framerate) != 0) {
+                Logger::info("Rendition %s: converting %.2f fps input to %d fps",
+                             name_.c_str(), av_q2d(inputRate), config_.fps);
+            }
+
+            videoParams_ = avcodec_parameters_alloc();
+            int ret = videoParams_ ? avcodec_parameters_from_context(videoParams_, codecContext) : AVERROR(ENOMEM);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to copy encoder parameters", ret);
+                encoder_.reset();
+                scaler_.reset();
+                rateConverter_.reset();
+                releaseOutputs();
+                audioTranscoder_.reset();
+                return false;
+            }
+            videoOutTimeBase_ = codecContext->time_base;
+        }
+
+        // 打开各路输出，至少一路成功即可，其余的按退避重连
+        std::vector<int> errors(outputs_.size(), 0);
+        size_t opened = 0;
+        int lastError = 0;
+        for (size_t i = 0; i < outputs_.size(); i++) {
+            outputs_[i]->output = openOutput(*outputs_[i], errors[i]);
+            if (outputs_[i]->output) {
+                opened++;
+            } else {
+                lastError = errors[i];
+            }
+        }
+        if (opened == 0) {
+            error_ = lastError;
+            encoder_.reset();
+            scaler_.reset();
+            rateConverter_.reset();
+            releaseOutputs();
+            audioTranscoder_.reset();
+            return false;
+        }
+        for (size_t i = 0; i < outputs_.size(); i++) {
+            std::lock_guard<std::mutex> lock(outputs_[i]->mutex);
+            if (!outputs_[i]->output) {
+                failOutput(outputs_[i], errors[i]);
+            }
+        }
+
+        if (outputs_.size() > 1) {
+            Logger::info("Rendition %s: %zu of %zu outputs opened", name_.c_str(), opened, outputs_.size());
+        }
+
+        if (!copy_) {
+            size_t depth = streamConfig_.queueDepth > 0 ? static_cast<size_t>(streamConfig_.queueDepth) : 1;
+            frameQueue_ = std::make_unique<FrameQueue>(depth, streamConfig_.queueOverflowPolicy);
+            queuedPts_ = AV_NOPTS_VALUE;
+            encodingPts_ = AV_NOPTS_VALUE;
+            encodeStage_->start([this]() { return encodeStep(); });
+
+            Logger::info("Rendition %s: %dx%d @ %d bps -> %s", name_.c_str(),
+                         config_.width, config_.height, config_.bitrate, config_.outputUrl.c_str());
+        }
+        return true;
+    }
+
+    void Rendition::close() {
+        encodeStage_->stop();
+
+        // 编码阶段已停止，剩余的帧和编码器缓存的包在这里写出
+        if (encoder_ && !outputs_.empty() && getError() == 0) {
+            if (frameQueue_) {
+                while (error_ == 0 && frameQueue_->pop(encodeFrame_)) {
+                    encodeFrame(encodeFrame_);
+                    av_frame_unref(encodeFrame_);
+                }
+            }
+            if (getError() == 0) {
+                encoder_->flush([this](AVPacket* packet) {
+                    return writeEncodedPacket(packet);
+                });
+            }
+        }
+
+        // 音频转码器中剩余的样本
+        if (audioTranscoder_ && !outputs_.empty() && getError() == 0) {
+            audioTranscoder_->flush([this](AVPacket* packet) {
+                return writeToOutputs(packet, audioTranscoder_->getCodecContext()->time_base, false);
+            });
+        }
+        audioTranscoder_.reset();
+
+        releaseOutputs();
+
+        if (encoder_) {
+            encoder_->cleanup();
+            encoder_.reset();
+        }
+
+        scaler_.reset();
+        rateConverter_.reset();
+        frameQueue_.reset();
+        av_frame_unref(encodeFrame_);
+        av_frame_unref(scaledFrame_);
+    }
+
+    bool Rendition::isCopy() const {
+        return copy_;
+    }
+
+    bool Rendition::pushPacket(AVPacket* packet) {
+        if (outputs_.empty() || getError() != 0) {
+            return false;
+        }
+
+        // 从关键帧开始输出，避免播放端收到不完整的GOP
+        if (startDts_ == AV_NOPTS_VALUE) {
+            if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+                return true;
+            }
+            startDts_ = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        }
+
+        // 时间戳归零
+        if (startDts_ != AV_NOPTS_VALUE) {
+            if (packet->pts != AV_NOPTS_VALUE) packet->pts -= startDts_;
+            if (packet->dts != AV_NOPTS_VALUE) packet->dts -= startDts_;
+        }
+
+        return writeToOutputs(packet, inputTimeBase_, true);
+    }
+
+    bool Rendition::pushAudio(AVPacket* packet) {
+        if (outputs_.empty() || audioTimeBase_.num == 0 || getError() != 0) {
+            return false;
+        }
+
+        // 视频的起点还未确定(等待关键帧或第一帧编码)时丢弃音频
+        int64_t videoStart = copy_ ? startDts_ : ptsOffset_.load();
+        if (videoStart == AV_NOPTS_VALUE) {
+            return true;
+        }
+
+        // 按视频起点归零，保持音视频同步
+        int64_t offset = av_rescale_q(videoStart, inputTimeBase_, audioTimeBase_);
+        if (packet->pts != AV_NOPTS_VALUE) packet->pts -= offset;
+        if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+
+        // 早于视频起点的音频没有对应的画面
+        int64_t ts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        if (ts == AV_NOPTS_VALUE || ts < 0) {
+            return true;
+        }
+
+        if (!audioTranscoder_) {
+            return writeToOutputs(packet, audioTimeBase_, false);
+        }
+
+        int ret = audioTranscoder_->transcode(packet, [this](AVPacket* encoded) {
+            return writeToOutputs(encoded, audioTranscoder_->getCodecContext()->time_base, false);
+        });
+        // 音频转码失败不影响视频，之后只输出视频
+        if (ret < 0 && ret != AVERROR_EXIT) {
+            Logger::warning("Rendition %s: audio transcoding failed, audio disabled", name_.c_str());
+            audioTimeBase_ = AVRational{0, 1};
+        }
+        return getError() == 0;
+    }
+
+    bool Rendition::pushFrame(const AVFrame* frame) {
+        if (!frameQueue_ || getError() != 0) {
+            return false;
+        }
+
+        // 队列满被丢弃不算错误
+        if (frameQueue_->push(frame)) {
+            queuedPts_ = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+            encodeStage_->wake();
+        }
+        return true;
+    }
+
+    int Rendition::getError() const {
+        // 所有输出都已放弃时编码阶段也会因写入失败而停止，优先报告输出的错误
+        if (!outputs_.empty() && failedOutputs_ >= outputs_.size()) {
+            return outputError_ != 0 ? outputError_.load() : AVERROR(EIO);
+        }
+        return error_;
+    }
+
+    int64_t Rendition::getBacklogMs() const {
+        if (!frameQueue_ || frameQueue_->empty()) {
+            return 0;
+        }
+
+        // 队列中是输入帧率的解码帧，档位帧率转换在出队后进行，按最新入队帧与正在编码帧的时间差计算
+        int64_t queued = queuedPts_;
+        int64_t encoding = encodingPts_;
+        if (queued != AV_NOPTS_VALUE && encoding != AV_NOPTS_VALUE && queued >= encoding) {
+            return av_rescale_q(queued - encoding, inputTimeBase_, AVRational{1, 1000});
+        }
+
+        // 没有时间戳时按本档位帧率估算
+        return config_.fps > 0 ? static_cast<int64_t>(frameQueue_->size()) * 1000 / config_.fps : 0;
+    }
+
+    uint64_t Rendition::getDroppedCount() const {
+        uint64_t dropped = 0;
+        if (frameQueue_) dropped += frameQueue_->droppedCount();
+        for (const auto& slot : outputs_) {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (slot->output) dropped += slot->output->getDroppedCount();
+        }
+        return dropped;
+    }
+
+    size_t Rendition::getActiveOutputCount() const {
+        size_t active = 0;
+        for (const auto& slot : outputs_) {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (slot->output) active++;
+        }
+        return active;
+    }
+
+    const RenditionConfig& Rendition::getConfig() const {
+        return config_;
+    }
+
+    bool Rendition::createOutputSlots() {
+        std::vector<OutputTarget> targets;
+        targets.push_back(OutputTarget{config_.outputUrl, config_.outputFormat});
+        targets.insert(targets.end(), config_.extraOutputs.begin(), config_.extraOutputs.end());
+
+        for (size_t i = 0; i < targets.size(); i++) {
+            const OutputTarget& target = targets[i];
+            if (target.url.empty()) {
+                Logger::warning("Rendition %s: output %zu has no url, skipped", name_.c_str(), i);
+                continue;
+            }
+
+            auto slot = std::make_shared<OutputSlot>();
+            slot->name = i == 0 ? name_ : name_ + "-out" + std::to_string(i);
+            slot->url = target.url;
+            slot->format = target.format;
+            slot->hls = isHlsFormat(target.format);
+            slot->closed = false;
+            slot->waitKeyframe = false;
+            slot->failed = false;
+
+            // 本地HLS/CMAF输出由dash封装器写fMP4分段和HLS播放列表，输出地址为目录
+            if (slot->hls) {
+                unsigned version = avformat_version();
+                if (version < kHlsMinAVFormatVersion) {
+                    Logger::error("Rendition %s: %s output %s requires FFmpeg 4.3 or later "
+                                  "(libavformat %u.%u.%u found), output skipped",
+                                  name_.c_str(), target.format.c_str(), target.url.c_str(),
+                                  AV_VERSION_MAJOR(version), AV_VERSION_MINOR(version), AV_VERSION_MICRO(version));
+                    continue;
+                }
+                if (!utils::createDirectory(target.url)) {
+                    continue;
+                }
+                slot->url = target.url + "/" + kHlsManifestName;
+                slot->format = "dash";
+            }
+            outputs_.push_back(std::move(slot));
+        }
+
+        // 只有一路输出时出错即放弃，由所属流整体重连
+        int maxAttempts = outputs_.size() > 1 ? streamConfig_.maxReconnects : 0;
+        for (auto& slot : outputs_) {
+            slot->reconnect.configure(streamConfig_.reconnectDelay, streamConfig_.reconnectMaxDelay, maxAttempts);
+        }
+        return !outputs_.empty();
+    }
+
+    std::unique_ptr<StreamOutput> Rendition::openOutput(OutputSlot& slot, int& error) {
+        size_t depth = streamConfig_.queueDepth > 0 ? static_cast<size_t>(streamConfig_.queueDepth) : 1;
+        auto output = std::make_unique<StreamOutput>(slot.name, slot.url, slot.format,
+                                                     depth, streamConfig_.queueOverflowPolicy,
+                                                     streamConfig_.networkTimeout, interrupter_);
+        if (slot.hls) {
+            output->setMuxOptions(makeHlsOptions(streamConfig_));
+        }
+
+        if (!output->open(videoParams_, videoOutTimeBase_, audioParams_, audioOutTimeBase_)) {
+            error = output->getError();
+            return nullptr;
+        }
+        return output;
+    }
+
+    bool Rendition::writeToOutputs(AVPacket* packet, AVRational timeBase, bool video) {
+        // 输出会原地改写时间戳，每路使用自己的一份引用，数据本身不拷贝
+        AVPacket* ref = video ? videoRef_ : audioRef_;
+        for (auto& slot : outputs_) {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            if (!slot->output) {
+                continue;
+            }
+
+            // 重新打开的输出从视频关键帧开始，之前的音频也不写入
+            if (slot->waitKeyframe) {
+                if (!video || !(packet->flags & AV_PKT_FLAG_KEY)) {
+                    continue;
+                }
+                slot->waitKeyframe = false;
+            }
+
+            if (av_packet_ref(ref, packet) < 0) {
+                continue;
+            }
+            bool written = video ? slot->output->write(ref, timeBase) : slot->output->writeAudio(ref, timeBase);
+            av_packet_unref(ref);
+            if (!written && slot->output->getError() != 0) {
+                failOutput(slot, slot->output->getError());
+            }
+        }
+        return failedOutputs_ < outputs_.size();
+    }
+
+    void Rendition::failOutput(const std::shared_ptr<OutputSlot>& slot, int error) {
+        // 关闭可能阻塞到写入超时，交给重新打开任务进行，不影响其他输出的写入
+        if (slot->output) {
+            slot->stale = std::move(slot->output);
+        }
+
+        int delay = slot->reconnect.nextDelay(error);
+        if (delay < 0) {
+            slot->failed = true;
+            outputError_ = error;
+            failedOutputs_++;
+            if (outputs_.size() > 1) {
+                Logger::error("Rendition %s: giving up on output %s", name_.c_str(), slot->url.c_str());
+            }
+            return;
+        }
+
+        Logger::warning("Rendition %s: output %s failed (%s), reopening in %d ms (attempt %d)",
+                        name_.c_str(), slot->url.c_str(),
+                        ReconnectPolicy::errorClassToString(ReconnectPolicy::classify(error)),
+                        delay, slot->reconnect.getAttempts());
+
+        // 等待由调度器定时完成，不占用线程；打开可能阻塞到网络超时，在I/O调度器上执行
+        std::weak_ptr<OutputSlot> weakSlot = slot;
+        Scheduler::getIOInstance().runAfter(std::chrono::milliseconds(delay), [this, weakSlot]() {
+            auto slot = weakSlot.lock();
+            if (!slot) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(slot->openMutex);
+            if (slot->closed) {
+                return;
+            }
+            reopenOutput(slot);
+        });
+    }
+
+    void Rendition::reopenOutput(const std::shared_ptr<OutputSlot>& slot) {
+        std::unique_ptr<StreamOutput> stale;
+        {
+            std::lock_guard<std::mutex> lock(slot->mutex);
+            stale = std::move(slot->stale);
+        }
+        if (stale) {
+            stale->close();
+        }
+
+        // 打开期间其他输出照常写入
+        int error = 0;
+        std::unique_ptr<StreamOutput> output = openOutput(*slot, error);
+
+        std::lock_guard<std::mutex> lock(slot->mutex);
+        if (output) {
+            slot->output = std::move(output);
+            slot->waitKeyframe = true;
+            slot->reconnect.reset();
+            Logger::info("Rendition %s: output %s reopened", name_.c_str(), slot->url.c_str());
+        } else {
+            failOutput(slot, error);
+        }
+    }
+
+    void Rendition::releaseOutputs() {
+        // 定时的重新打开不再执行，进行中的(父中断器已中止时很快返回)在这里等待结束
+        for (auto& slot : outputs_) {
+            std::lock_guard<std::mutex> lock(slot->openMutex);
+            slot->closed = true;
+        }
+
+        for (auto& slot : outputs_) {
+            if (slot->output) {
+                slot->output->close();
+            }
+            if (slot->stale) {
+                slot->stale->close();
+            }
+        }
+        outputs_.clear();
+        failedOutputs_ = 0;
+
+        avcodec_parameters_free(&videoParams_);
+        avcodec_parameters_free(&audioParams_);
+        videoOutTimeBase_ = AVRational{0, 1};
+        audioOutTimeBase_ = AVRational{0, 1};
+    }
+
+    bool Rendition::encodeStep() {
+        if (error_ != 0) {
+            return false;
+        }
+
+        if (!frameQueue_->pop(encodeFrame_)) {
+            return false;
+        }
+        encodingPts_ = encodeFrame_->pts != AV_NOPTS_VALUE ? encodeFrame_->pts : encodeFrame_->best_effort_timestamp;
+
+        encodeFrame(encodeFrame_);
+        av_frame_unref(encodeFrame_);
+        return true;
+    }
+
+    bool Rendition::encodeFrame(AVFrame* frame) {
+        // 时间戳按第一帧归零，音频也以此对齐
+        int64_t pts = frame->pts != AV_NOPTS_VALUE ? frame->pts : frame->best_effort_timestamp;
+        if (ptsOffset_ == AV_NOPTS_VALUE) {
+            ptsOffset_ = pts;
+        }
+        int64_t offset = ptsOffset_;
+        int64_t relative = (pts == AV_NOPTS_VALUE || offset == AV_NOPTS_VALUE) ? AV_NOPTS_VALUE : pts - offset;
+
+        // 按档位帧率取舍，在缩放之前判断，输入帧率高于目标时多余的帧不产生缩放和编码开销
+        int64_t outputPts = 0;
+        int repeat = 0;
+        if (!rateConverter_->next(relative, outputPts, repeat)) {
+            return true;
+        }
+
+        auto sink = [this](AVPacket* packet) {
+            return writeEncodedPacket(packet);
+        };
+
+        // 输入帧率低于目标或有短暂间隙时重复上一帧
+        for (int i = repeat; i > 0; i--) {
+            if (!rateConverter_->repeatLast(repeatFrame_, outputPts - i)) {
+                break;
+            }
+            int ret = encoder_->encode(repeatFrame_, sink);
+            av_frame_unref(repeatFrame_);
+            if (ret < 0) {
+                setError(ret);
+                return false;
+            }
+        }
+
+        // 尺寸或像素格式不符(如高分辨率输入、硬件解码传回的NV12)时先转换
+        AVFrame* input = frame;
+        if (scaler_->needsScaling(frame)) {
+            int ret = scaler_->scale(frame, scaledFrame_);
+            if (ret < 0) {
+                setError(ret);
+                return false;
+            }
+            input = scaledFrame_;
+        }
+
+        // 时间戳为编码器时间基(1/fps)下的时隙序号
+        input->pts = outputPts;
+
+        // 编码视频帧，一帧可能输出多个包(B帧、lookahead)
+        int ret = encoder_->encode(input, sink);
+        if (ret < 0) {
+            setError(ret);
+            return false;
+        }
+
+        rateConverter_->keep(input);
+        return true;
+    }
+
+    bool Rendition::writeEncodedPacket(AVPacket* packet) {
+        // 从编码器时间基转换到输出流时间基，同一个包交给每路输出
+        return writeToOutputs(packet, encoder_->getCodecContext()->time_base, true);
+    }
+
+    void Rendition::setError(int error) {
+        int expected = 0;
+        // AVERROR_EXIT表示输出已出错，错误已由输出记录
+        if (error_.compare_exchange_strong(expected, error) && error != AVERROR_EXIT) {
+            utils::printFFmpegError("Rendition " + name_ + " encode error", error);
+        }
+    }
+
+} // namespace ffmpeg_stream
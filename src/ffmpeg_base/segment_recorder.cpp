@@ -0,0 +1,461 @@
+/**
+ * @file segment_recorder.cpp
+ * @brief 分段录像实现
+ */
+
+#include "ffmpeg_base/segment_recorder.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+#include <libavutil/time.h>
+}
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 分段时长的范围(秒)
+        constexpr int kMinSegmentSeconds = 60;
+        constexpr int kMaxSegmentSeconds = 600;
+
+        // 录像队列的最小深度，至少容纳输入源缓存的预录
+        constexpr size_t kMinQueueDepth = 512;
+
+        // 打开或写入分段失败(如磁盘已满)后，等待该时间再尝试新分段
+        constexpr int64_t kRetryDelayUs = 10 * AV_TIME_BASE;
+
+        // 包的时间戳，优先DTS
+        int64_t packetTime(const AVPacket* packet) {
+            return packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        }
+
+        int64_t fileSize(const std::string& path) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            return file.good() ? static_cast<int64_t>(file.tellg()) : 0;
+        }
+    }
+
+    std::mutex SegmentRecorder::registryMutex_;
+    std::vector<SegmentRecorder*> SegmentRecorder::recorders_;
+    std::atomic<int64_t> SegmentRecorder::diskQuota_(0);
+
+    SegmentRecorder::SegmentRecorder(int streamId, const StreamConfig& config)
+            : streamId_(streamId),
+              segmentUs_(static_cast<int64_t>(std::min(std::max(config.recordSegmentSeconds, kMinSegmentSeconds),
+                                                       kMaxSegmentSeconds)) * AV_TIME_BASE),
+              retentionSeconds_(static_cast<int64_t>(std::max(config.recordRetentionHours, 0)) * 3600),
+              maxBytes_(std::max<int64_t>(config.recordMaxBytes, 0)),
+              queueDepth_(std::max(static_cast<size_t>(std::max(config.queueDepth, 1)), kMinQueueDepth)),
+              videoTimeBase_{0, 1},
+              audioTimeBase_{0, 1},
+              recordAudio_(false),
+              videoPacket_(av_packet_alloc()),
+              audioPacket_(av_packet_alloc()),
+              videoPending_(false),
+              audioPending_(false),
+              segmentStartUs_(AV_NOPTS_VALUE),
+              retryAfterUs_(0),
+              segmentDroppedBase_(0),
+              bytes_(0),
+              currentBytes_(0) {
+        std::string root = config.recordPath.empty() ? "recordings" : config.recordPath;
+        directory_ = root + "/" + std::to_string(streamId_);
+
+        if (utils::toLower(config.recordFormat) == "mp4") {
+            format_ = "mp4";
+            extension_ = ".mp4";
+        } else {
+            format_ = "mpegts";
+            extension_ = ".ts";
+        }
+
+        recordStage_ = std::make_unique<StageRunner>("record-" + std::to_string(streamId_));
+
+        // 之前运行留下的分段也参与保留策略
+        if (utils::createDirectory(root) && utils::createDirectory(directory_)) {
+            loadSegments();
+        }
+
+        std::lock_guard<std::mutex> lock(registryMutex_);
+        recorders_.push_back(this);
+    }
+
+    SegmentRecorder::~SegmentRecorder() {
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            recorders_.erase(std::remove(recorders_.begin(), recorders_.end(), this), recorders_.end());
+        }
+        stop();
+        av_packet_free(&videoPacket_);
+        av_packet_free(&audioPacket_);
+    }
+
+    bool SegmentRecorder::start(const std::shared_ptr<StreamSource>& source) {
+        stop();
+
+        AVStream* videoStream = source ? source->getVideoStream() : nullptr;
+        if (!videoStream) {
+            return false;
+        }
+        if (!utils::createDirectory(directory_)) {
+            return false;
+        }
+
+        source_ = source;
+        videoTimeBase_ = videoStream->time_base;
+
+        // 分段格式不能直接封装输入的音频时只录视频，录像从不转码
+        AVStream* audioStream = source_->getAudioStream();
+        recordAudio_ = audioStream &&
+                       StreamOutput::canCarryAudio(StreamOutput::guessFormat(format_, ""),
+                                                   audioStream->codecpar->codec_id);
+        if (audioStream && !recordAudio_) {
+            Logger::warning("Stream %d: %s cannot carry %s audio, recording video only", streamId_,
+                            format_.c_str(), avcodec_get_name(audioStream->codecpar->codec_id));
+        }
+
+        // 从输入源缓存的全部包开始，录像包含订阅之前的预录
+        videoSubscription_ = source_->subscribe(SourceDataType::PACKETS, queueDepth_, QueueOverflowPolicy::DROP_NEWEST,
+                                                [this]() { recordStage_->wake(); }, SourcePreroll::ALL);
+        if (!videoSubscription_) {
+            source_.reset();
+            return false;
+        }
+        if (recordAudio_) {
+            audioSubscription_ = source_->subscribe(SourceDataType::AUDIO_PACKETS, queueDepth_,
+                                                    QueueOverflowPolicy::DROP_NEWEST,
+                                                    [this]() { recordStage_->wake(); }, SourcePreroll::ALL);
+            recordAudio_ = audioSubscription_ != nullptr;
+            audioTimeBase_ = audioStream->time_base;
+        }
+
+        segmentStartUs_ = AV_NOPTS_VALUE;
+        retryAfterUs_ = 0;
+        recordStage_->start([this]() { return recordStep(); });
+
+        Logger::info("Stream %d: recording to %s (%s, %llds segments)", streamId_, directory_.c_str(),
+                     format_.c_str(), static_cast<long long>(segmentUs_ / AV_TIME_BASE));
+        return true;
+    }
+
+    void SegmentRecorder::stop() {
+        recordStage_->stop();
+
+        // 暂存的包写入当前分段后再结束
+        if (videoPending_) {
+            writePacket(videoPacket_, true);
+            videoPending_ = false;
+        }
+        if (audioPending_) {
+            writePacket(audioPacket_, false);
+            audioPending_ = false;
+        }
+        closeSegment();
+
+        if (source_) {
+            if (videoSubscription_) source_->unsubscribe(videoSubscription_);
+            if (audioSubscription_) source_->unsubscribe(audioSubscription_);
+        }
+        videoSubscription_.reset();
+        audioSubscription_.reset();
+        source_.reset();
+        recordAudio_ = false;
+    }
+
+    const std::string& SegmentRecorder::getDirectory() const {
+        return directory_;
+    }
+
+    size_t SegmentRecorder::getSegmentCount() const {
+        std::lock_guard<std::mutex> lock(segmentsMutex_);
+        return segments_.size();
+    }
+
+    int64_t SegmentRecorder::getBytes() const {
+        return bytes_ + currentBytes_;
+    }
+
+    void SegmentRecorder::setDiskQuota(int64_t maxBytes) {
+        diskQuota_ = maxBytes > 0 ? maxBytes : 0;
+    }
+
+    bool SegmentRecorder::recordStep() {
+        if (!videoPending_ && videoSubscription_->packets->pop(videoPacket_)) {
+            videoPending_ = true;
+        }
+        if (audioSubscription_ && !audioPending_ && audioSubscription_->packets->pop(audioPacket_)) {
+            audioPending_ = true;
+        }
+
+        if (!videoPending_ && !audioPending_) {
+            // 输入结束后写完当前分段，重连后由StreamProcessor重新启动
+            if (videoSubscription_->endError != 0) {
+                closeSegment();
+            }
+            return false;
+        }
+
+        // 两路都有包时先写出时间戳较早的，分段切点前的音频留在上一个分段
+        bool video = videoPending_;
+        if (videoPending_ && audioPending_) {
+            int64_t videoTs = packetTime(videoPacket_);
+            int64_t audioTs = packetTime(audioPacket_);
+            video = videoTs == AV_NOPTS_VALUE || audioTs == AV_NOPTS_VALUE ||
+                    av_compare_ts(videoTs, videoTimeBase_, audioTs, audioTimeBase_) <= 0;
+        }
+
+        if (video) {
+            writePacket(videoPacket_, true);
+            videoPending_ = false;
+        } else {
+            writePacket(audioPacket_, false);
+            audioPending_ = false;
+        }
+        return true;
+    }
+
+    void SegmentRecorder::writePacket(AVPacket* packet, bool video) {
+        AVRational timeBase = video ? videoTimeBase_ : audioTimeBase_;
+        int64_t ts = packetTime(packet);
+        int64_t tsUs = ts != AV_NOPTS_VALUE ? av_rescale_q(ts, timeBase, AV_TIME_BASE_Q) : AV_NOPTS_VALUE;
+
+        // 只在视频关键帧处切分，不需要解码；时间戳回退(输入不连续)时也开始新分段
+        if (video && (packet->flags & AV_PKT_FLAG_KEY) && tsUs != AV_NOPTS_VALUE) {
+            bool cut = !output_ || tsUs - segmentStartUs_ >= segmentUs_ || tsUs < segmentStartUs_;
+            if (cut) {
+                closeSegment();
+                if (av_gettime_relative() >= retryAfterUs_) {
+                    openSegment(tsUs);
+                }
+            } else {
+                // 正在写的分段按关键帧更新大小并计入空间上限，配额不会超出一整个分段
+                currentBytes_ = fileSize(segmentPath_);
+                enforceRetention();
+                enforceDiskQuota();
+            }
+        }
+
+        if (!output_ || tsUs == AV_NOPTS_VALUE) {
+            av_packet_unref(packet);
+            return;
+        }
+
+        // 每个分段的时间戳从0开始
+        int64_t offset = av_rescale_q(segmentStartUs_, AV_TIME_BASE_Q, timeBase);
+        if (packet->pts != AV_NOPTS_VALUE) packet->pts -= offset;
+        if (packet->dts != AV_NOPTS_VALUE) packet->dts -= offset;
+        if (packetTime(packet) < 0) {
+            av_packet_unref(packet);
+            return;
+        }
+
+        bool written = video ? output_->write(packet, timeBase) : output_->writeAudio(packet, timeBase);
+        av_packet_unref(packet);
+
+        if (!written) {
+            Logger::error("Stream %d: failed to write recording segment %s", streamId_, segmentPath_.c_str());
+            closeSegment();
+            retryAfterUs_ = av_gettime_relative() + kRetryDelayUs;
+        }
+    }
+
+    bool SegmentRecorder::openSegment(int64_t startUs) {
+        // 先腾出空间再写新分段
+        enforceRetention();
+        enforceDiskQuota();
+
+        // 文件名为分段开始的本地时间，同一秒内重新开始时加序号
+        std::string name = utils::getCurrentTimeString("%Y%m%d_%H%M%S");
+        std::string path = directory_ + "/" + name + extension_;
+        for (int i = 1; utils::fileExists(path); i++) {
+            path = directory_ + "/" + name + "_" + std::to_string(i) + extension_;
+        }
+
+        auto output = std::make_unique<StreamOutput>("record-" + std::to_string(streamId_), path, format_,
+                                                     queueDepth_, QueueOverflowPolicy::DROP_NEWEST);
+
+        // 不依赖尾部：每个包直接落盘，MP4按关键帧分片且moov在文件头
+        std::map<std::string, std::string> options;
+        options["flush_packets"] = "1";
+        if (format_ == "mp4") {
+            options["movflags"] = "frag_keyframe+empty_moov+default_base_moof";
+        }
+        output->setMuxOptions(options);
+
+        const AVCodecParameters* audioParams = recordAudio_ ? source_->getAudioStream()->codecpar : nullptr;
+        if (!output->open(source_->getVideoStream()->codecpar, videoTimeBase_, audioParams, audioTimeBase_)) {
+            Logger::error("Stream %d: failed to open recording segment %s", streamId_, path.c_str());
+            retryAfterUs_ = av_gettime_relative() + kRetryDelayUs;
+            return false;
+        }
+
+        output_ = std::move(output);
+        segmentPath_ = path;
+        segmentStartUs_ = startUs;
+        segmentDroppedBase_ = subscriptionDropped();
+        return true;
+    }
+
+    uint64_t SegmentRecorder::subscriptionDropped() const {
+        uint64_t dropped = videoSubscription_ ? videoSubscription_->packets->droppedCount() : 0;
+        if (audioSubscription_) {
+            dropped += audioSubscription_->packets->droppedCount();
+        }
+        return dropped;
+    }
+
+    void SegmentRecorder::closeSegment() {
+        if (!output_) {
+            return;
+        }
+
+        // 录像不转码也不应丢包，订阅队列或封装队列满时丢到下一个关键帧，分段中会有缺口
+        uint64_t dropped = subscriptionDropped() - segmentDroppedBase_ + output_->getDroppedCount();
+        output_->close();
+        output_.reset();
+        if (dropped > 0) {
+            Logger::warning("Stream %d: recording segment %s is missing %llu packets dropped on full queues",
+                            streamId_, segmentPath_.c_str(), static_cast<unsigned long long>(dropped));
+        }
+
+        int64_t bytes = fileSize(segmentPath_);
+        {
+            std::lock_guard<std::mutex> lock(segmentsMutex_);
+            segments_.push_back(SegmentFile{segmentPath_, std::time(nullptr), bytes});
+        }
+        bytes_ += bytes;
+        currentBytes_ = 0;
+        Logger::debug("Stream %d: finished recording segment %s (%lld bytes)", streamId_, segmentPath_.c_str(),
+                      static_cast<long long>(bytes));
+        segmentPath_.clear();
+
+        enforceRetention();
+        enforceDiskQuota();
+    }
+
+    void SegmentRecorder::loadSegments() {
+        // FFmpeg的file协议在Windows上不支持列目录，这里直接使用std::filesystem
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        fs::directory_iterator it(fs::u8path(directory_), ec);
+        if (ec) {
+            Logger::warning("Stream %d: failed to scan recording directory %s: %s, existing segments are not "
+                            "subject to retention", streamId_, directory_.c_str(), ec.message().c_str());
+            return;
+        }
+
+        std::vector<SegmentFile> found;
+        for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const fs::directory_entry& entry = *it;
+            std::string name = entry.path().filename().u8string();
+            std::error_code typeError;
+            if (!entry.is_regular_file(typeError) || !utils::endsWith(name, extension_)) {
+                continue;
+            }
+
+            std::error_code sizeError;
+            std::uintmax_t size = entry.file_size(sizeError);
+
+            // 文件时间转换为墙钟时间，失败时按刚结束处理
+            std::time_t endTime = std::time(nullptr);
+            std::error_code timeError;
+            fs::file_time_type writeTime = entry.last_write_time(timeError);
+            if (!timeError) {
+                auto systemTime = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                        writeTime - fs::file_time_type::clock::now() + std::chrono::system_clock::now());
+                endTime = std::chrono::system_clock::to_time_t(systemTime);
+            }
+
+            found.push_back(SegmentFile{directory_ + "/" + name, endTime,
+                                        sizeError ? 0 : static_cast<int64_t>(size)});
+        }
+        if (ec) {
+            Logger::warning("Stream %d: error while scanning recording directory %s: %s", streamId_,
+                            directory_.c_str(), ec.message().c_str());
+        }
+
+        // 文件名以开始时间命名，按名称排序即按时间排序
+        std::sort(found.begin(), found.end(), [](const SegmentFile& a, const SegmentFile& b) {
+            return a.path < b.path;
+        });
+
+        std::lock_guard<std::mutex> lock(segmentsMutex_);
+        for (auto& segment : found) {
+            bytes_ += segment.bytes;
+            segments_.push_back(std::move(segment));
+        }
+        if (!found.empty()) {
+            Logger::info("Stream %d: found %zu existing recording segments in %s", streamId_, found.size(),
+                         directory_.c_str());
+        }
+    }
+
+    void SegmentRecorder::enforceRetention() {
+        std::time_t now = std::time(nullptr);
+        std::lock_guard<std::mutex> lock(segmentsMutex_);
+        while (!segments_.empty()) {
+            bool expired = retentionSeconds_ > 0 && now - segments_.front().endTime > retentionSeconds_;
+            bool overLimit = maxBytes_ > 0 && bytes_ + currentBytes_ > maxBytes_;
+            if (!(expired || overLimit) || !removeOldestSegment()) {
+                break;
+            }
+        }
+    }
+
+    bool SegmentRecorder::removeOldestSegment() {
+        if (segments_.empty()) {
+            return false;
+        }
+
+        const SegmentFile& segment = segments_.front();
+        if (std::remove(segment.path.c_str()) != 0 && utils::fileExists(segment.path)) {
+            Logger::warning("Stream %d: failed to remove recording segment %s", streamId_, segment.path.c_str());
+        } else {
+            Logger::info("Stream %d: removed recording segment %s", streamId_, segment.path.c_str());
+        }
+
+        // 删除失败也不再跟踪，避免反复重试同一个文件
+        bytes_ -= segment.bytes;
+        segments_.pop_front();
+        return true;
+    }
+
+    void SegmentRecorder::enforceDiskQuota() {
+        int64_t quota = diskQuota_;
+        if (quota <= 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(registryMutex_);
+        while (true) {
+            // 找出所有流中最早结束的分段
+            int64_t total = 0;
+            SegmentRecorder* oldest = nullptr;
+            std::time_t oldestTime = 0;
+            for (SegmentRecorder* recorder : recorders_) {
+                total += recorder->bytes_ + recorder->currentBytes_;
+                std::lock_guard<std::mutex> segmentsLock(recorder->segmentsMutex_);
+                if (!recorder->segments_.empty() &&
+                    (!oldest || recorder->segments_.front().endTime < oldestTime)) {
+                    oldest = recorder;
+                    oldestTime = recorder->segments_.front().endTime;
+                }
+            }
+
+            if (total <= quota || !oldest) {
+                break;
+            }
+
+            std::lock_guard<std::mutex> segmentsLock(oldest->segmentsMutex_);
+            oldest->removeOldestSegment();
+        }
+    }
+
+} // namespace ffmpeg_stream
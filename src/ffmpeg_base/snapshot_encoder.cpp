@@ -0,0 +1,135 @@
+/**
+ * @file snapshot_encoder.cpp
+ * @brief JPEG快照编码器实现
+ */
+
+#include "ffmpeg_base/snapshot_encoder.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 默认JPEG质量，缩略图场景下文件小且肉眼无明显损失
+        constexpr int kDefaultQuality = 5;
+
+        // 按宽高比推算缺失的一边，结果取偶数(YUV420要求)
+        int scaleDimension(int dst, int srcThis, int srcOther) {
+            int value = static_cast<int>(static_cast<int64_t>(dst) * srcThis / std::max(srcOther, 1));
+            return std::max(value & ~1, 2);
+        }
+    }
+
+    SnapshotEncoder::SnapshotEncoder()
+            : codecContext(nullptr), scaledFrame(av_frame_alloc()), encodedPacket(av_packet_alloc()),
+              quality(kDefaultQuality) {
+    }
+
+    SnapshotEncoder::~SnapshotEncoder() {
+        cleanup();
+        av_frame_free(&scaledFrame);
+        av_packet_free(&encodedPacket);
+    }
+
+    void SnapshotEncoder::setQuality(int qscale) {
+        quality = std::min(std::max(qscale, 2), 31);
+    }
+
+    bool SnapshotEncoder::encode(const AVFrame* frame, int width, int height, std::vector<uint8_t>& jpeg) {
+        if (!frame || frame->width <= 0 || frame->height <= 0) {
+            return false;
+        }
+
+        // 计算输出尺寸
+        if (width <= 0 && height <= 0) {
+            width = frame->width & ~1;
+            height = frame->height & ~1;
+        } else if (width <= 0) {
+            width = scaleDimension(height, frame->width, frame->height);
+        } else if (height <= 0) {
+            height = scaleDimension(width, frame->height, frame->width);
+        }
+        width = std::max(width & ~1, 2);
+        height = std::max(height & ~1, 2);
+
+        if (!openEncoder(width, height)) {
+            return false;
+        }
+
+        // 转换到编码器的尺寸和像素格式，每次使用新的缓冲区
+        av_frame_unref(scaledFrame);
+        scaler.setTarget(width, height, codecContext->pix_fmt);
+        int ret = scaler.scale(frame, scaledFrame);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to scale snapshot frame", ret);
+            return false;
+        }
+        scaledFrame->pts = 0;
+        scaledFrame->quality = codecContext->global_quality;
+        scaledFrame->pict_type = AV_PICTURE_TYPE_NONE;
+
+        ret = avcodec_send_frame(codecContext, scaledFrame);
+        av_frame_unref(scaledFrame);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to send snapshot frame", ret);
+            return false;
+        }
+
+        ret = avcodec_receive_packet(codecContext, encodedPacket);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to encode snapshot", ret);
+            return false;
+        }
+
+        jpeg.assign(encodedPacket->data, encodedPacket->data + encodedPacket->size);
+        av_packet_unref(encodedPacket);
+        return true;
+    }
+
+    bool SnapshotEncoder::openEncoder(int width, int height) {
+        if (codecContext && codecContext->width == width && codecContext->height == height &&
+            codecContext->global_quality == FF_QP2LAMBDA * quality) {
+            return true;
+        }
+        cleanup();
+
+        const AVCodec* encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        if (!encoder) {
+            Logger::error("MJPEG encoder not found");
+            return false;
+        }
+
+        codecContext = avcodec_alloc_context3(encoder);
+        if (!codecContext) {
+            Logger::error("Failed to allocate snapshot encoder context");
+            return false;
+        }
+
+        // MJPEG每帧独立编码，同一尺寸的编码器可以一直复用
+        codecContext->width = width;
+        codecContext->height = height;
+        codecContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        codecContext->time_base = AVRational{1, 25};
+        codecContext->flags |= AV_CODEC_FLAG_QSCALE;
+        codecContext->global_quality = FF_QP2LAMBDA * quality;
+
+        int ret = avcodec_open2(codecContext, encoder, nullptr);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to open snapshot encoder", ret);
+            cleanup();
+            return false;
+        }
+
+        return true;
+    }
+
+    void SnapshotEncoder::cleanup() {
+        if (codecContext) {
+            avcodec_free_context(&codecContext);
+            codecContext = nullptr;
+        }
+        scaler.cleanup();
+    }
+
+} // namespace ffmpeg_stream
@@ -6,14 +6,53 @@
 #include "ffmpeg_base/stream_manager.h"
 #include "logger/logger.h"
 #include "common/utils.h"
+#include <algorithm>
+#include <set>
 
 namespace ffmpeg_stream {
 
+    namespace {
+        // 没有流时I/O调度器保留的线程数，用于输出重新打开等定时任务
+        constexpr size_t kMinIOThreads = 2;
+
+        // 未加载配置时同时进行的重连打开数
+        constexpr size_t kDefaultConcurrentReconnects = 4;
+
+        // 估算可能同时阻塞在I/O上的阶段数：每个输入源一个读取阶段(键与SourceRegistry相同，共享输入源的流只算一次)，
+        // 每个推流输出和每个录像各一个写入阶段。RTSP等输入不支持非阻塞读取，等待下一个包时会一直占用I/O工作线程，
+        // I/O线程数少于该值时超出的输入只能排队读取
+        size_t countBlockingIOStages(const std::vector<StreamConfig>& streams) {
+            std::set<std::string> sources;
+            size_t outputs = 0;
+            for (const auto& stream : streams) {
+                sources.insert(SourceRegistry::makeKey(stream));
+                if (stream.recordEnabled) {
+                    outputs += 1;
+                }
+                if (stream.type == StreamType::PUSH) {
+                    outputs += 1 + stream.extraOutputs.size();
+                    for (const auto& rendition : stream.renditions) {
+                        outputs += 1 + rendition.extraOutputs.size();
+                    }
+                }
+            }
+            return sources.size() + outputs;
+        }
+    }
+
     StreamManager::StreamManager(size_t threadPoolSize)
-            : nextStreamId_(0), monitorRunning_(false), monitorInterval_(5000) {
+            : streamInfoCache_(std::make_shared<StreamInfoCache>()),
+              sourceRegistry_(std::make_shared<SourceRegistry>(streamInfoCache_)),
+              nextStreamId_(0), ioThreadPoolSize_(0), monitorRunning_(false), monitorInterval_(5000) {
 
-        // 初始化线程池
+        // 初始化线程池和流处理调度器
         threadPool_ = std::make_unique<ThreadPool>(threadPoolSize);
+        reconnectPool_ = std::make_unique<ThreadPool>(kDefaultConcurrentReconnects);
+        Scheduler::getInstance().resize(threadPoolSize);
+        {
+            std::lock_guard<std::mutex> lock(streamsMutex_);
+            updateIOSchedulerSize();
+        }
 
         // 注册所有编解码器和格式
         avformat_network_init();
@@ -22,6 +61,10 @@ namespace ffmpeg_stream {
     }
 
     StreamManager::~StreamManager() {
+        // 先断开观看者，再停止它们订阅的流
+        if (httpServer_) {
+            httpServer_->stop();
+        }
         stopAll();
         avformat_network_deinit();
 
@@ -43,6 +86,54 @@ namespace ffmpeg_stream {
 
         // 调整线程池大小
         resizeThreadPool(config.threadPoolSize);
+        if (config.maxConcurrentReconnects > 0) {
+            reconnectPool_->resize(config.maxConcurrentReconnects);
+        }
+        {
+            // 添加流时按流数量调整I/O调度器
+            std::lock_guard<std::mutex> lock(streamsMutex_);
+            ioThreadPoolSize_ = config.ioThreadPoolSize > 0 ? config.ioThreadPoolSize : 0;
+            updateIOSchedulerSize();
+        }
+
+        // 加载流参数缓存，已知参数的输入冷启动时也只做最小探测
+        streamInfoCachePath_.clear();
+        if (!config.streamInfoCacheFile.empty()) {
+            streamInfoCachePath_ = config.streamInfoCacheFile;
+            size_t slash = configFilePath.find_last_of("/\\");
+            bool absolute = streamInfoCachePath_[0] == '/' || streamInfoCachePath_.find(':') != std::string::npos;
+            if (!absolute && slash != std::string::npos) {
+                streamInfoCachePath_ = configFilePath.substr(0, slash + 1) + streamInfoCachePath_;
+            }
+            if (utils::fileExists(streamInfoCachePath_)) {
+                streamInfoCache_->loadFromFile(streamInfoCachePath_);
+            }
+        }
+
+        // 所有输入源的包缓存共用一个内存上限
+        GopCache::setGlobalLimit(config.gopCacheTotalBytes);
+
+        // 所有流的录像共用一个磁盘配额
+        SegmentRecorder::setDiskQuota(config.recordDiskQuotaBytes);
+
+        // 内置HTTP分发服务器，观看者直接订阅流的输入源
+        if (config.httpServerEnabled && !httpServer_) {
+            httpServer_ = std::make_unique<HttpStreamServer>([this](int streamId) -> std::shared_ptr<StreamSource> {
+                std::lock_guard<std::mutex> lock(streamsMutex_);
+                auto it = streams_.find(streamId);
+                return it != streams_.end() ? it->second->getSource() : nullptr;
+            });
+
+            HttpServerOptions options;
+            options.bindAddress = config.httpServerBindAddress;
+            options.port = config.httpServerPort;
+            options.maxClients = config.httpMaxClients;
+            options.clientQueueDepth = config.httpClientQueueDepth > 0 ? config.httpClientQueueDepth : 1;
+            options.clientTimeoutMs = config.httpClientTimeoutMs;
+            if (!httpServer_->start(options)) {
+                httpServer_.reset();
+            }
+        }
 
         // 启动监控
         startMonitoring(config.monitorInterval);
@@ -76,11 +167,8 @@ namespace ffmpeg_stream {
         std::lock_guard<std::mutex> lock(streamsMutex_);
         int streamId = config.id >= 0 ? config.id : getNextStreamId();
 
-        // 创建流处理器
-        auto processor = std::make_shared<StreamProcessor>(
-                streamId, config, statusCb, frameCb);
-
-        streams_[streamId] = processor;
+        streams_[streamId] = createProcessor(streamId, config, statusCb, frameCb);
+        updateIOSchedulerSize();
 
         Logger::info("Added pull stream %d: %s", streamId, config.name.c_str());
         return streamId;
@@ -102,11 +190,8 @@ namespace ffmpeg_stream {
         std::lock_guard<std::mutex> lock(streamsMutex_);
         int streamId = config.id >= 0 ? config.id : getNextStreamId();
 
-        // 创建流处理器
-        auto processor = std::make_shared<StreamProcessor>(
-                streamId, config, statusCb);
-
-        streams_[streamId] = processor;
+        streams_[streamId] = createProcessor(streamId, config, statusCb, nullptr);
+        updateIOSchedulerSize();
 
         Logger::info("Added push stream %d: %s", streamId, config.name.c_str());
         return streamId;
@@ -138,41 +223,13 @@ namespace ffmpeg_stream {
         }
 
         auto processor = it->second;
+        lock.unlock();
 
-        // 检查是否已有任务正在运行
-        auto taskIt = streamTasks_.find(streamId);
-        if (taskIt != streamTasks_.end()) {
-            // 检查任务是否已完成
-            auto& task = taskIt->second;
-            if (task.valid()) {
-                auto status = task.wait_for(std::chrono::milliseconds(0));
-                if (status != std::future_status::ready) {
-                    Logger::warning("Stream %d is already running", streamId);
-                    return false;
-                }
-            }
-        }
-
-        // 启动流处理器
+        // 启动流处理器，处理任务随之加入调度器
         if (!processor->start()) {
             return false;
         }
 
-        // 在线程池中提交处理任务
-        lock.unlock();  // 解锁以避免提交任务时死锁
-
-        auto future = threadPool_->enqueue(
-                // 高优先级任务
-                TaskPriority::HIGH,
-                // 传递StreamProcessor的共享指针到处理循环
-                &StreamManager::streamProcessingLoop,
-                this,
-                processor
-        );
-
-        lock.lock();
-        streamTasks_[streamId] = std::move(future);
-
         Logger::info("Started stream %d", streamId);
         return true;
     }
@@ -187,15 +244,9 @@ namespace ffmpeg_stream {
 
         auto processor = it->second;
 
-        // 通知处理器停止
+        // 通知处理器停止，处理任务随之从调度器移除
         processor->stop();
 
-        // 移除任务
-        auto taskIt = streamTasks_.find(streamId);
-        if (taskIt != streamTasks_.end()) {
-            streamTasks_.erase(taskIt);
-        }
-
         Logger::info("Stopped stream %d", streamId);
         return true;
     }
@@ -219,6 +270,9 @@ namespace ffmpeg_stream {
 
         // 等待所有任务完成
         threadPool_->waitAll();
+        reconnectPool_->waitAll();
+
+        saveStreamInfoCache();
 
         Logger::info("All streams stopped");
     }
@@ -233,6 +287,74 @@ namespace ffmpeg_stream {
         return it->second->getStatus();
     }
 
+    StreamStats StreamManager::getStreamStats(int streamId) {
+        std::lock_guard<std::mutex> lock(streamsMutex_);
+        auto it = streams_.find(streamId);
+        if (it == streams_.end()) {
+            return StreamStats();
+        }
+
+        return it->second->getStats();
+    }
+
+    std::shared_ptr<FrameSubscriber> StreamManager::subscribeFrames(int streamId, const FrameHandler& handler,
+                                                                    const FrameSubscriberOptions& options) {
+        std::shared_ptr<StreamProcessor> processor;
+        {
+            std::lock_guard<std::mutex> lock(streamsMutex_);
+            auto it = streams_.find(streamId);
+            if (it == streams_.end()) {
+                Logger::error("Stream ID %d not found", streamId);
+                return nullptr;
+            }
+            processor = it->second;
+        }
+
+        return processor->subscribeFrames(handler, options);
+    }
+
+    bool StreamManager::unsubscribeFrames(int streamId, const std::shared_ptr<FrameSubscriber>& subscriber) {
+        std::shared_ptr<StreamProcessor> processor;
+        {
+            std::lock_guard<std::mutex> lock(streamsMutex_);
+            auto it = streams_.find(streamId);
+            if (it == streams_.end()) {
+                return false;
+            }
+            processor = it->second;
+        }
+
+        // 停止订阅者可能等待一次回调返回，不持有streamsMutex_
+        processor->unsubscribeFrames(subscriber);
+        return true;
+    }
+
+    std::vector<uint8_t> StreamManager::getSnapshot(int streamId, int width, int height) {
+        std::shared_ptr<StreamProcessor> processor;
+        {
+            std::lock_guard<std::mutex> lock(streamsMutex_);
+            auto it = streams_.find(streamId);
+            if (it == streams_.end()) {
+                return {};
+            }
+            processor = it->second;
+        }
+
+        // 编码在调用线程上进行，不持有streamsMutex_
+        return processor->getSnapshot(width, height);
+    }
+
+    bool StreamManager::setDecodeMode(int streamId, DecodeMode mode, int frameInterval, bool fastDecode) {
+        std::lock_guard<std::mutex> lock(streamsMutex_);
+        auto it = streams_.find(streamId);
+        if (it == streams_.end()) {
+            Logger::error("Stream ID %d not found", streamId);
+            return false;
+        }
+
+        return it->second->setDecodeMode(mode, frameInterval, fastDecode);
+    }
+
     StreamConfig StreamManager::getStreamConfig(int streamId) {
         std::lock_guard<std::mutex> lock(streamsMutex_);
         auto it = streams_.find(streamId);
@@ -251,11 +373,38 @@ namespace ffmpeg_stream {
             return false;
         }
 
-        return it->second->updateConfig(config);
+        if (!it->second->updateConfig(config)) {
+            return false;
+        }
+        updateIOSchedulerSize();
+        return true;
+    }
+
+    void StreamManager::updateIOSchedulerSize() {
+        std::vector<StreamConfig> configs;
+        configs.reserve(streams_.size());
+        for (const auto& pair : streams_) {
+            configs.push_back(pair.second->getConfig());
+        }
+        size_t blockingStages = countBlockingIOStages(configs);
+
+        // 配置了固定线程数时只检查是否足够，否则按阶段数伸缩
+        size_t numThreads = ioThreadPoolSize_ > 0 ? static_cast<size_t>(ioThreadPoolSize_)
+                                                  : std::max(blockingStages, kMinIOThreads);
+        if (Scheduler::getIOInstance().size() != numThreads) {
+            Scheduler::getIOInstance().resize(numThreads);
+            Logger::info("I/O scheduler uses %zu threads for %zu input/output stages", numThreads, blockingStages);
+        }
+        if (numThreads < blockingStages) {
+            Logger::warning("ioThreadPoolSize %d is below the %zu input/output stages; "
+                            "blocking inputs such as RTSP will wait for a free I/O thread",
+                            ioThreadPoolSize_, blockingStages);
+        }
     }
 
     void StreamManager::resizeThreadPool(size_t numThreads) {
         threadPool_->resize(numThreads);
+        Scheduler::getInstance().resize(numThreads);
         Logger::info("Thread pool resized to %zu threads", numThreads);
     }
 
@@ -307,67 +456,84 @@ namespace ffmpeg_stream {
         return ConfigManager::getInstance().saveToFile(filePath);
     }
 
-    void StreamManager::streamProcessingLoop(std::shared_ptr<StreamProcessor> processor) {
-        int streamId = processor->getId();
-        StreamType type = processor->getConfig().type;
+    std::shared_ptr<StreamProcessor> StreamManager::createProcessor(int streamId, const StreamConfig& config,
+                                                                   const StatusCallback& statusCb,
+                                                                   const FrameCallback& frameCb) {
+        auto processor = std::make_shared<StreamProcessor>(
+                streamId, config, statusCb, frameCb, sourceRegistry_);
+
+        // 回调在调度器工作线程上执行，不能持有streamsMutex_，也不能阻塞
+        std::weak_ptr<StreamProcessor> weakProcessor = processor;
+        processor->setEndCallback([this, weakProcessor]() {
+            if (auto p = weakProcessor.lock()) {
+                scheduleReconnect(p);
+            }
+        });
 
-        Logger::debug("Stream processing loop started for stream %d", streamId);
+        return processor;
+    }
 
-        while (processor->getStatus() != StreamStatus::STOPPED) {
-            bool continueProcessing = false;
+    void StreamManager::scheduleReconnect(const std::shared_ptr<StreamProcessor>& processor) {
+        int delayMs = processor->nextReconnectDelay();
+        if (delayMs < 0) {
+            return;
+        }
 
-            // 根据流类型调用不同的处理函数
-            if (type == StreamType::PULL) {
-                continueProcessing = processor->processPull();
-            } else {
-                continueProcessing = processor->processPush();
+        // 等待由调度器定时完成，不占用任何线程；流已被移除时定时到期后直接放弃
+        std::weak_ptr<StreamProcessor> weakProcessor = processor;
+        Scheduler::getInstance().runAfter(std::chrono::milliseconds(delayMs), [this, weakProcessor]() {
+            auto p = weakProcessor.lock();
+            if (!p || p->getStatus() == StreamStatus::STOPPED) {
+                return;
             }
 
-            // 如果处理失败，尝试重连
-            if (!continueProcessing) {
-                if (processor->getStatus() != StreamStatus::STOPPED) {
-                    if (!processor->handleReconnect()) {
-                        // 重连失败，退出循环
-                        break;
+            // 打开输入可能阻塞到网络超时，放到重连线程池中执行，不占用调度器工作线程和通用线程池；
+            // 大量输入同时断开时重连按线程数分批进行
+            reconnectPool_->enqueue(
+                    TaskPriority::HIGH,
+                    [this, p]() {
+                        if (!p->handleReconnect() && p->getStatus() != StreamStatus::STOPPED) {
+                            // 本次重连失败，按退避策略继续尝试
+                            scheduleReconnect(p);
+                        }
                     }
-                } else {
-                    // 已手动停止，退出循环
-                    break;
-                }
-            }
+            );
+        });
+    }
 
-            // 短暂休眠，避免CPU使用率过高
-            // 对于实时流，应当保持非常短的休眠时间
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    void StreamManager::saveStreamInfoCache() {
+        if (!streamInfoCachePath_.empty()) {
+            streamInfoCache_->saveToFile(streamInfoCachePath_);
         }
-
-        Logger::debug("Stream processing loop ended for stream %d", streamId);
     }
 
     void StreamManager::checkStreams() {
+        // 重连中学到的新参数定期落盘
+        saveStreamInfoCache();
+
         std::lock_guard<std::mutex> lock(streamsMutex_);
 
         for (auto& pair : streams_) {
             auto& processor = pair.second;
 
             if (processor->getStatus() == StreamStatus::CONNECTED) {
+                // 输出延迟和丢帧统计
+                StreamStats stats = processor->getStats();
+                if (stats.nonRefDropped > 0 || stats.gopDropped > 0 || stats.queueDropped > 0) {
+                    Logger::debug("Stream %d latency %lld ms, dropped nonref=%llu gop=%llu queue=%llu",
+                                  processor->getId(), static_cast<long long>(stats.latencyMs),
+                                  static_cast<unsigned long long>(stats.nonRefDropped),
+                                  static_cast<unsigned long long>(stats.gopDropped),
+                                  static_cast<unsigned long long>(stats.queueDropped));
+                }
+
                 // 检查是否超时
                 if (processor->isTimeout(30)) {
                     Logger::warning("Stream %d timed out, attempting to reconnect", processor->getId());
 
-                    // 停止当前流处理器
-                    processor->stop();
-
-                    // 在线程池中提交重连任务
-                    threadPool_->enqueue(
-                            TaskPriority::HIGH,
-                            [this, processor]() {
-                                if (processor->handleReconnect()) {
-                                    // 重连成功，继续处理
-                                    streamProcessingLoop(processor);
-                                }
-                            }
-                    );
+                    // 先打断阻塞中的I/O，再在重连线程池中重连
+                    processor->interrupt();
+                    scheduleReconnect(processor);
                 }
             }
         }
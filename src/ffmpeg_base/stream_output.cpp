@@ -0,0 +1,304 @@
+/**
+ * @file stream_output.cpp
+ * @brief 单路输出实现
+ */
+
+#include "ffmpeg_base/stream_output.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <cstring>
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 关闭时写出剩余数据和尾部的总超时
+        constexpr int kCloseTimeoutMs = 1000;
+    }
+
+    StreamOutput::StreamOutput(const std::string& name, const std::string& url, const std::string& format,
+                               size_t queueDepth, QueueOverflowPolicy policy,
+                               int ioTimeoutMs, const IOInterrupter* interrupter)
+            : name_(name),
+              url_(url),
+              format_(format),
+              formatContext_(nullptr),
+              opened_(false),
+              parentInterrupter_(interrupter),
+              ioTimeoutMs_(ioTimeoutMs),
+              audioStreamIndex_(-1),
+              muxPacket_(av_packet_alloc()),
+              error_(0) {
+        queue_ = std::make_unique<PacketQueue>(queueDepth > 0 ? queueDepth : 1, policy);
+        audioQueue_ = std::make_unique<PacketQueue>(queueDepth > 0 ? queueDepth : 1, policy);
+        // 网络写入可能阻塞到写入超时，运行在I/O调度器上
+        muxStage_ = std::make_unique<StageRunner>(name_ + "-mux", std::chrono::microseconds(10000),
+                                                  &Scheduler::getIOInstance());
+    }
+
+    StreamOutput::~StreamOutput() {
+        close();
+        av_packet_free(&muxPacket_);
+    }
+
+    void StreamOutput::setMuxOptions(const std::map<std::string, std::string>& options) {
+        muxOptions_ = options;
+    }
+
+    bool StreamOutput::open(const AVCodecParameters* codecParams, AVRational timeBase,
+                            const AVCodecParameters* audioParams, AVRational audioTimeBase) {
+        if (opened_) {
+            return true;
+        }
+
+        // 创建输出格式上下文
+        avformat_alloc_output_context2(&formatContext_, nullptr,
+                                       format_.empty() ? nullptr : format_.c_str(), url_.c_str());
+        if (!formatContext_) {
+            Logger::error("Failed to create output context for %s", url_.c_str());
+            return false;
+        }
+
+        interrupter_.reset();
+        interrupter_.setParent(parentInterrupter_);
+        interrupter_.install(formatContext_);
+
+        // 创建输出流
+        AVStream* outStream = avformat_new_stream(formatContext_, nullptr);
+        if (!outStream) {
+            Logger::error("Failed to create output stream for %s", url_.c_str());
+            freeContext();
+            return false;
+        }
+
+        int ret = avcodec_parameters_copy(outStream->codecpar, codecParams);
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to copy codec parameters", ret);
+            error_ = ret;
+            freeContext();
+            return false;
+        }
+        outStream->codecpar->codec_tag = 0;
+        outStream->time_base = timeBase;
+
+        // 创建音频流
+        audioStreamIndex_ = -1;
+        if (audioParams) {
+            AVStream* audioStream = avformat_new_stream(formatContext_, nullptr);
+            if (!audioStream) {
+                Logger::error("Failed to create audio stream for %s", url_.c_str());
+                freeContext();
+                return false;
+            }
+
+            ret = avcodec_parameters_copy(audioStream->codecpar, audioParams);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to copy audio codec parameters", ret);
+                error_ = ret;
+                freeContext();
+                return false;
+            }
+            audioStream->codecpar->codec_tag = 0;
+            audioStream->time_base = audioTimeBase.num > 0 ? audioTimeBase
+                                                           : AVRational{1, audioParams->sample_rate};
+            audioStreamIndex_ = audioStream->index;
+        }
+
+        // 打开输出URL，连接过程可被中断
+        if (!(formatContext_->oformat->flags & AVFMT_NOFILE)) {
+            IODeadline deadline(interrupter_, ioTimeoutMs_);
+            ret = avio_open2(&formatContext_->pb, url_.c_str(), AVIO_FLAG_WRITE,
+                             &formatContext_->interrupt_callback, nullptr);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to open output file", ret);
+                error_ = ret;
+                freeContext();
+                return false;
+            }
+        }
+
+        // 写入流头信息
+        AVDictionary* options = nullptr;
+        for (const auto& [key, value] : muxOptions_) {
+            av_dict_set(&options, key.c_str(), value.c_str(), 0);
+        }
+        {
+            IODeadline deadline(interrupter_, ioTimeoutMs_);
+            ret = avformat_write_header(formatContext_, &options);
+        }
+        av_dict_free(&options);
+
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to write header", ret);
+            error_ = ret;
+            freeContext();
+            return false;
+        }
+
+        error_ = 0;
+        queue_->reset();
+        audioQueue_->reset();
+        muxStage_->start([this]() { return muxStep(); });
+        opened_ = true;
+
+        Logger::info("Opened output %s (%s)", url_.c_str(), name_.c_str());
+        return true;
+    }
+
+    bool StreamOutput::write(AVPacket* packet, AVRational srcTimeBase) {
+        if (!opened_ || error_ != 0) {
+            return false;
+        }
+
+        // 从源时间基转换到输出流时间基
+        av_packet_rescale_ts(packet, srcTimeBase, formatContext_->streams[0]->time_base);
+        packet->stream_index = 0;
+        packet->pos = -1;
+
+        // 队列满被丢弃不算错误
+        if (queue_->push(packet)) {
+            muxStage_->wake();
+        }
+        return true;
+    }
+
+    bool StreamOutput::writeAudio(AVPacket* packet, AVRational srcTimeBase) {
+        if (!opened_ || error_ != 0 || audioStreamIndex_ < 0) {
+            return false;
+        }
+
+        av_packet_rescale_ts(packet, srcTimeBase, formatContext_->streams[audioStreamIndex_]->time_base);
+        packet->stream_index = audioStreamIndex_;
+        packet->pos = -1;
+
+        if (audioQueue_->push(packet)) {
+            muxStage_->wake();
+        }
+        return true;
+    }
+
+    void StreamOutput::close() {
+        // 停止封装阶段，剩余的包直接写出
+        muxStage_->stop();
+
+        if (opened_) {
+            // 父中断器只用于打断运行中的写入，收尾使用自己的截止时间
+            interrupter_.setParent(nullptr);
+            IODeadline deadline(interrupter_, kCloseTimeoutMs);
+
+            for (PacketQueue* queue : {queue_.get(), audioQueue_.get()}) {
+                while (queue->pop(muxPacket_)) {
+                    if (error_ == 0) {
+                        int ret = av_interleaved_write_frame(formatContext_, muxPacket_);
+                        if (ret < 0) {
+                            error_ = ret;
+                        }
+                    }
+                    av_packet_unref(muxPacket_);
+                }
+            }
+
+            // 写入流尾部
+            av_write_trailer(formatContext_);
+            Logger::info("Closed output %s (%s)", url_.c_str(), name_.c_str());
+        }
+
+        queue_->reset();
+        audioQueue_->reset();
+        freeContext();
+        audioStreamIndex_ = -1;
+        opened_ = false;
+    }
+
+    int StreamOutput::getError() const {
+        return error_;
+    }
+
+    uint64_t StreamOutput::getDroppedCount() const {
+        return queue_->droppedCount() + audioQueue_->droppedCount();
+    }
+
+    bool StreamOutput::isOpened() const {
+        return opened_;
+    }
+
+    const std::string& StreamOutput::getUrl() const {
+        return url_;
+    }
+
+    bool StreamOutput::hasAudio() const {
+        return audioStreamIndex_ >= 0;
+    }
+
+    const AVOutputFormat* StreamOutput::guessFormat(const std::string& format, const std::string& url) {
+        return av_guess_format(format.empty() ? nullptr : format.c_str(), url.c_str(), nullptr);
+    }
+
+    bool StreamOutput::canCarryAudio(const AVOutputFormat* format, AVCodecID codecId) {
+        if (!format) {
+            return true;
+        }
+
+        // FLV只能可靠地承载AAC和MP3(avformat_query_codec对flv不可用)
+        if (std::strcmp(format->name, "flv") == 0) {
+            return codecId == AV_CODEC_ID_AAC || codecId == AV_CODEC_ID_MP3;
+        }
+
+        int ret = avformat_query_codec(format, codecId, FF_COMPLIANCE_NORMAL);
+        if (ret >= 0) {
+            return ret == 1;
+        }
+        // 封装器不支持查询时，只信任常见编码和格式默认编码
+        return codecId == AV_CODEC_ID_AAC || codecId == AV_CODEC_ID_MP3 || codecId == format->audio_codec;
+    }
+
+    bool StreamOutput::muxStep() {
+        if (error_ != 0) {
+            return false;
+        }
+
+        // 每步从两个队列各取一个包，视频持续积压时音频也不会被饿死
+        bool progressed = false;
+        for (PacketQueue* queue : {queue_.get(), audioQueue_.get()}) {
+            if (error_ != 0 || !queue->pop(muxPacket_)) {
+                continue;
+            }
+            progressed = true;
+
+            // av_interleaved_write_frame会接管包的引用
+            int ret;
+            {
+                IODeadline deadline(interrupter_, ioTimeoutMs_);
+                ret = av_interleaved_write_frame(formatContext_, muxPacket_);
+            }
+            if (ret < 0) {
+                setError(ret);
+            }
+        }
+
+        return progressed;
+    }
+
+    void StreamOutput::setError(int error) {
+        int expected = 0;
+        if (error_.compare_exchange_strong(expected, error)) {
+            // 被中止时不是真正的写入错误
+            if (!interrupter_.isAborted()) {
+                utils::printFFmpegError("Error writing frame", error);
+            }
+            // 解除可能阻塞在队列上的生产者
+            queue_->abort();
+            audioQueue_->abort();
+        }
+    }
+
+    void StreamOutput::freeContext() {
+        if (formatContext_) {
+            if (!(formatContext_->oformat->flags & AVFMT_NOFILE)) {
+                avio_closep(&formatContext_->pb);
+            }
+            avformat_free_context(formatContext_);
+            formatContext_ = nullptr;
+        }
+    }
+
+} // namespace ffmpeg_stream
@@ -6,7 +6,7 @@
 #include "ffmpeg_base/stream_processor.h"
 #include "logger/logger.h"
 #include "common/utils.h"
-#include <thread>
+#include <algorithm>
 
 extern "C" {
 #include <libavutil/time.h>
@@ -14,38 +14,109 @@ extern "C" {
 
 namespace ffmpeg_stream {
 
+    namespace {
+        // 连接保持这么久(微秒)后断开，重连退避从头计算
+        constexpr int64_t kStableConnectionUs = 30 * 1000000LL;
+    }
+
     StreamProcessor::StreamProcessor(int id, const StreamConfig& config,
                                      const StatusCallback& statusCallback,
-                                     const FrameCallback& frameCallback)
+                                     const FrameCallback& frameCallback,
+                                     std::shared_ptr<SourceRegistry> sourceRegistry)
             : id_(id),
               config_(config),
               status_(StreamStatus::DISCONNECTED),
               running_(false),
               statusCallback_(statusCallback),
               frameCallback_(frameCallback),
-              reconnectCount_(0),
+              frameSubscriberCount_(0),
+              nextSubscriberId_(0),
+              reconnectPending_(false),
+              lastError_(0),
+              connectedTimeUs_(0),
               lastActiveTime_(std::chrono::steady_clock::now()),
-              inputFormatContext_(nullptr),
-              outputFormatContext_(nullptr),
-              videoStreamIndex_(-1),
+              sourceRegistry_(sourceRegistry),
               inputOpened_(false),
               outputOpened_(false),
-              ptsOffset_(0) {
+              packet_(av_packet_alloc()),
+              copyPacket_(av_packet_alloc()),
+              frame_(av_frame_alloc()),
+              decimateNonRef_(false),
+              decodeMode_(config.decodeMode),
+              decodeFrameInterval_(std::max(config.decodeFrameInterval, 1)),
+              fastDecode_(config.fastDecode),
+              nonRefDropped_(0),
+              gopDropped_(0),
+              queueDropped_(0) {
+        // 未提供注册表时使用私有注册表，输入不与其他流共享
+        if (!sourceRegistry_) {
+            sourceRegistry_ = std::make_shared<SourceRegistry>();
+        }
+        processStage_ = std::make_unique<StageRunner>("stream-" + std::to_string(id_) + "-process");
+
+        // 旧接口的帧回调：每次回调给一个独立的引用，回调修改帧不影响其他订阅者。
+        // 回调跟不上时丢弃最早的帧，BLOCK会让共享的处理工作线程等待慢回调，拖慢其他流
+        if (frameCallback_) {
+            FrameSubscriberOptions options;
+            options.queueDepth = 2;
+            options.policy = QueueOverflowPolicy::DROP_OLDEST;
+            std::shared_ptr<AVFrame> callbackFrame(av_frame_alloc(), [](AVFrame* f) { av_frame_free(&f); });
+            FrameCallback callback = frameCallback_;
+            subscribeFrames([callback, callbackFrame](int streamId, const FrameHandle& frame) {
+                if (av_frame_ref(callbackFrame.get(), frame.get()) < 0) {
+                    return;
+                }
+                callback(streamId, callbackFrame.get());
+                av_frame_unref(callbackFrame.get());
+            }, options);
+        }
     }
 
     StreamProcessor::~StreamProcessor() {
         stop();
         cleanup();
+
+        std::vector<std::shared_ptr<FrameSubscriber>> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(frameSubscribersMutex_);
+            subscribers.swap(frameSubscribers_);
+            frameSubscriberCount_ = 0;
+        }
+        for (auto& subscriber : subscribers) {
+            subscriber->stop();
+        }
+
+        av_packet_free(&packet_);
+        av_packet_free(&copyPacket_);
+        av_frame_free(&frame_);
     }
 
     bool StreamProcessor::start() {
+        std::lock_guard<std::mutex> lock(lifecycleMutex_);
         if (running_) {
             Logger::warning("Stream %d is already running", id_);
             return false;
         }
 
+        reconnectPolicy_.configure(config_.reconnectDelay, config_.reconnectMaxDelay, config_.maxReconnects);
+        reconnectPolicy_.reset();
+        reconnectPending_ = false;
+
         running_ = true;
-        reconnectCount_ = 0;
+        if (!connect()) {
+            // 手动启动失败不进入重连，允许再次启动
+            running_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    bool StreamProcessor::connect() {
+        ioInterrupter_.reset();
+        // 重置前已被停止时中断标志已丢失，这里再检查一次
+        if (!running_) {
+            return false;
+        }
         setStatus(StreamStatus::CONNECTING);
 
         if (config_.type == StreamType::PULL) {
@@ -61,16 +132,28 @@ namespace ffmpeg_stream {
             }
         }
 
+        connectedTimeUs_ = av_gettime_relative();
         setStatus(StreamStatus::CONNECTED);
+
+        // 处理任务由调度器驱动，输入源有新数据时唤醒
+        processStage_->start([this]() { return processStep(); });
         return true;
     }
 
     void StreamProcessor::stop() {
+        // 先中断阻塞的I/O，正在进行的重连才能尽快释放锁
         running_ = false;
+        interrupt();
+
+        std::lock_guard<std::mutex> lock(lifecycleMutex_);
         cleanup();
         setStatus(StreamStatus::STOPPED);
     }
 
+    void StreamProcessor::interrupt() {
+        ioInterrupter_.abort();
+    }
+
     StreamStatus StreamProcessor::getStatus() const {
         return status_;
     }
@@ -79,8 +162,12 @@ namespace ffmpeg_stream {
         return id_;
     }
 
-    const StreamConfig& StreamProcessor::getConfig() const {
-        return config_;
+    StreamConfig StreamProcessor::getConfig() const {
+        StreamConfig config = config_;
+        config.decodeMode = decodeMode_.load();
+        config.decodeFrameInterval = decodeFrameInterval_.load();
+        config.fastDecode = fastDecode_.load();
+        return config;
     }
 
     bool StreamProcessor::updateConfig(const StreamConfig& config) {
@@ -93,157 +180,460 @@ namespace ffmpeg_stream {
 
         config_ = config;
         config_.id = id_;  // 确保ID不变
+        decodeMode_ = config_.decodeMode;
+        decodeFrameInterval_ = std::max(config_.decodeFrameInterval, 1);
+        fastDecode_ = config_.fastDecode;
 
         Logger::info("Updated config for stream %d", id_);
         return true;
     }
 
+    bool StreamProcessor::setDecodeMode(DecodeMode mode, int frameInterval, bool fastDecode) {
+        if (config_.type != StreamType::PULL) {
+            Logger::warning("Decode mode only applies to pull streams (stream %d)", id_);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(decodeModeMutex_);
+        decodeMode_ = mode;
+        decodeFrameInterval_ = std::max(frameInterval, 1);
+        fastDecode_ = fastDecode;
+        applyDecodeMode();
+
+        Logger::info("Stream %d decode mode set to %s (interval %d, fast %s)", id_,
+                     decodeModeToString(mode).c_str(), decodeFrameInterval_.load(), fastDecode ? "on" : "off");
+        return true;
+    }
+
+    void StreamProcessor::applyDecodeMode() {
+        // 推流的转码档位需要全部帧
+        if (!frameSubscription_ || config_.type != StreamType::PULL) {
+            return;
+        }
+        // 只有快照使用解码帧时，关键帧已足够
+        frameSubscription_->decodeMode = frameSubscriberCount_ > 0 ? decodeMode_.load() : DecodeMode::KEYFRAMES;
+        frameSubscription_->frameInterval = decodeFrameInterval_.load();
+        frameSubscription_->fastDecode = fastDecode_.load();
+    }
+
     std::chrono::steady_clock::time_point StreamProcessor::getLastActiveTime() const {
         return lastActiveTime_;
     }
 
-    bool StreamProcessor::processPull() {
+    bool StreamProcessor::isRemuxMode() const {
+        return packetSubscription_ && !frameSubscription_;
+    }
+
+    ProcessResult StreamProcessor::processPull() {
         if (!running_ || status_ != StreamStatus::CONNECTED) {
-            return false;
+            return ProcessResult::IDLE;
         }
 
         if (!inputOpened_) {
-            if (!openInput()) {
-                return false;
+            return ProcessResult::IDLE;
+        }
+
+        // 从输入源取一帧，帧对象在各次调用间复用
+        if (!frameSubscription_->frames->pop(frame_)) {
+            int error = frameSubscription_->endError;
+            return error == 0 ? ProcessResult::IDLE : handleInputEnd(error);
+        }
+
+        // 更新最后活动时间
+        lastActiveTime_ = std::chrono::steady_clock::now();
+
+        // 交给帧订阅者，回调异步执行，不阻塞拉流
+        deliverFrame(frame_);
+
+        av_frame_unref(frame_);
+
+        return ProcessResult::PROGRESS;
+    }
+
+    ProcessResult StreamProcessor::processPush() {
+        if (!running_ || status_ != StreamStatus::CONNECTED) {
+            return ProcessResult::IDLE;
+        }
+
+        if (!inputOpened_ || !outputOpened_) {
+            return ProcessResult::IDLE;
+        }
+
+        // 任一档位编码或封装出错，整个流进入重连
+        for (const auto& rendition : renditions_) {
+            int error = rendition->getError();
+            if (error != 0) {
+                lastError_ = error;
+                utils::printFFmpegError("Error writing frame", error);
+                setStatus(StreamStatus::ERROR, "Error writing output " + rendition->getConfig().outputUrl);
+                return ProcessResult::ENDED;
             }
         }
 
-        // 读取一帧并处理
-        AVPacket* packet = av_packet_alloc();
-        int ret = av_read_frame(inputFormatContext_, packet);
+        // 两类订阅都取空且都已结束时才算输入结束，保证解码器冲刷出的帧也能编码输出
+        bool ended = true;
+        bool progressed = false;
+        int endError = 0;
 
-        if (ret < 0) {
-            av_packet_free(&packet);
+        // 转封装档位：不解码不编码，直接复制包到输出
+        if (packetSubscription_) {
+            if (packetSubscription_->packets->pop(packet_)) {
+                lastActiveTime_ = std::chrono::steady_clock::now();
+                if (!shouldDropPacket(packet_)) {
+                    // 输出出错在下一次调用时处理
+                    dispatchPacket(packet_);
+                }
+                av_packet_unref(packet_);
+                ended = false;
+                progressed = true;
+            } else if ((endError = packetSubscription_->endError) == 0) {
+                ended = false;
+            }
+        }
 
-            if (ret == AVERROR_EOF) {
-                // 流结束
-                setStatus(StreamStatus::DISCONNECTED, "Stream ended");
-                return false;
+        // 转码档位：同一解码帧以引用方式交给各档位的编码阶段
+        if (frameSubscription_) {
+            if (frameSubscription_->frames->pop(frame_)) {
+                lastActiveTime_ = std::chrono::steady_clock::now();
+                if (!shouldDropFrame(frame_)) {
+                    dispatchFrame(frame_);
+                    deliverFrame(frame_);
+                }
+                av_frame_unref(frame_);
+                ended = false;
+                progressed = true;
             } else {
-                utils::printFFmpegError("Error reading frame", ret);
-                setStatus(StreamStatus::ERROR, "Error reading frame");
+                int error = frameSubscription_->endError;
+                if (error == 0) {
+                    ended = false;
+                } else {
+                    endError = error;
+                }
+            }
+        }
+
+        // 音频不参与输入结束的判断，视频结束时一并停止
+        if (audioSubscription_ && audioSubscription_->packets->pop(packet_)) {
+            dispatchAudio(packet_);
+            av_packet_unref(packet_);
+            progressed = true;
+        }
+
+        updateQueueDropStats();
+
+        if (ended) {
+            return handleInputEnd(endError);
+        }
+        return progressed ? ProcessResult::PROGRESS : ProcessResult::IDLE;
+    }
+
+    bool StreamProcessor::shouldDropPacket(const AVPacket* packet) {
+        int64_t timestamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        bool keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+
+        // 未解码的包无法区分是否被参考，只在超过硬上限时按GOP丢弃
+        auto action = packetLatency_.check(timestamp, source_->getVideoStream()->time_base, keyframe, 0);
+        if (action == LatencyBudget::Action::DROP_TO_KEYFRAME) {
+            gopDropped_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool StreamProcessor::shouldDropFrame(const AVFrame* frame) {
+        // 各档位编码队列中的积压同样计入延迟，各档位帧率不同，分别换算成时长后取最大值
+        int64_t backlogMs = 0;
+        for (const auto& rendition : renditions_) {
+            backlogMs = std::max(backlogMs, rendition->getBacklogMs());
+        }
+
+        auto action = frameLatency_.check(frame->pts, source_->getVideoStream()->time_base,
+                                          frame->key_frame != 0, backlogMs);
+
+        // 请求输入源的解码器跳过非参考帧(AVDISCARD_NONREF)，从源头减少解码开销；
+        // 降帧率转码且没有帧订阅者需要全部帧时一直跳过
+        frameSubscription_->skipNonRef = frameLatency_.isSheddingNonRef() ||
+                                         (decimateNonRef_ && frameSubscriberCount_ == 0);
+
+        if (action == LatencyBudget::Action::DROP_TO_KEYFRAME) {
+            gopDropped_++;
+            return true;
+        }
+
+        // 解码器切换到跳过模式之前已解码的B帧在这里丢弃
+        if (action == LatencyBudget::Action::DROP_NONREF && frame->pict_type == AV_PICTURE_TYPE_B) {
+            nonRefDropped_++;
+            return true;
+        }
+
+        return false;
+    }
+
+    void StreamProcessor::updateQueueDropStats() {
+        uint64_t dropped = 0;
+        if (packetSubscription_) dropped += packetSubscription_->packets->droppedCount();
+        if (frameSubscription_) dropped += frameSubscription_->frames->droppedCount();
+        if (audioSubscription_) dropped += audioSubscription_->packets->droppedCount();
+        for (const auto& rendition : renditions_) {
+            dropped += rendition->getDroppedCount();
+        }
+        queueDropped_ = dropped;
+    }
+
+    StreamStats StreamProcessor::getStats() const {
+        StreamStats stats;
+        stats.latencyMs = std::max(packetLatency_.getLatencyMs(), frameLatency_.getLatencyMs());
+        stats.nonRefDropped = nonRefDropped_;
+        stats.gopDropped = gopDropped_;
+        stats.queueDropped = queueDropped_;
+
+        std::lock_guard<std::mutex> lock(frameSubscribersMutex_);
+        for (const auto& subscriber : frameSubscribers_) {
+            stats.subscriberDropped += subscriber->getDroppedCount();
+        }
+        return stats;
+    }
+
+    bool StreamProcessor::dispatchPacket(AVPacket* packet) {
+        bool ok = true;
+        for (auto& rendition : renditions_) {
+            if (!rendition->isCopy()) {
+                continue;
+            }
+            // 每个档位各自修改时间戳，交给它一个独立的引用
+            if (av_packet_ref(copyPacket_, packet) < 0) {
                 return false;
             }
+            ok = rendition->pushPacket(copyPacket_) && ok;
+            av_packet_unref(copyPacket_);
         }
+        return ok;
+    }
 
-        // 更新最后活动时间
-        lastActiveTime_ = std::chrono::steady_clock::now();
+    bool StreamProcessor::dispatchFrame(AVFrame* frame) {
+        bool ok = true;
+        for (auto& rendition : renditions_) {
+            if (!rendition->isCopy()) {
+                ok = rendition->pushFrame(frame) && ok;
+            }
+        }
+        return ok;
+    }
 
-        if (packet->stream_index == videoStreamIndex_) {
-            // 解码视频帧
-            AVFrame* frame = decoder_->decode(packet);
-            if (frame) {
-                // 如果有帧回调，调用它
-                if (frameCallback_) {
-                    frameCallback_(id_, frame);
-                }
-                av_frame_free(&frame);
+    bool StreamProcessor::dispatchAudio(AVPacket* packet) {
+        bool ok = true;
+        for (auto& rendition : renditions_) {
+            if (av_packet_ref(copyPacket_, packet) < 0) {
+                return false;
             }
+            ok = rendition->pushAudio(copyPacket_) && ok;
+            av_packet_unref(copyPacket_);
         }
+        return ok;
+    }
 
-        av_packet_unref(packet);
-        av_packet_free(&packet);
+    void StreamProcessor::deliverFrame(AVFrame* frame) {
+        // 快照和所有订阅者共享同一个句柄
+        FrameHandle handle = makeFrameHandle(frame);
+        if (!handle) {
+            return;
+        }
 
-        return true;
+        {
+            std::lock_guard<std::mutex> lock(latestFrameMutex_);
+            latestFrame_ = handle;
+        }
+
+        if (frameSubscriberCount_ == 0) {
+            return;
+        }
+
+        // BLOCK策略的订阅者可能短暂阻塞，推送时不持有锁
+        std::vector<std::shared_ptr<FrameSubscriber>> subscribers;
+        {
+            std::lock_guard<std::mutex> lock(frameSubscribersMutex_);
+            subscribers = frameSubscribers_;
+        }
+
+        for (auto& subscriber : subscribers) {
+            subscriber->push(handle);
+        }
     }
 
-    bool StreamProcessor::processPush() {
-        if (!running_ || status_ != StreamStatus::CONNECTED) {
-            return false;
+    std::shared_ptr<FrameSubscriber> StreamProcessor::subscribeFrames(FrameHandler handler,
+                                                                      const FrameSubscriberOptions& options) {
+        if (!handler) {
+            return nullptr;
         }
 
-        if (!inputOpened_ || !outputOpened_) {
-            if (!openInput() || !openOutput()) {
-                return false;
+        std::shared_ptr<FrameSubscriber> subscriber;
+        {
+            std::lock_guard<std::mutex> lock(frameSubscribersMutex_);
+            std::string name = "stream-" + std::to_string(id_) + "-subscriber-" + std::to_string(nextSubscriberId_++);
+            subscriber = std::make_shared<FrameSubscriber>(name, id_, std::move(handler), options);
+            subscriber->start();
+            frameSubscribers_.push_back(subscriber);
+            frameSubscriberCount_ = frameSubscribers_.size();
+        }
+
+        // 从只有快照切换到有帧消费者时恢复配置的解码模式
+        std::lock_guard<std::mutex> lock(decodeModeMutex_);
+        applyDecodeMode();
+        return subscriber;
+    }
+
+    void StreamProcessor::unsubscribeFrames(const std::shared_ptr<FrameSubscriber>& subscriber) {
+        if (!subscriber) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(frameSubscribersMutex_);
+            auto it = std::find(frameSubscribers_.begin(), frameSubscribers_.end(), subscriber);
+            if (it == frameSubscribers_.end()) {
+                return;
             }
+            frameSubscribers_.erase(it);
+            frameSubscriberCount_ = frameSubscribers_.size();
         }
+        subscriber->stop();
 
-        // 读取一帧并处理
-        AVPacket* inPacket = av_packet_alloc();
-        int ret = av_read_frame(inputFormatContext_, inPacket);
+        std::lock_guard<std::mutex> lock(decodeModeMutex_);
+        applyDecodeMode();
+    }
 
-        if (ret < 0) {
-            av_packet_free(&inPacket);
+    std::shared_ptr<StreamSource> StreamProcessor::getSource() {
+        std::lock_guard<std::mutex> lock(sourceMutex_);
+        return inputOpened_ ? source_ : nullptr;
+    }
 
-            if (ret == AVERROR_EOF) {
-                // 流结束
-                setStatus(StreamStatus::DISCONNECTED, "Stream ended");
-                return false;
+    std::vector<uint8_t> StreamProcessor::getSnapshot(int width, int height) {
+        FrameHandle frame;
+        {
+            std::lock_guard<std::mutex> lock(latestFrameMutex_);
+            frame = latestFrame_;
+        }
+        if (!frame) {
+            return {};
+        }
+
+        std::lock_guard<std::mutex> lock(snapshotMutex_);
+        auto now = std::chrono::steady_clock::now();
+        auto key = std::make_pair(width, height);
+
+        // 最新帧未变化，或在缓存时间内，直接复用
+        auto it = snapshots_.find(key);
+        if (it != snapshots_.end() &&
+            (it->second.frame == frame ||
+             now - it->second.time < std::chrono::milliseconds(config_.snapshotCacheMs))) {
+            return it->second.jpeg;
+        }
+
+        std::vector<uint8_t> jpeg;
+        if (!snapshotEncoder_.encode(frame.get(), width, height, jpeg)) {
+            Logger::warning("Failed to encode snapshot for stream %d", id_);
+            return {};
+        }
+
+        // 清理过期的其他尺寸，缓存不会随请求的尺寸种类无限增长
+        for (auto entry = snapshots_.begin(); entry != snapshots_.end();) {
+            if (now - entry->second.time >= std::chrono::milliseconds(config_.snapshotCacheMs)) {
+                entry = snapshots_.erase(entry);
             } else {
-                utils::printFFmpegError("Error reading frame", ret);
-                setStatus(StreamStatus::ERROR, "Error reading frame");
-                return false;
+                ++entry;
             }
         }
 
-        // 更新最后活动时间
-        lastActiveTime_ = std::chrono::steady_clock::now();
+        Snapshot& snapshot = snapshots_[key];
+        snapshot.frame = std::move(frame);
+        snapshot.time = now;
+        snapshot.jpeg = jpeg;
+        return jpeg;
+    }
 
-        if (inPacket->stream_index == videoStreamIndex_) {
-            // 解码视频帧
-            AVFrame* decodedFrame = decoder_->decode(inPacket);
-            if (decodedFrame) {
-                // 设置帧时间戳
-                if (ptsOffset_ == 0) {
-                    ptsOffset_ = decodedFrame->pts;
-                }
+    ProcessResult StreamProcessor::handleInputEnd(int error) {
+        lastError_ = error;
 
-                decodedFrame->pts = decodedFrame->pts - ptsOffset_;
-
-                // 编码视频帧
-                AVPacket* outPacket = encoder_->encode(decodedFrame);
-                if (outPacket) {
-                    // 调整输出包的时间戳
-                    outPacket->stream_index = 0;
-
-                    // 写入输出包
-                    ret = av_interleaved_write_frame(outputFormatContext_, outPacket);
-                    if (ret < 0) {
-                        utils::printFFmpegError("Error writing frame", ret);
-                        av_packet_free(&outPacket);
-                        av_frame_free(&decodedFrame);
-                        av_packet_unref(inPacket);
-                        av_packet_free(&inPacket);
-                        return false;
-                    }
-
-                    av_packet_free(&outPacket);
-                }
+        // 输入源已在结束前把解码器中剩余的帧分发完毕
+        if (error == AVERROR_EOF) {
+            setStatus(StreamStatus::DISCONNECTED, "Stream ended");
+        } else {
+            utils::printFFmpegError("Error reading frame", error);
+            setStatus(StreamStatus::ERROR, "Error reading frame");
+        }
 
-                av_frame_free(&decodedFrame);
+        return ProcessResult::ENDED;
+    }
+
+    bool StreamProcessor::processStep() {
+        ProcessResult result = config_.type == StreamType::PULL ? processPull() : processPush();
+
+        // 输入结束或输出出错，由管理器安排重连，本任务在重连前保持空闲
+        if (result == ProcessResult::ENDED) {
+            if (endCallback_) {
+                endCallback_();
             }
+            return false;
         }
 
-        av_packet_unref(inPacket);
-        av_packet_free(&inPacket);
+        return result == ProcessResult::PROGRESS;
+    }
 
-        return true;
+    void StreamProcessor::setEndCallback(const std::function<void()>& callback) {
+        endCallback_ = callback;
     }
 
-    bool StreamProcessor::handleReconnect() {
-        if (!running_ || reconnectCount_ >= config_.maxReconnects) {
-            setStatus(StreamStatus::STOPPED, "Max reconnect attempts reached");
+    std::vector<RenditionConfig> StreamProcessor::getRenditionConfigs() const {
+        std::vector<RenditionConfig> renditions;
+        renditions.push_back(RenditionConfig::fromStreamConfig(config_));
+        renditions.insert(renditions.end(), config_.renditions.begin(), config_.renditions.end());
+        return renditions;
+    }
+
+    int StreamProcessor::nextReconnectDelay() {
+        if (!running_ || status_ == StreamStatus::STOPPED) {
+            return -1;
+        }
+
+        // 超时检查和输入结束可能同时触发，只保留一个重连
+        if (reconnectPending_.exchange(true)) {
+            return -1;
+        }
+
+        // 上一次连接已稳定运行，本次断开视为新的故障
+        if (reconnectPolicy_.getAttempts() > 0 &&
+            av_gettime_relative() - connectedTimeUs_ >= kStableConnectionUs) {
+            reconnectPolicy_.reset();
+        }
+
+        int error = lastError_;
+        int delayMs = reconnectPolicy_.nextDelay(error);
+        if (delayMs < 0) {
             running_ = false;
-            return false;
+            setStatus(StreamStatus::STOPPED, "Max reconnect attempts reached");
+            return -1;
         }
 
-        reconnectCount_++;
+        ReconnectPolicy::ErrorClass errorClass = ReconnectPolicy::classify(error);
         setStatus(StreamStatus::RECONNECTING,
-                  "Reconnecting... Attempt " + std::to_string(reconnectCount_));
+                  "Reconnecting in " + std::to_string(delayMs) + " ms, attempt " +
+                  std::to_string(reconnectPolicy_.getAttempts()) + " (" +
+                  ReconnectPolicy::errorClassToString(errorClass) + ")");
+        return delayMs;
+    }
 
-        // 先清理资源
-        cleanup();
+    bool StreamProcessor::handleReconnect() {
+        std::lock_guard<std::mutex> lock(lifecycleMutex_);
+        if (!running_ || status_ == StreamStatus::STOPPED) {
+            return false;
+        }
 
-        // 延迟重连
-        std::this_thread::sleep_for(std::chrono::milliseconds(config_.reconnectDelay));
+        // 先清理资源，旧的处理任务停止后才允许安排新的重连
+        cleanup();
+        reconnectPending_ = false;
+        lastError_ = 0;
 
-        // 重新启动
-        return start();
+        return connect();
     }
 
     bool StreamProcessor::isTimeout(int timeout) const {
@@ -269,86 +659,106 @@ namespace ffmpeg_stream {
 
     bool StreamProcessor::openInput() {
         // 检查是否已经打开
-        if (inputOpened_ && inputFormatContext_) {
+        if (inputOpened_ && source_) {
             return true;
         }
 
-        // 清理之前的资源
-        if (inputFormatContext_) {
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
+        // 获取共享输入源，同一输入的其他流已打开时直接复用
+        source_ = sourceRegistry_->acquire(config_);
+        if (!source_->open(&ioInterrupter_)) {
+            lastError_ = source_->getOpenError();
+            source_.reset();
+            setStatus(StreamStatus::ERROR, "Failed to open input");
+            return false;
         }
 
-        // 打开输入流
-        AVFormatContext* inputFormatContext = nullptr;
-        AVDictionary* options = nullptr;
-
-        // 设置网络超时选项
-        int timeoutMicros = config_.networkTimeout * 1000;
-//        av_dict_set_int(&options, "timeout", timeoutMicros, 0);
-        av_dict_set_int(&options, "stimeout", timeoutMicros, 0);
-        av_dict_set(&options, "rtsp_transport", config_.rtspTransport.c_str(), 0);
-
-        // 增加探测大小和分析持续时间，解决"not enough frames to estimate rate"问题
-        av_dict_set(&options, "probesize", "10485760", 0);     // 10MB (默认是5MB)
-        av_dict_set(&options, "analyzeduration", "5000000", 0); // 5秒 (默认是0.5秒)
-
-        // 应用额外选项
-        for (const auto& [key, value] : config_.extraOptions) {
-            av_dict_set(&options, key.c_str(), value.c_str(), 0);
+        // 推流时输入已符合要求的档位直接转封装，只订阅未解码的包；其余档位需要解码帧
+        bool needPackets = false;
+        bool needFrames = config_.type != StreamType::PUSH;
+        if (config_.type == StreamType::PUSH) {
+            const AVCodecParameters* codecParams = source_->getVideoStream()->codecpar;
+            for (const auto& rendition : getRenditionConfigs()) {
+                if (Rendition::canCopy(rendition, codecParams)) {
+                    needPackets = true;
+                } else {
+                    needFrames = true;
+                }
+            }
         }
 
-        int ret = avformat_open_input(&inputFormatContext, config_.inputUrl.c_str(), nullptr, &options);
-        av_dict_free(&options);
+        // 转封装从输入源缓存的最近一个关键帧开始，不必等待下一个关键帧
+        SourcePreroll preroll = needPackets ? SourcePreroll::LAST_GOP : SourcePreroll::NONE;
 
-        if (ret < 0) {
-            utils::printFFmpegError("Failed to open input", ret);
-            setStatus(StreamStatus::ERROR, "Failed to open input");
-            return false;
+        size_t depth = config_.queueDepth > 0 ? static_cast<size_t>(config_.queueDepth) : 1;
+        if (needPackets) {
+            packetSubscription_ = source_->subscribe(SourceDataType::PACKETS, depth, config_.queueOverflowPolicy,
+                                                     [this]() { processStage_->wake(); }, preroll);
         }
-
-        inputFormatContext_ = inputFormatContext;
-
-        // 获取流信息
-        ret = avformat_find_stream_info(inputFormatContext_, nullptr);
-        if (ret < 0) {
-            utils::printFFmpegError("Failed to find stream info", ret);
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            setStatus(StreamStatus::ERROR, "Failed to find stream info");
-            return false;
+        if (needFrames) {
+            std::unique_lock<std::mutex> decodeModeLock(decodeModeMutex_);
+            frameSubscription_ = source_->subscribe(SourceDataType::FRAMES, depth, config_.queueOverflowPolicy,
+                                                    [this]() { processStage_->wake(); });
+            applyDecodeMode();
+            decodeModeLock.unlock();
+            if (!frameSubscription_) {
+                closeInput();
+                setStatus(StreamStatus::ERROR, "Failed to initialize decoder");
+                return false;
+            }
         }
 
-        // 查找视频流
-        videoStreamIndex_ = -1;
-        for (unsigned int i = 0; i < inputFormatContext_->nb_streams; i++) {
-            if (inputFormatContext_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-                videoStreamIndex_ = i;
-                break;
-            }
+        // 推流时输入音频直通到各档位
+        if (config_.type == StreamType::PUSH && config_.audioEnabled && source_->getAudioStream()) {
+            audioSubscription_ = source_->subscribe(SourceDataType::AUDIO_PACKETS, depth,
+                                                    config_.queueOverflowPolicy,
+                                                    [this]() { processStage_->wake(); }, preroll);
         }
 
-        if (videoStreamIndex_ == -1) {
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            setStatus(StreamStatus::ERROR, "No video stream found");
-            return false;
+        if (isRemuxMode()) {
+            Logger::info("Stream %d input matches output settings, using remux mode", id_);
         }
 
-        // 初始化解码器
-        decoder_ = std::make_unique<HWDecoder>();
-        if (!decoder_->init(inputFormatContext_->streams[videoStreamIndex_]->codecpar,
-                            config_.decoderHWAccel)) {
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            setStatus(StreamStatus::ERROR, "Failed to initialize decoder");
-            return false;
+        // 录像不解码，与推流档位和帧订阅者互不影响，启动失败不影响流本身
+        if (config_.recordEnabled) {
+            if (!recorder_) {
+                recorder_ = std::make_unique<SegmentRecorder>(id_, config_);
+            }
+            if (!recorder_->start(source_)) {
+                Logger::warning("Stream %d: failed to start recording", id_);
+            }
         }
 
+        // 低延迟推流按延迟预算丢帧，保证处理落后时观众延迟不会持续增长
+        int latencyBudgetMs = config_.type == StreamType::PUSH && config_.lowLatency ? config_.maxLatencyMs : 0;
+        packetLatency_.configure(latencyBudgetMs, config_.maxLatencyHardMs);
+        frameLatency_.configure(latencyBudgetMs, config_.maxLatencyHardMs);
+
+        std::lock_guard<std::mutex> lock(sourceMutex_);
         inputOpened_ = true;
         return true;
     }
 
+    void StreamProcessor::closeInput() {
+        if (recorder_) {
+            recorder_->stop();
+        }
+        if (source_) {
+            if (packetSubscription_) source_->unsubscribe(packetSubscription_);
+            if (frameSubscription_) source_->unsubscribe(frameSubscription_);
+            if (audioSubscription_) source_->unsubscribe(audioSubscription_);
+        }
+        packetSubscription_.reset();
+        {
+            std::lock_guard<std::mutex> lock(decodeModeMutex_);
+            frameSubscription_.reset();
+        }
+        audioSubscription_.reset();
+
+        std::lock_guard<std::mutex> lock(sourceMutex_);
+        source_.reset();
+        inputOpened_ = false;
+    }
+
     bool StreamProcessor::openOutput() {
         // 只有推流模式需要输出
         if (config_.type != StreamType::PUSH) {
@@ -356,161 +766,81 @@ namespace ffmpeg_stream {
         }
 
         // 检查是否已经打开
-        if (outputOpened_ && outputFormatContext_) {
+        if (outputOpened_) {
             return true;
         }
 
         // 检查输入是否已经打开
-        if (!inputOpened_ || !inputFormatContext_) {
+        if (!inputOpened_ || !source_) {
             Logger::error("Cannot open output when input is not opened");
             return false;
         }
 
-        // 清理之前的资源
-        if (outputFormatContext_) {
-            if (outputFormatContext_->pb) {
-                avio_closep(&outputFormatContext_->pb);
-            }
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
-        }
-
-        // 创建输出格式上下文
-        avformat_alloc_output_context2(&outputFormatContext_, nullptr, config_.outputFormat.c_str(),
-                                       config_.outputUrl.c_str());
-        if (!outputFormatContext_) {
-            decoder_->cleanup();
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            inputOpened_ = false;
-            setStatus(StreamStatus::ERROR, "Failed to create output context");
-            return false;
-        }
-
-        // 初始化编码器
-        encoder_ = std::make_unique<HWEncoder>();
-        if (!encoder_->init(config_)) {
-            decoder_->cleanup();
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
-            inputOpened_ = false;
-            setStatus(StreamStatus::ERROR, "Failed to initialize encoder");
-            return false;
-        }
-
-        // 创建输出流
-        AVStream* outStream = avformat_new_stream(outputFormatContext_, nullptr);
-        if (!outStream) {
-            encoder_->cleanup();
-            decoder_->cleanup();
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
-            inputOpened_ = false;
-            setStatus(StreamStatus::ERROR, "Failed to create output stream");
-            return false;
-        }
-
-        // 复制编码器参数到输出流
-        int ret = avcodec_parameters_from_context(outStream->codecpar, encoder_->getCodecContext());
-        if (ret < 0) {
-            utils::printFFmpegError("Failed to copy encoder parameters", ret);
-            encoder_->cleanup();
-            decoder_->cleanup();
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
-            inputOpened_ = false;
-            setStatus(StreamStatus::ERROR, "Failed to copy encoder parameters");
-            return false;
-        }
-
-        // 如果输出格式需要全局头信息
-        if (outputFormatContext_->oformat->flags & AVFMT_GLOBALHEADER) {
-            outputFormatContext_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-        }
-
-        // 打开输出URL
-        if (!(outputFormatContext_->oformat->flags & AVFMT_NOFILE)) {
-            ret = avio_open(&outputFormatContext_->pb, config_.outputUrl.c_str(), AVIO_FLAG_WRITE);
-            if (ret < 0) {
-                utils::printFFmpegError("Failed to open output file", ret);
-                encoder_->cleanup();
-                decoder_->cleanup();
-                avformat_close_input(&inputFormatContext_);
-                inputFormatContext_ = nullptr;
-                avformat_free_context(outputFormatContext_);
-                outputFormatContext_ = nullptr;
-                inputOpened_ = false;
-                setStatus(StreamStatus::ERROR, "Failed to open output file");
+        // 按档位创建编码器和输出，任一档位失败则整体失败
+        renditions_.clear();
+        std::vector<RenditionConfig> configs = getRenditionConfigs();
+        for (size_t i = 0; i < configs.size(); i++) {
+            std::string name = "stream-" + std::to_string(id_) + "-" + configs[i].name;
+            auto rendition = std::make_unique<Rendition>(name, configs[i], config_, &ioInterrupter_);
+            const AVStream* audioStream = audioSubscription_ ? source_->getAudioStream() : nullptr;
+            if (!rendition->open(source_->getVideoStream(), audioStream)) {
+                lastError_ = rendition->getError();
+                renditions_.clear();
+                closeInput();
+                setStatus(StreamStatus::ERROR, "Failed to open output " + configs[i].outputUrl);
                 return false;
             }
-        }
-
-        // 写入流头信息
-        AVDictionary* options = nullptr;
-        ret = avformat_write_header(outputFormatContext_, &options);
-        av_dict_free(&options);
-
-        if (ret < 0) {
-            utils::printFFmpegError("Failed to write header", ret);
-            if (!(outputFormatContext_->oformat->flags & AVFMT_NOFILE)) {
-                avio_closep(&outputFormatContext_->pb);
+            renditions_.push_back(std::move(rendition));
+        }
+
+        // 跳过非参考帧(通常是B帧)后至少还剩约三分之一的帧，足够帧率转换抽取
+        decimateNonRef_ = false;
+        AVStream* videoStream = source_->getVideoStream();
+        AVRational inputRate = videoStream->avg_frame_rate.num > 0 ? videoStream->avg_frame_rate
+                                                                    : videoStream->r_frame_rate;
+        if (inputRate.num > 0 && inputRate.den > 0) {
+            for (const auto& rendition : renditions_) {
+                if (rendition->isCopy()) {
+                    continue;
+                }
+                if (rendition->getConfig().fps <= 0 || rendition->getConfig().fps * 3 > av_q2d(inputRate)) {
+                    decimateNonRef_ = false;
+                    break;
+                }
+                decimateNonRef_ = true;
             }
-            encoder_->cleanup();
-            decoder_->cleanup();
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
-            inputOpened_ = false;
-            setStatus(StreamStatus::ERROR, "Failed to write header");
-            return false;
+        }
+        if (decimateNonRef_) {
+            Logger::info("Stream %d: input at %.2f fps, skipping non-reference frames before decimation",
+                         id_, av_q2d(inputRate));
         }
 
         outputOpened_ = true;
-        ptsOffset_ = 0;  // 重置PTS偏移
         return true;
     }
 
     void StreamProcessor::cleanup() {
-        // 清理输出资源
-        if (outputFormatContext_) {
-            // 若已打开输出，写入流尾部
-            if (outputOpened_) {
-                av_write_trailer(outputFormatContext_);
-            }
-
-            if (!(outputFormatContext_->oformat->flags & AVFMT_NOFILE)) {
-                avio_closep(&outputFormatContext_->pb);
-            }
+        // 先停止处理任务，等待正在执行的单步返回
+        processStage_->stop();
 
-            avformat_free_context(outputFormatContext_);
-            outputFormatContext_ = nullptr;
+        // 关闭各档位，编码器缓存的包和队列中剩余的包在这里写出
+        for (auto& rendition : renditions_) {
+            rendition->close();
         }
+        renditions_.clear();
 
-        // 清理编码器
-        if (encoder_) {
-            encoder_->cleanup();
-        }
+        // 释放输入源
+        closeInput();
 
-        // 清理解码器
-        if (decoder_) {
-            decoder_->cleanup();
-        }
+        outputOpened_ = false;
 
-        // 清理输入资源
-        if (inputFormatContext_) {
-            avformat_close_input(&inputFormatContext_);
-            inputFormatContext_ = nullptr;
+        // 断开后不再提供过时的快照
+        {
+            std::lock_guard<std::mutex> lock(latestFrameMutex_);
+            latestFrame_.reset();
         }
-
-        inputOpened_ = false;
-        outputOpened_ = false;
+        std::lock_guard<std::mutex> lock(snapshotMutex_);
+        snapshots_.clear();
     }
 
-} // namespace ffmpeg_stream
\ No newline at end of file
+} // namespace ffmpeg_stream
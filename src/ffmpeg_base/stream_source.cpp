@@ -0,0 +1,829 @@
+/**
+ * @file stream_source.cpp
+ * @brief 共享输入源实现
+ */
+
+#include "ffmpeg_base/stream_source.h"
+#include "ffmpeg_base/encoder.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include <algorithm>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/mathematics.h>
+#include <libavutil/time.h>
+}
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 快速启动或有缓存参数时的探测上限：只需等到第一个关键帧，帧率和extradata由缓存或配置补齐
+        constexpr int64_t kShortProbeSize = 1024 * 1024;
+        constexpr int64_t kShortAnalyzeDurationUs = 1000000;
+
+        // 快速解码时的低分辨率级别(宽高减半)
+        constexpr int kFastDecodeLowres = 1;
+
+        // 等待其他使用者打开输入时检查自己中断器的间隔
+        constexpr std::chrono::milliseconds kOpenWaitPoll{50};
+
+        // 列出两个配置中影响打开和解码、但不区分共享输入的设置的差异，用逗号分隔
+        std::string describeSharedSettingsDiff(const StreamConfig& source, const StreamConfig& config) {
+            std::string diff;
+            auto add = [&diff](bool differs, const char* name) {
+                if (differs) {
+                    if (!diff.empty()) diff += ", ";
+                    diff += name;
+                }
+            };
+            add(source.extraOptions != config.extraOptions, "extraOptions");
+            add(source.networkTimeout != config.networkTimeout, "networkTimeout");
+            add(source.decoderHWAccel != config.decoderHWAccel, "decoderHWAccel");
+            add(source.probeSize != config.probeSize, "probeSize");
+            add(source.analyzeDurationMs != config.analyzeDurationMs, "analyzeDurationMs");
+            add(source.fpsProbeSize != config.fpsProbeSize, "fpsProbeSize");
+            add(source.fastStart != config.fastStart, "fastStart");
+            add(source.inputCodec != config.inputCodec || source.inputWidth != config.inputWidth ||
+                source.inputHeight != config.inputHeight || source.inputFps != config.inputFps, "input hints");
+            add(source.gopCacheMs != config.gopCacheMs || source.gopCacheMaxBytes != config.gopCacheMaxBytes,
+                "gopCache");
+            return diff;
+        }
+
+        // 按订阅者的解码模式判断是否分发一帧(解码阶段调用)
+        bool acceptFrame(SourceSubscription& subscription, const AVFrame* frame) {
+            switch (subscription.decodeMode.load()) {
+                case DecodeMode::KEYFRAMES:
+                    return frame->key_frame != 0 || frame->pict_type == AV_PICTURE_TYPE_I;
+
+                case DecodeMode::EVERY_NTH: {
+                    // 解码器为其他订阅者解出的非参考帧
+                    if (frame->pict_type == AV_PICTURE_TYPE_B) {
+                        return false;
+                    }
+                    uint64_t interval = static_cast<uint64_t>(std::max(subscription.frameInterval.load(), 1));
+                    return subscription.frameCounter++ % interval == 0;
+                }
+
+                default:
+                    return true;
+            }
+        }
+    }
+
+    SourceSubscription::SourceSubscription(SourceDataType type, size_t depth, QueueOverflowPolicy policy,
+                                           std::function<void()> notify)
+            : type(type), endError(0), notify(std::move(notify)), skipNonRef(false),
+              decodeMode(DecodeMode::FULL), frameInterval(1), fastDecode(false), frameCounter(0),
+              preroll(SourcePreroll::NONE) {
+        if (type != SourceDataType::FRAMES) {
+            packets = std::make_unique<PacketQueue>(depth, policy);
+        } else {
+            frames = std::make_unique<FrameQueue>(depth, policy);
+        }
+    }
+
+    StreamSource::StreamSource(const std::string& key, const StreamConfig& config,
+                               std::shared_ptr<StreamInfoCache> infoCache)
+            : key_(key),
+              config_(config),
+              infoCache_(std::move(infoCache)),
+              opened_(false),
+              opening_(false),
+              openFailed_(false),
+              openError_(0),
+              formatContext_(nullptr),
+              videoStreamIndex_(-1),
+              audioStreamIndex_(-1),
+              lastReadUs_(0),
+              decodeEnabled_(false),
+              readPacket_(av_packet_alloc()),
+              readPending_(false),
+              decodePacket_(av_packet_alloc()),
+              prerollPending_(false),
+              skipFrame_(AVDISCARD_DEFAULT),
+              fastDecoding_(false),
+              waitKeyframe_(false),
+              paceStartUs_(AV_NOPTS_VALUE),
+              paceStartDtsUs_(AV_NOPTS_VALUE),
+              error_(0) {
+        // 非阻塞读取时没有就绪通知，暂无数据的输入按较短的间隔轮询
+        // 读取可能阻塞到网络超时，运行在I/O调度器上。RTSP解复用器忽略AVFMT_FLAG_NONBLOCK，
+        // 每个输入源读取时占用一个I/O线程，I/O调度器由StreamManager按输入源数伸缩
+        ingestStage_ = std::make_unique<StageRunner>("source-ingest", std::chrono::microseconds(2000),
+                                                     &Scheduler::getIOInstance());
+        decodeStage_ = std::make_unique<StageRunner>("source-decode");
+        gopCache_.configure(config_.gopCacheMs, config_.gopCacheMaxBytes);
+    }
+
+    StreamSource::~StreamSource() {
+        close();
+        av_packet_free(&readPacket_);
+        av_packet_free(&decodePacket_);
+    }
+
+    bool StreamSource::open(const IOInterrupter* interrupter) {
+        std::unique_lock<std::mutex> lock(openMutex_);
+
+        // 其他使用者正在打开时等待其结果；等待期间检查自己的中断器，
+        // 本流停止时直接返回，不必等到对方的网络超时
+        while (opening_) {
+            if (interrupter && interrupter->isAborted()) {
+                return false;
+            }
+            openCondition_.wait_for(lock, kOpenWaitPoll);
+        }
+        if (opened_) {
+            return true;
+        }
+        if (openFailed_) {
+            return false;
+        }
+
+        // 阻塞的连接和探测不持有openMutex_，打开期间调用者停止时中断
+        opening_ = true;
+        lock.unlock();
+        interrupter_.setParent(interrupter);
+        bool inputOpened = openInput();
+        interrupter_.setParent(nullptr);
+        lock.lock();
+        opening_ = false;
+        openCondition_.notify_all();
+
+        if (!inputOpened) {
+            openFailed_ = true;
+            return false;
+        }
+
+        lastReadUs_ = av_gettime_relative();
+
+        ingestStage_->start([this]() { return ingestStep(); });
+        opened_ = true;
+
+        Logger::info("Opened shared source %s", config_.inputUrl.c_str());
+        return true;
+    }
+
+    bool StreamSource::openInput() {
+        AVDictionary* options = nullptr;
+
+        // 设置网络超时选项
+        int timeoutMicros = config_.networkTimeout * 1000;
+        av_dict_set_int(&options, "stimeout", timeoutMicros, 0);
+        av_dict_set(&options, "rtsp_transport", config_.rtspTransport.c_str(), 0);
+
+        // 应用额外选项，额外选项优先于下面的探测参数
+        for (const auto& [key, value] : config_.extraOptions) {
+            av_dict_set(&options, key.c_str(), value.c_str(), 0);
+        }
+
+        // 快速启动或参数已缓存时只探测到第一个关键帧，否则按配置完整探测
+        CachedStreamInfo cachedInfo;
+        bool useCache = infoCache_ && infoCache_->lookup(config_.inputUrl, cachedInfo);
+        bool shortProbe = config_.fastStart || useCache;
+
+        int64_t probeSize = config_.probeSize;
+        int64_t analyzeDurationUs = static_cast<int64_t>(config_.analyzeDurationMs) * 1000;
+        int fpsProbeSize = config_.fpsProbeSize;
+        if (shortProbe) {
+            probeSize = probeSize > 0 ? std::min(probeSize, kShortProbeSize) : kShortProbeSize;
+            analyzeDurationUs = analyzeDurationUs > 0 ? std::min(analyzeDurationUs, kShortAnalyzeDurationUs)
+                                                      : kShortAnalyzeDurationUs;
+            fpsProbeSize = 0;  // 帧率从缓存或配置补齐，不再逐帧估计
+        }
+
+        if (probeSize > 0) {
+            av_dict_set_int(&options, "probesize", probeSize, AV_DICT_DONT_OVERWRITE);
+        }
+        if (analyzeDurationUs > 0) {
+            av_dict_set_int(&options, "analyzeduration", analyzeDurationUs, AV_DICT_DONT_OVERWRITE);
+        }
+        if (fpsProbeSize >= 0) {
+            av_dict_set_int(&options, "fpsprobesize", fpsProbeSize, AV_DICT_DONT_OVERWRITE);
+        }
+
+        // 额外选项覆盖了分析时长时，探测截止时间按实际值计算
+        AVDictionaryEntry* analyzeEntry = av_dict_get(options, "analyzeduration", nullptr, 0);
+        if (analyzeEntry) {
+            analyzeDurationUs = std::strtoll(analyzeEntry->value, nullptr, 10);
+        }
+
+        // 预先分配上下文以便在连接过程中就能被中断
+        formatContext_ = avformat_alloc_context();
+        if (!formatContext_) {
+            av_dict_free(&options);
+            Logger::error("Failed to allocate input context for %s", config_.inputUrl.c_str());
+            openError_ = AVERROR(ENOMEM);
+            return false;
+        }
+        interrupter_.install(formatContext_);
+
+        // 配置了输入编码提示时直接使用对应的解码器探测
+        AVCodecID codecHint = config_.inputCodec.empty() ? AV_CODEC_ID_NONE : codecNameToAVCodecID(config_.inputCodec);
+        if (config_.fastStart && codecHint != AV_CODEC_ID_NONE) {
+            formatContext_->video_codec_id = codecHint;
+        }
+
+        int ret;
+        {
+            IODeadline deadline(interrupter_, config_.networkTimeout);
+            ret = avformat_open_input(&formatContext_, config_.inputUrl.c_str(), nullptr, &options);
+        }
+        av_dict_free(&options);
+
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to open input", ret);
+            openError_ = ret;
+            formatContext_ = nullptr;
+            return false;
+        }
+
+        // 获取流信息，探测需要读取analyzeduration长度的数据，截止时间相应放宽
+        {
+            IODeadline deadline(interrupter_, config_.networkTimeout + static_cast<int>(analyzeDurationUs / 1000));
+            ret = avformat_find_stream_info(formatContext_, nullptr);
+        }
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to find stream info", ret);
+            openError_ = ret;
+            if (useCache) {
+                infoCache_->invalidate(config_.inputUrl);
+            }
+            avformat_close_input(&formatContext_);
+            formatContext_ = nullptr;
+            return false;
+        }
+
+        // 查找视频流
+        videoStreamIndex_ = -1;
+        for (unsigned int i = 0; i < formatContext_->nb_streams; i++) {
+            if (formatContext_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+                videoStreamIndex_ = i;
+                break;
+            }
+        }
+
+        if (videoStreamIndex_ == -1) {
+            Logger::error("No video stream found in %s", config_.inputUrl.c_str());
+            openError_ = AVERROR_STREAM_NOT_FOUND;
+            avformat_close_input(&formatContext_);
+            formatContext_ = nullptr;
+            return false;
+        }
+
+        // 查找音频流，探测不完整(采样率或声道未知)的音频流无法封装，忽略
+        audioStreamIndex_ = -1;
+        for (unsigned int i = 0; i < formatContext_->nb_streams; i++) {
+            const AVCodecParameters* params = formatContext_->streams[i]->codecpar;
+            if (params->codec_type == AVMEDIA_TYPE_AUDIO) {
+                if (params->sample_rate > 0 && params->channels > 0) {
+                    audioStreamIndex_ = i;
+                } else {
+                    Logger::warning("Audio stream of %s has incomplete parameters, ignoring it",
+                                    config_.inputUrl.c_str());
+                }
+                break;
+            }
+        }
+
+        AVStream* videoStream = formatContext_->streams[videoStreamIndex_];
+        if (useCache) {
+            if (StreamInfoCache::matches(cachedInfo, videoStream)) {
+                StreamInfoCache::apply(cachedInfo, videoStream);
+                Logger::info("Using cached stream info for %s", config_.inputUrl.c_str());
+            } else if (videoStream->codecpar->width <= 0) {
+                // 参数已变化且快速探测没有得到分辨率，下次完整探测
+                Logger::warning("Cached stream info of %s is stale, probing fully next time",
+                                config_.inputUrl.c_str());
+                infoCache_->invalidate(config_.inputUrl);
+                openError_ = AVERROR_INVALIDDATA;
+                avformat_close_input(&formatContext_);
+                formatContext_ = nullptr;
+                return false;
+            } else {
+                Logger::info("Stream parameters of %s changed, refreshing cache", config_.inputUrl.c_str());
+            }
+        }
+        if (config_.fastStart && !useCache) {
+            applyConfigHints(videoStream, codecHint);
+        }
+        if (shortProbe && videoStream->codecpar->width <= 0) {
+            Logger::warning("Short probe of %s did not find the video size", config_.inputUrl.c_str());
+        }
+        if (infoCache_) {
+            infoCache_->store(config_.inputUrl, videoStream);
+        }
+
+        // 打开和探测阶段允许阻塞(在启动线程上执行)，之后在I/O调度器上读取；
+        // 支持非阻塞的协议暂无数据时立即返回，RTSP等协议仍会阻塞到有数据或截止时间
+        formatContext_->flags |= AVFMT_FLAG_NONBLOCK;
+
+        return true;
+    }
+
+    void StreamSource::applyConfigHints(AVStream* stream, AVCodecID codecHint) {
+        if (codecHint != AV_CODEC_ID_NONE && codecHint != stream->codecpar->codec_id) {
+            Logger::warning("Input %s is not %s as configured, ignoring hints",
+                            config_.inputUrl.c_str(), config_.inputCodec.c_str());
+            return;
+        }
+
+        // 只补齐探测未得到的字段，探测结果优先
+        CachedStreamInfo hints;
+        hints.codecId = stream->codecpar->codec_id;
+        hints.width = config_.inputWidth;
+        hints.height = config_.inputHeight;
+        hints.frameRate = AVRational{config_.inputFps, 1};
+        StreamInfoCache::apply(hints, stream);
+    }
+
+    void StreamSource::close() {
+        // 先中断可能阻塞的读取，读取阶段才能尽快停止
+        interrupter_.abort();
+        ingestStage_->stop();
+        decodeStage_->stop();
+        decodeEnabled_ = false;
+
+        {
+            std::lock_guard<std::mutex> lock(subscribersMutex_);
+            for (auto& subscription : subscribers_) {
+                int expected = 0;
+                subscription->endError.compare_exchange_strong(expected, AVERROR_EXIT);
+            }
+            subscribers_.clear();
+        }
+
+        decodeQueue_.reset();
+        av_packet_unref(readPacket_);
+        readPending_ = false;
+        gopCache_.clear();
+        prerollPending_ = false;
+
+        if (decoder_) {
+            decoder_->cleanup();
+            decoder_.reset();
+        }
+
+        if (formatContext_) {
+            avformat_close_input(&formatContext_);
+            formatContext_ = nullptr;
+        }
+
+        if (opened_) {
+            Logger::info("Closed shared source %s", config_.inputUrl.c_str());
+        }
+        opened_ = false;
+    }
+
+    std::shared_ptr<SourceSubscription> StreamSource::subscribe(SourceDataType type, size_t depth,
+                                                                QueueOverflowPolicy policy,
+                                                                std::function<void()> notify,
+                                                                SourcePreroll preroll) {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+
+        if (type == SourceDataType::FRAMES && !decodeEnabled_) {
+            if (!startDecoding()) {
+                return nullptr;
+            }
+        }
+
+        if (type == SourceDataType::AUDIO_PACKETS && audioStreamIndex_ < 0) {
+            return nullptr;
+        }
+
+        auto subscription = std::make_shared<SourceSubscription>(type, depth, policy, std::move(notify));
+        subscription->endError = error_.load();
+        if (type != SourceDataType::FRAMES && preroll != SourcePreroll::NONE && subscription->endError == 0) {
+            subscription->preroll = preroll;
+            prerollPending_ = true;
+        }
+        subscribers_.push_back(subscription);
+
+        Logger::debug("Source %s has %zu subscribers", config_.inputUrl.c_str(), subscribers_.size());
+        return subscription;
+    }
+
+    void StreamSource::unsubscribe(const std::shared_ptr<SourceSubscription>& subscription) {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscription),
+                           subscribers_.end());
+    }
+
+    bool StreamSource::startDecoding() {
+        if (!formatContext_) {
+            return false;
+        }
+
+        decoder_ = std::make_unique<HWDecoder>();
+        if (!decoder_->init(formatContext_->streams[videoStreamIndex_]->codecpar,
+                            config_.decoderHWAccel)) {
+            Logger::error("Failed to initialize decoder for %s", config_.inputUrl.c_str());
+            decoder_.reset();
+            return false;
+        }
+
+        size_t depth = config_.queueDepth > 0 ? static_cast<size_t>(config_.queueDepth) : 1;
+        decodeQueue_ = std::make_unique<PacketQueue>(depth, config_.queueOverflowPolicy);
+        skipFrame_ = AVDISCARD_DEFAULT;
+        fastDecoding_ = false;
+        waitKeyframe_ = false;
+        decodeStage_->start([this]() { return decodeStep(); });
+        decodeEnabled_ = true;
+        return true;
+    }
+
+    AVStream* StreamSource::getVideoStream() const {
+        if (!formatContext_ || videoStreamIndex_ < 0) {
+            return nullptr;
+        }
+        return formatContext_->streams[videoStreamIndex_];
+    }
+
+    AVStream* StreamSource::getAudioStream() const {
+        if (!formatContext_ || audioStreamIndex_ < 0) {
+            return nullptr;
+        }
+        return formatContext_->streams[audioStreamIndex_];
+    }
+
+    bool StreamSource::isFailed() const {
+        return openFailed_ || error_ != 0;
+    }
+
+    const StreamConfig& StreamSource::getConfig() const {
+        return config_;
+    }
+
+    int StreamSource::getOpenError() const {
+        return openError_;
+    }
+
+    const std::string& StreamSource::getKey() const {
+        return key_;
+    }
+
+    size_t StreamSource::getSubscriberCount() const {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        return subscribers_.size();
+    }
+
+    int64_t StreamSource::getGopCacheDurationMs() const {
+        return gopCache_.getDurationMs();
+    }
+
+    int64_t StreamSource::getGopCacheBytes() const {
+        return gopCache_.getBytes();
+    }
+
+    bool StreamSource::ingestStep() {
+        if (error_ != 0) {
+            return false;
+        }
+
+        // 上一个包尚未到释放时间时不再读取新包
+        int ret = 0;
+        if (!readPending_) {
+            IODeadline deadline(interrupter_, config_.networkTimeout);
+            ret = av_read_frame(formatContext_, readPacket_);
+        }
+
+        if (ret == AVERROR(EAGAIN)) {
+            // 非阻塞读取暂无数据，长时间无数据按超时处理
+            if (av_gettime_relative() - lastReadUs_ < static_cast<int64_t>(config_.networkTimeout) * 1000) {
+                return false;
+            }
+            ret = AVERROR(ETIMEDOUT);
+        } else if (ret == AVERROR_EXIT && !interrupter_.isAborted()) {
+            // 被截止时间打断
+            ret = AVERROR(ETIMEDOUT);
+        }
+
+        if (ret < 0) {
+            if (ret != AVERROR_EOF && ret != AVERROR_EXIT) {
+                utils::printFFmpegError("Error reading frame", ret);
+            }
+            error_ = ret;
+
+            // 包订阅者立即结束，帧订阅者在解码器冲刷后结束
+            endSubscriptions(SourceDataType::PACKETS, ret);
+            endSubscriptions(SourceDataType::AUDIO_PACKETS, ret);
+            if (!decodeEnabled_) {
+                endSubscriptions(SourceDataType::FRAMES, ret);
+            }
+            decodeStage_->wake();
+            return false;
+        }
+
+        lastReadUs_ = av_gettime_relative();
+        readPending_ = true;
+        if (paceDelay(readPacket_) > 0) {
+            return false;
+        }
+        readPending_ = false;
+
+        // 新订阅者先拿到缓存的包，再接着收到当前包
+        if (prerollPending_) {
+            std::lock_guard<std::mutex> lock(subscribersMutex_);
+            replayGopCache();
+        }
+
+        bool isVideo = readPacket_->stream_index == videoStreamIndex_;
+        if (isVideo || readPacket_->stream_index == audioStreamIndex_) {
+            AVStream* stream = formatContext_->streams[readPacket_->stream_index];
+            int64_t ts = readPacket_->dts != AV_NOPTS_VALUE ? readPacket_->dts : readPacket_->pts;
+            int64_t timeUs = ts != AV_NOPTS_VALUE ? av_rescale_q(ts, stream->time_base, AV_TIME_BASE_Q)
+                                                  : AV_NOPTS_VALUE;
+            gopCache_.push(readPacket_, isVideo, timeUs);
+        }
+
+        // 音频包只转发，不解码
+        if (readPacket_->stream_index == audioStreamIndex_) {
+            std::lock_guard<std::mutex> lock(subscribersMutex_);
+            for (auto& subscription : subscribers_) {
+                if (subscription->type == SourceDataType::AUDIO_PACKETS &&
+                    subscription->packets->push(readPacket_) && subscription->notify) {
+                    subscription->notify();
+                }
+            }
+        }
+
+        if (readPacket_->stream_index == videoStreamIndex_) {
+            {
+                std::lock_guard<std::mutex> lock(subscribersMutex_);
+                for (auto& subscription : subscribers_) {
+                    if (subscription->type == SourceDataType::PACKETS &&
+                        subscription->packets->push(readPacket_) && subscription->notify) {
+                        subscription->notify();
+                    }
+                }
+            }
+
+            if (decodeEnabled_ && decodeQueue_->push(readPacket_)) {
+                decodeStage_->wake();
+            }
+        }
+
+        av_packet_unref(readPacket_);
+        return true;
+    }
+
+    void StreamSource::replayGopCache() {
+        prerollPending_ = false;
+        for (auto& subscription : subscribers_) {
+            SourcePreroll preroll = subscription->preroll.exchange(SourcePreroll::NONE);
+            if (preroll == SourcePreroll::NONE) {
+                continue;
+            }
+
+            // 视频包订阅者只回放视频，音频订阅者只回放音频；队列满时多出的包按队列策略处理
+            bool wantVideo = subscription->type == SourceDataType::PACKETS;
+            size_t count = 0;
+            gopCache_.forEach(preroll == SourcePreroll::LAST_GOP, [&](const AVPacket* packet, bool video) {
+                if (video == wantVideo && subscription->packets->push(packet)) {
+                    count++;
+                }
+            });
+
+            if (count > 0) {
+                Logger::debug("Source %s replayed %zu cached packets to a new subscriber",
+                              config_.inputUrl.c_str(), count);
+                if (subscription->notify) {
+                    subscription->notify();
+                }
+            }
+        }
+    }
+
+    int64_t StreamSource::paceDelay(const AVPacket* packet) {
+        if (config_.readRate <= 0 || packet->dts == AV_NOPTS_VALUE) {
+            return 0;
+        }
+
+        AVRational timeBase = formatContext_->streams[packet->stream_index]->time_base;
+        int64_t dtsUs = av_rescale_q(packet->dts, timeBase, AV_TIME_BASE_Q);
+        int64_t now = av_gettime_relative();
+
+        if (paceStartUs_ == AV_NOPTS_VALUE) {
+            paceStartUs_ = now;
+            paceStartDtsUs_ = dtsUs;
+        }
+
+        // 时间戳按倍速映射到墙钟
+        int64_t releaseUs = paceStartUs_ + static_cast<int64_t>((dtsUs - paceStartDtsUs_) / config_.readRate);
+        int64_t delay = releaseUs - now;
+
+        // 时间戳前后跳变过大(如文件拼接、回绕或循环输入)时重新锚定，
+        // 向前跳避免长时间停顿，向后跳避免失去限速而突发读取
+        if (delay > 10 * AV_TIME_BASE || delay < -10 * AV_TIME_BASE) {
+            Logger::warning("Timestamp jump in %s, re-anchoring read pacing", config_.inputUrl.c_str());
+            paceStartUs_ = now;
+            paceStartDtsUs_ = dtsUs;
+            return 0;
+        }
+
+        return delay;
+    }
+
+    bool StreamSource::decodeStep() {
+        if (!decodeEnabled_) {
+            return false;
+        }
+
+        if (!decodeQueue_->pop(decodePacket_)) {
+            int error = error_;
+            if (error != 0) {
+                // 读取结束，冲刷解码器后通知帧订阅者
+                if (error == AVERROR_EOF) {
+                    decoder_->decode(nullptr, [this](AVFrame* frame) {
+                        dispatchFrame(frame);
+                    });
+                }
+                // 解码结束后停止解码阶段，之后的帧订阅会重新启动解码并立即收到结束通知
+                {
+                    std::lock_guard<std::mutex> lock(subscribersMutex_);
+                    decodeEnabled_ = false;
+                    decodeStage_->stop();
+                }
+                endSubscriptions(SourceDataType::FRAMES, error);
+            }
+            return false;
+        }
+
+        updateDecodeSettings();
+
+        // 只解码关键帧时非关键帧的包不送入解码器，连解析的开销也省去；没有帧订阅者时全部跳过
+        bool keyframe = (decodePacket_->flags & AV_PKT_FLAG_KEY) != 0;
+        if (skipFrame_ == AVDISCARD_ALL || ((skipFrame_ >= AVDISCARD_NONKEY || waitKeyframe_) && !keyframe)) {
+            av_packet_unref(decodePacket_);
+            return true;
+        }
+        waitKeyframe_ = false;
+
+        // 一个包可能输出多帧，每帧以引用的方式分发给所有帧订阅者
+        decoder_->decode(decodePacket_, [this](AVFrame* frame) {
+            dispatchFrame(frame);
+        });
+
+        av_packet_unref(decodePacket_);
+        return true;
+    }
+
+    void StreamSource::dispatchFrame(AVFrame* frame) {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        for (auto& subscription : subscribers_) {
+            if (subscription->type == SourceDataType::FRAMES && acceptFrame(*subscription, frame) &&
+                subscription->frames->push(frame) && subscription->notify) {
+                subscription->notify();
+            }
+        }
+    }
+
+    void StreamSource::updateDecodeSettings() {
+        // 解码器是共享的，任一帧订阅者需要的帧都不能跳过
+        AVDiscard skipFrame = AVDISCARD_NONKEY;
+        bool fast = true;
+        bool hasFrameSubscribers = false;
+        {
+            std::lock_guard<std::mutex> lock(subscribersMutex_);
+            for (const auto& subscription : subscribers_) {
+                if (subscription->type != SourceDataType::FRAMES) {
+                    continue;
+                }
+                hasFrameSubscribers = true;
+
+                AVDiscard wanted;
+                switch (subscription->decodeMode.load()) {
+                    case DecodeMode::KEYFRAMES:
+                        wanted = AVDISCARD_NONKEY;
+                        break;
+                    case DecodeMode::EVERY_NTH:
+                        wanted = AVDISCARD_NONREF;
+                        break;
+                    default:
+                        // 落后的订阅者请求跳过非参考帧；下面取所有帧订阅者中最保守的设置，
+                        // 只有其他帧订阅者也允许时解码器才跳过，否则由落后的订阅者自行丢弃
+                        wanted = subscription->skipNonRef ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+                        break;
+                }
+                skipFrame = std::min(skipFrame, wanted);
+                fast = fast && subscription->fastDecode;
+            }
+        }
+        // 没有帧订阅者时包不再送入解码器，新的帧订阅者从下一个关键帧开始
+        if (!hasFrameSubscribers) {
+            skipFrame = AVDISCARD_ALL;
+            fast = fastDecoding_;
+        }
+
+        if (skipFrame != skipFrame_) {
+            // 只解码关键帧时参考帧没有送入解码器，恢复后要等到下一个关键帧
+            if (skipFrame_ >= AVDISCARD_NONKEY && skipFrame < AVDISCARD_NONKEY) {
+                waitKeyframe_ = true;
+            }
+            // 停止解码时丢弃解码器中延迟输出的帧，恢复后不会先收到过时的画面
+            if (skipFrame == AVDISCARD_ALL) {
+                decoder_->flush();
+            }
+            decoder_->getCodecContext()->skip_frame = skipFrame;
+            skipFrame_ = skipFrame;
+            Logger::debug("Source %s decoder skip_frame set to %d", config_.inputUrl.c_str(), skipFrame);
+        }
+
+        if (fast != fastDecoding_) {
+            fastDecoding_ = fast;
+
+            // 低分辨率只能在打开解码器时设置，编码支持时重建解码器(硬件解码不支持低分辨率)
+            const AVCodecParameters* codecParams = formatContext_->streams[videoStreamIndex_]->codecpar;
+            int lowres = fast ? std::min(kFastDecodeLowres, HWDecoder::getMaxLowres(codecParams->codec_id)) : 0;
+            if (lowres != decoder_->getCodecContext()->lowres) {
+                auto decoder = std::make_unique<HWDecoder>();
+                decoder->setLowres(lowres);
+                if (decoder->init(formatContext_->streams[videoStreamIndex_]->codecpar,
+                                  lowres > 0 ? HWAccelType::NONE : config_.decoderHWAccel)) {
+                    decoder_ = std::move(decoder);
+                    decoder_->getCodecContext()->skip_frame = skipFrame_;
+                    waitKeyframe_ = true;
+                } else {
+                    Logger::warning("Failed to reinitialize decoder of %s, keeping current resolution",
+                                    config_.inputUrl.c_str());
+                }
+            }
+
+            decoder_->getCodecContext()->skip_loop_filter = fast ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+            Logger::info("Source %s fast decode %s", config_.inputUrl.c_str(), fast ? "enabled" : "disabled");
+        }
+    }
+
+    void StreamSource::endSubscriptions(SourceDataType type, int error) {
+        std::lock_guard<std::mutex> lock(subscribersMutex_);
+        for (auto& subscription : subscribers_) {
+            if (subscription->type == type) {
+                int expected = 0;
+                if (subscription->endError.compare_exchange_strong(expected, error) && subscription->notify) {
+                    subscription->notify();
+                }
+            }
+        }
+    }
+
+    SourceRegistry::SourceRegistry(std::shared_ptr<StreamInfoCache> infoCache)
+            : infoCache_(std::move(infoCache)) {
+    }
+
+    std::shared_ptr<StreamSource> SourceRegistry::acquire(const StreamConfig& config) {
+        std::string key = makeKey(config);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // 清理已失效的条目
+        for (auto it = sources_.begin(); it != sources_.end();) {
+            if (it->second.expired()) {
+                it = sources_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto it = sources_.find(key);
+        if (it != sources_.end()) {
+            auto source = it->second.lock();
+            // 出错的输入源不再复用，由新的输入源替换
+            if (source && !source->isFailed()) {
+                Logger::info("Sharing source %s", config.inputUrl.c_str());
+                // 共享的输入按第一个使用者的设置打开和解码，设置不同时提示
+                std::string diff = describeSharedSettingsDiff(source->getConfig(), config);
+                if (!diff.empty()) {
+                    Logger::warning("Source %s is shared with settings of the stream that opened it, "
+                                    "ignoring different %s", config.inputUrl.c_str(), diff.c_str());
+                }
+                return source;
+            }
+        }
+
+        auto source = std::make_shared<StreamSource>(key, config, infoCache_);
+        sources_[key] = source;
+        return source;
+    }
+
+    std::string SourceRegistry::makeKey(const StreamConfig& config) {
+        std::string key = config.inputUrl + "|" + config.rtspTransport;
+        // 限速读取的输入按倍速区分，不与不限速的使用者共享
+        if (config.readRate > 0) {
+            key += "|x" + std::to_string(config.readRate);
+        }
+        return key;
+    }
+
+    size_t SourceRegistry::getSourceCount() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto& pair : sources_) {
+            if (!pair.second.expired()) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+} // namespace ffmpeg_stream
@@ -0,0 +1,297 @@
+/**
+ * @file video_scaler.cpp
+ * @brief 视频缩放和像素格式转换实现
+ */
+
+#include "ffmpeg_base/video_scaler.h"
+#include "logger/logger.h"
+#include "common/utils.h"
+#include "common/threadpool.h"
+
+#include <algorithm>
+#include <future>
+#include <thread>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+// FFmpeg 5.0起libswscale支持切片线程(threads选项和sws_scale_frame)
+#if LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100)
+#define FFMPEG_STREAM_SWS_THREADS 1
+#endif
+
+namespace ffmpeg_stream {
+
+    namespace {
+        // 输出帧的行对齐
+        constexpr int kBufferAlign = 32;
+
+#ifndef FFMPEG_STREAM_SWS_THREADS
+        // 按行切分时每个切片至少的行数和切分位置的对齐，对齐保证色度平面的行偏移为整数
+        constexpr int kMinBandRows = 64;
+        constexpr int kBandAlign = 16;
+
+        // 所有缩放器共用的切片线程，调用线程自己处理第一个切片
+        ThreadPool& sliceThreadPool() {
+            static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+            return pool;
+        }
+
+        // 该像素格式能否按行切分(调色板、位流和硬件格式不能)
+        bool canSplitRows(AVPixelFormat pixFmt) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFmt);
+            return desc && !(desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                            AV_PIX_FMT_FLAG_HWACCEL));
+        }
+
+        // 第plane个平面中与亮度第row行对应的行
+        int planeRow(AVPixelFormat pixFmt, int plane, int row) {
+            const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixFmt);
+            return (plane == 1 || plane == 2) ? (row >> desc->log2_chroma_h) : row;
+        }
+#endif
+    }
+
+    int scaleAlgorithmToSwsFlags(const std::string& name) {
+        std::string lower = utils::toLower(name);
+        if (lower == "fast_bilinear") return SWS_FAST_BILINEAR;
+        if (lower == "bicubic") return SWS_BICUBIC;
+        if (lower == "area") return SWS_AREA;
+        return SWS_BILINEAR;
+    }
+
+    VideoScaler::VideoScaler()
+            : swsContext(nullptr), bufferPool(nullptr),
+              srcWidth(0), srcHeight(0), srcPixFmt(AV_PIX_FMT_NONE),
+              dstWidth(0), dstHeight(0), dstPixFmt(AV_PIX_FMT_NONE),
+              flags(SWS_BILINEAR), threadCount(0) {
+    }
+
+    VideoScaler::~VideoScaler() {
+        cleanup();
+        av_buffer_pool_uninit(&bufferPool);
+    }
+
+    void VideoScaler::setTarget(int width, int height, AVPixelFormat pixFmt) {
+        if (width != dstWidth || height != dstHeight || pixFmt != dstPixFmt) {
+            cleanup();
+            // 池中已借出的缓冲在帧释放后随池一起释放
+            av_buffer_pool_uninit(&bufferPool);
+        }
+        dstWidth = width;
+        dstHeight = height;
+        dstPixFmt = pixFmt;
+    }
+
+    void VideoScaler::setOptions(int swsFlags, int threads) {
+        if (swsFlags != flags || threads != threadCount) {
+            cleanup();
+        }
+        flags = swsFlags;
+        threadCount = threads;
+    }
+
+    bool VideoScaler::needsScaling(const AVFrame* src) const {
+        return src->width != dstWidth || src->height != dstHeight || src->format != dstPixFmt;
+    }
+
+    bool VideoScaler::rebuild(int width, int height, AVPixelFormat pixFmt) {
+        cleanup();
+
+#ifdef FFMPEG_STREAM_SWS_THREADS
+        swsContext = sws_alloc_context();
+        if (swsContext) {
+            av_opt_set_int(swsContext, "srcw", width, 0);
+            av_opt_set_int(swsContext, "srch", height, 0);
+            av_opt_set_int(swsContext, "src_format", pixFmt, 0);
+            av_opt_set_int(swsContext, "dstw", dstWidth, 0);
+            av_opt_set_int(swsContext, "dsth", dstHeight, 0);
+            av_opt_set_int(swsContext, "dst_format", dstPixFmt, 0);
+            av_opt_set_int(swsContext, "sws_flags", flags, 0);
+            av_opt_set_int(swsContext, "threads", threadCount, 0);
+            if (sws_init_context(swsContext, nullptr, nullptr) < 0) {
+                sws_freeContext(swsContext);
+                swsContext = nullptr;
+            }
+        }
+#else
+        // 旧版libswscale没有切片线程：按输出行切成若干条带，每条带一个SwsContext，
+        // 源条带按比例对应，各条带并行缩放。条带边界处垂直滤波看不到相邻条带的行，
+        // 边界可能有轻微接缝，所以只在显式配置了多个线程时切分
+        int bandCount = std::min(threadCount, std::min(height, dstHeight) / kMinBandRows);
+        if (bandCount > 1 && canSplitRows(pixFmt) && canSplitRows(dstPixFmt)) {
+            for (int i = 0; i < bandCount; ++i) {
+                ScaleBand band;
+                band.dstY = i == 0 ? 0 : dstHeight * i / bandCount / kBandAlign * kBandAlign;
+                int dstEnd = i == bandCount - 1 ? dstHeight
+                                                : dstHeight * (i + 1) / bandCount / kBandAlign * kBandAlign;
+                band.srcY = i == 0 ? 0 : static_cast<int>(static_cast<int64_t>(band.dstY) * height / dstHeight /
+                                                          kBandAlign * kBandAlign);
+                int srcEnd = i == bandCount - 1 ? height
+                                                : static_cast<int>(static_cast<int64_t>(dstEnd) * height / dstHeight /
+                                                                   kBandAlign * kBandAlign);
+                band.dstHeight = dstEnd - band.dstY;
+                band.srcHeight = srcEnd - band.srcY;
+                band.context = sws_getContext(width, band.srcHeight, pixFmt, dstWidth, band.dstHeight, dstPixFmt,
+                                              flags, nullptr, nullptr, nullptr);
+                if (!band.context) {
+                    cleanup();
+                    break;
+                }
+                bands.push_back(band);
+            }
+        } else {
+            swsContext = sws_getContext(width, height, pixFmt, dstWidth, dstHeight, dstPixFmt,
+                                        flags, nullptr, nullptr, nullptr);
+        }
+#endif
+
+        if (!swsContext && bands.empty()) {
+            Logger::error("Failed to create scaler %dx%d %s -> %dx%d %s",
+                          width, height, av_get_pix_fmt_name(pixFmt),
+                          dstWidth, dstHeight, av_get_pix_fmt_name(dstPixFmt));
+            return false;
+        }
+
+        srcWidth = width;
+        srcHeight = height;
+        srcPixFmt = pixFmt;
+
+        Logger::debug("Created scaler %dx%d %s -> %dx%d %s (%zu bands)",
+                      width, height, av_get_pix_fmt_name(pixFmt),
+                      dstWidth, dstHeight, av_get_pix_fmt_name(dstPixFmt), std::max<size_t>(bands.size(), 1));
+        return true;
+    }
+
+    int VideoScaler::scale(const AVFrame* src, AVFrame* dst) {
+        // 只有输入尺寸或像素格式变化(如输入源重连后分辨率改变)时才重建
+        AVPixelFormat pixFmt = static_cast<AVPixelFormat>(src->format);
+        if ((!swsContext && bands.empty()) || src->width != srcWidth || src->height != srcHeight || pixFmt != srcPixFmt) {
+            if (!rebuild(src->width, src->height, pixFmt)) {
+                return AVERROR(EINVAL);
+            }
+        }
+
+        // 输出帧尺寸不符或缓冲仍被他处引用(编码器、帧率转换)时从缓冲池换一块，
+        // 否则原地复用。不用av_frame_make_writable：它会把旧画面整帧拷贝
+        // 到新缓冲，而sws_scale随即整帧覆盖
+        int ret = 0;
+        if (dst->width != dstWidth || dst->height != dstHeight || dst->format != dstPixFmt ||
+            !dst->data[0] || !av_frame_is_writable(dst)) {
+            ret = allocateOutput(dst);
+            if (ret < 0) {
+                utils::printFFmpegError("Failed to allocate scaled frame", ret);
+                return ret;
+            }
+        }
+
+#ifdef FFMPEG_STREAM_SWS_THREADS
+        // sws_scale_frame按切片分发到threads个线程
+        ret = sws_scale_frame(swsContext, dst, src);
+#else
+        if (!bands.empty()) {
+            ret = scaleBands(src, dst);
+        } else {
+            ret = sws_scale(swsContext, src->data, src->linesize, 0, src->height,
+                            dst->data, dst->linesize);
+        }
+#endif
+        if (ret < 0) {
+            utils::printFFmpegError("Failed to scale frame", ret);
+            return ret;
+        }
+
+        return av_frame_copy_props(dst, src);
+    }
+
+    int VideoScaler::scaleBands(const AVFrame* src, AVFrame* dst) {
+#ifdef FFMPEG_STREAM_SWS_THREADS
+        (void)src;
+        (void)dst;
+        return AVERROR(ENOSYS);
+#else
+        auto runBand = [this, src, dst](size_t index) {
+            const ScaleBand& band = bands[index];
+            const uint8_t* srcData[AV_NUM_DATA_POINTERS] = {};
+            uint8_t* dstData[AV_NUM_DATA_POINTERS] = {};
+            for (int plane = 0; plane < 4; ++plane) {
+                if (src->data[plane]) {
+                    srcData[plane] = src->data[plane] +
+                                     src->linesize[plane] * planeRow(srcPixFmt, plane, band.srcY);
+                }
+                if (dst->data[plane]) {
+                    dstData[plane] = dst->data[plane] +
+                                     dst->linesize[plane] * planeRow(dstPixFmt, plane, band.dstY);
+                }
+            }
+            return sws_scale(band.context, srcData, src->linesize, 0, band.srcHeight, dstData, dst->linesize);
+        };
+
+        // 其余条带交给切片线程，调用线程处理第一个条带后等待，条带之间互不依赖
+        std::vector<std::future<int>> pending;
+        pending.reserve(bands.size() - 1);
+        for (size_t i = 1; i < bands.size(); ++i) {
+            pending.push_back(sliceThreadPool().enqueue(TaskPriority::HIGH, runBand, i));
+        }
+
+        int ret = runBand(0);
+        for (auto& result : pending) {
+            int bandRet = result.get();
+            if (bandRet < 0 && ret >= 0) {
+                ret = bandRet;
+            }
+        }
+        return ret;
+#endif
+    }
+
+    int VideoScaler::allocateOutput(AVFrame* dst) {
+        av_frame_unref(dst);
+
+        // 缓冲池按输出尺寸和像素格式建立，稳定运行时帧率转换和编码器归还的缓冲循环使用
+        if (!bufferPool) {
+            int size = av_image_get_buffer_size(dstPixFmt, dstWidth, dstHeight, kBufferAlign);
+            if (size < 0) {
+                return size;
+            }
+            bufferPool = av_buffer_pool_init(size, nullptr);
+            if (!bufferPool) {
+                return AVERROR(ENOMEM);
+            }
+        }
+
+        dst->buf[0] = av_buffer_pool_get(bufferPool);
+        if (!dst->buf[0]) {
+            return AVERROR(ENOMEM);
+        }
+        int ret = av_image_fill_arrays(dst->data, dst->linesize, dst->buf[0]->data,
+                                       dstPixFmt, dstWidth, dstHeight, kBufferAlign);
+        if (ret < 0) {
+            av_frame_unref(dst);
+            return ret;
+        }
+
+        dst->width = dstWidth;
+        dst->height = dstHeight;
+        dst->format = dstPixFmt;
+        return 0;
+    }
+
+    void VideoScaler::cleanup() {
+        if (swsContext) {
+            sws_freeContext(swsContext);
+            swsContext = nullptr;
+        }
+        for (ScaleBand& band : bands) {
+            sws_freeContext(band.context);
+        }
+        bands.clear();
+        srcWidth = 0;
+        srcHeight = 0;
+        srcPixFmt = AV_PIX_FMT_NONE;
+    }
+
+} // namespace ffmpeg_stream